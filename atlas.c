@@ -0,0 +1,213 @@
+/**
+ * Atlas blur, see atlas.h.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <omp.h>
+
+#include "atlas.h"
+#include "memTrack.h"
+
+#define min(X, Y) (((X) < (Y)) ? (X) : (Y))
+#define max(X, Y) (((X) < (Y)) ? (Y) : (X))
+
+// Entry (row, col) of all channels; zero above or left of the image.
+static inline SatVec corner(const Sat *sat, int row, int col) {
+    const SatVec zero = { 0, 0, 0, 0 };
+
+    if (row < 0 || col < 0) {
+        return zero;
+    }
+    if (sat->layout == SAT_INTERLEAVED) {
+        return SatEntry(sat, row, col);
+    }
+
+    const size_t i = SatIndex(sat, row, col);
+    SatVec v = { sat->sums_r[i], sat->sums_g[i], sat->sums_b[i], 0 };
+    return v;
+}
+
+/**
+ * Blur row `row` of rectangle `r`, already clipped to the image.
+ */
+static void atlasRow(Image *img_out, const Sat *sat, SatRect r, int R, int row) {
+    const int y_min = max(row - R, r.y0);
+    const int y_max = min(row + R, r.y1);
+    unsigned char *out = img_out->data + (size_t)row * img_out->stride + 3 * r.x0;
+
+    for (int col = r.x0; col <= r.x1; col++, out += 3) {
+        const int x_min = max(col - R, r.x0);
+        const int x_max = min(col + R, r.x1);
+        const int pixels = (x_max - x_min + 1) * (y_max - y_min + 1);
+        SatVec a = corner(sat, y_min - 1, x_min - 1);
+        SatVec b = corner(sat, y_min - 1, x_max);
+        SatVec c = corner(sat, y_max, x_min - 1);
+        SatVec d = corner(sat, y_max, x_max);
+        SatVec sum = d - (b + c - a);
+
+        out[0] = SatMean(sum[0], pixels);
+        out[1] = SatMean(sum[1], pixels);
+        out[2] = SatMean(sum[2], pixels);
+    }
+}
+
+void AtlasBlur(Image *img_out, const Sat *sat, const SatRect *rects, int n, int R) {
+    SatRect *clipped = MemAlloc(sizeof(SatRect) * (n + 1));
+    int64_t *start = MemAlloc(sizeof(int64_t) * (n + 1));
+    int m = 0;
+
+    if (!clipped || !start) {
+        fprintf(stderr, "atlas: cannot allocate memory for %d rectangles\n", n);
+        exit(1);
+    }
+
+    // Pixels before each rectangle, in the order given; empty rectangles are
+    // dropped.
+    start[0] = 0;
+    for (int i = 0; i < n; i++) {
+        SatRect r = {
+            max(rects[i].x0, 0), max(rects[i].y0, 0),
+            min(rects[i].x1, sat->width - 1), min(rects[i].y1, sat->height - 1)
+        };
+
+        if (r.x0 <= r.x1 && r.y0 <= r.y1) {
+            clipped[m] = r;
+            start[m + 1] = start[m] + (int64_t)(r.x1 - r.x0 + 1) * (r.y1 - r.y0 + 1);
+            m++;
+        }
+    }
+
+    // Each thread takes the rows that start in its share of the pixels.
+    #pragma omp parallel
+    {
+        const int T = omp_get_num_threads();
+        const int t = omp_get_thread_num();
+        const int64_t lo = start[m] * t / T;
+        const int64_t hi = start[m] * (t + 1) / T;
+
+        for (int i = 0; i < m && start[i] < hi; i++) {
+            const SatRect r = clipped[i];
+            const int64_t w = r.x1 - r.x0 + 1;
+
+            if (start[i + 1] <= lo) {
+                continue;
+            }
+
+            const int k0 = lo > start[i] ? (lo - start[i] + w - 1) / w : 0;
+            const int k1 = min((hi - start[i] + w - 1) / w, r.y1 - r.y0 + 1);
+
+            for (int k = k0; k < k1; k++) {
+                atlasRow(img_out, sat, r, R, r.y0 + k);
+            }
+        }
+    }
+
+    MemFree(clipped);
+    MemFree(start);
+}
+
+int AtlasReadRects(const char *path, SatRect **rects) {
+    FILE *fp = fopen(path, "r");
+    char line[256];
+    int n = 0, capacity = 0;
+
+    if (!fp) {
+        fprintf(stderr, "atlas: cannot open %s\n", path);
+        exit(1);
+    }
+
+    *rects = NULL;
+    for (int number = 1; fgets(line, sizeof(line), fp); number++) {
+        int x, y, w, h;
+        char extra;
+
+        if (line[0] == '#' || strspn(line, " \t\r\n") == strlen(line)) {
+            continue;
+        }
+        if (sscanf(line, "%d %d %d %d %c", &x, &y, &w, &h, &extra) != 4 || w < 1 || h < 1) {
+            fprintf(stderr, "atlas: %s:%d: expected \"x y width height\"\n", path, number);
+            exit(1);
+        }
+        if (n == capacity) {
+            SatRect *grown;
+
+            capacity = capacity ? 2 * capacity : 64;
+            grown = realloc(*rects, sizeof(SatRect) * capacity);
+            if (!grown) {
+                fprintf(stderr, "atlas: cannot allocate memory for %d rectangles\n", capacity);
+                exit(1);
+            }
+            *rects = grown;
+        }
+        (*rects)[n++] = (SatRect){ x, y, x + w - 1, y + h - 1 };
+    }
+
+    fclose(fp);
+    return n;
+}
+
+static void atlasUsage(void) {
+    fprintf(stderr,
+        "usage: fast_blur --atlas RECTS [options] R input.ppm output.ppm\n"
+        "\n"
+        "Box blur each rectangle of a texture atlas within its own bounds.\n"
+        "RECTS has one \"x y width height\" line per sub-image; pixels outside\n"
+        "every rectangle are copied.\n"
+        "\n"
+        "options:\n"
+        "  --layout L     summed-area table layout: rows (default), tiled or\n"
+        "                 interleaved\n");
+    exit(1);
+}
+
+int AtlasMain(int argc, char *argv[]) {
+    SatLayout layout = SAT_ROW_MAJOR;
+
+    if (argc < 5) {
+        atlasUsage();
+    }
+    for (int i = 2; i < argc - 3; i++) {
+        const char *opt = argv[i];
+        const char *val = i + 1 < argc - 3 ? argv[i + 1] : NULL;
+
+        if (!val) {
+            atlasUsage();
+        } else if (strcmp(opt, "--layout") == 0) {
+            layout = SatLayoutFromName(val);
+            if (layout == SAT_LAYOUT_INVALID) {
+                atlasUsage();
+            }
+        } else {
+            atlasUsage();
+        }
+        i++;
+    }
+
+    char *end;
+    const long R = strtol(argv[argc - 3], &end, 10);
+    if (*end != '\0' || R < 0 || R > 32767) {
+        atlasUsage();
+    }
+
+    SatRect *rects;
+    const int n = AtlasReadRects(argv[1], &rects);
+    Image *img_in = ImageRead(argv[argc - 2]);
+    Image *img_out = ImageCreate(img_in->width, img_in->height);
+    Sat *sat = SatCreate(img_in->width, img_in->height, layout);
+
+    SatRowPass(sat, img_in);
+    SatColumnPass(sat);
+    memcpy(img_out->data, img_in->data, (size_t)img_in->stride * img_in->height);
+    AtlasBlur(img_out, sat, rects, n, R);
+
+    ImageWrite(img_out, argv[argc - 1]);
+    SatFree(sat);
+    ImageFree(img_in);
+    ImageFree(img_out);
+    free(rects);
+
+    return 0;
+}
@@ -0,0 +1,31 @@
+/**
+ * Atlas blur: a box blur of each sub-image of a texture atlas, clamped to the
+ * sub-image so that sprites never bleed into each other.
+ *
+ * One summed-area table of the whole sheet serves every rectangle: clamping a
+ * window to its rectangle only changes the corners looked up. The rows of all
+ * rectangles are split over the threads by area, so a few large sprites and
+ * many small ones balance as well as a single image does.
+ */
+
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include "ppmFile.h"
+#include "sat.h"
+#include "satQuery.h"
+
+// Blur every rectangle of `rects` (inclusive, clipped to the image, expected
+// not to overlap) with radius R from a table holding both passes. Pixels
+// outside all rectangles are left as they are in `img_out`.
+void AtlasBlur(Image *img_out, const Sat *sat, const SatRect *rects, int n, int R);
+
+// Read rectangles from a file of "x y width height" lines; blank lines and
+// lines starting with '#' are skipped. Returns the count and sets `rects` to
+// an array for free(), or exits on a malformed file.
+int AtlasReadRects(const char *path, SatRect **rects);
+
+// Entry point of `fast_blur --atlas ...`; `argv[0]` is the mode.
+int AtlasMain(int argc, char *argv[]);
+
+#endif
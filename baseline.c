@@ -0,0 +1,308 @@
+/**
+ * Performance baselines, see baseline.h.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "baseline.h"
+#include "topology.h"
+
+/**
+ * Copy the value of the first "key : value" line of a /proc file starting with
+ * `key` into `out`, without the trailing newline.
+ */
+static void readProcField(const char *path, const char *key, char *out, size_t size) {
+    FILE *fp = fopen(path, "r");
+    char line[256];
+
+    snprintf(out, size, "unknown");
+    if (!fp) {
+        return;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, key, strlen(key)) == 0) {
+            char *v = strchr(line, ':');
+            if (v) {
+                v++;
+                while (*v == ' ' || *v == '\t') {
+                    v++;
+                }
+                v[strcspn(v, "\n")] = '\0';
+                snprintf(out, size, "%s", v);
+            }
+            break;
+        }
+    }
+    fclose(fp);
+}
+
+void BaselineInit(Baseline *b) {
+    char mem[64];
+    char key[256];
+    Topology *topo = TopologyDetect();
+
+    readProcField("/proc/cpuinfo", "model name", b->cpu, sizeof(b->cpu));
+    readProcField("/proc/meminfo", "MemTotal", mem, sizeof(mem));
+    b->memory = atoll(mem) * 1024;   // MemTotal is in kB.
+    b->ncpus = topo->ncpus;
+    b->ncores = topo->ncores;
+    TopologyFree(topo);
+
+    // 64-bit FNV-1a of the host description.
+    unsigned long long h = 14695981039346656037ull;
+    snprintf(key, sizeof(key), "%s|%d|%d|%lld", b->cpu, b->ncpus, b->ncores, b->memory);
+    for (const char *p = key; *p; p++) {
+        h = (h ^ (unsigned char)*p) * 1099511628211ull;
+    }
+    snprintf(b->fingerprint, sizeof(b->fingerprint), "%016llx", h);
+
+    b->count = 0;
+    b->results = NULL;
+}
+
+void BaselineFree(Baseline *b) {
+    for (int i = 0; i < b->count; i++) {
+        free(b->results[i].samples);
+    }
+    free(b->results);
+    b->count = 0;
+    b->results = NULL;
+}
+
+void BaselineAdd(
+    Baseline *b, const char *engine, int width, int height, int radius,
+    const double *samples, int n
+) {
+    b->results = realloc(b->results, sizeof(BenchResult) * (b->count + 1));
+
+    BenchResult *r = &b->results[b->count++];
+    snprintf(r->engine, sizeof(r->engine), "%s", engine);
+    r->width = width;
+    r->height = height;
+    r->radius = radius;
+    r->n = n;
+    r->samples = malloc(sizeof(double) * n);
+    memcpy(r->samples, samples, sizeof(double) * n);
+}
+
+static void writeSection(FILE *fp, const Baseline *b) {
+    fprintf(fp, "host %s\n", b->fingerprint);
+    fprintf(fp, "cpu %s\n", b->cpu);
+    fprintf(fp, "cores %d %d\n", b->ncpus, b->ncores);
+    fprintf(fp, "memory %lld\n", b->memory);
+
+    for (int i = 0; i < b->count; i++) {
+        const BenchResult *r = &b->results[i];
+        fprintf(fp, "result %s %dx%d %d %d", r->engine, r->width, r->height, r->radius, r->n);
+        for (int j = 0; j < r->n; j++) {
+            fprintf(fp, " %.9g", r->samples[j]);
+        }
+        fprintf(fp, "\n");
+    }
+}
+
+/**
+ * Check the version line of an open baseline file. Returns 0 if it matches.
+ */
+static int readHeader(FILE *fp) {
+    int version;
+
+    if (fscanf(fp, "fast-blur-baseline %d\n", &version) != 1) {
+        return -1;
+    }
+    return version == BASELINE_VERSION ? 0 : -1;
+}
+
+int BaselineSave(const char *filename, const Baseline *b) {
+    char tmp_name[4096];
+    FILE *in = fopen(filename, "r");
+
+    snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", filename);
+    FILE *out = fopen(tmp_name, "w");
+    if (!out) {
+        if (in) {
+            fclose(in);
+        }
+        return -1;
+    }
+
+    fprintf(out, "fast-blur-baseline %d\n", BASELINE_VERSION);
+
+    // Keep the sections of other hosts.
+    if (in && readHeader(in) == 0) {
+        char *line = NULL;
+        size_t cap = 0;
+        int keep = 1;
+
+        while (getline(&line, &cap, in) > 0) {
+            if (strncmp(line, "host ", 5) == 0) {
+                keep = strncmp(line + 5, b->fingerprint, strlen(b->fingerprint)) != 0;
+            }
+            if (keep) {
+                fputs(line, out);
+            }
+        }
+        free(line);
+    }
+    if (in) {
+        fclose(in);
+    }
+
+    writeSection(out, b);
+
+    if (fclose(out) != 0 || rename(tmp_name, filename) != 0) {
+        remove(tmp_name);
+        return -1;
+    }
+    return 0;
+}
+
+int BaselineLoad(const char *filename, const char *fingerprint, Baseline *b) {
+    FILE *fp = fopen(filename, "r");
+    char *line = NULL;
+    size_t cap = 0;
+    int found = 0;
+    int inside = 0;
+
+    if (!fp) {
+        return -1;
+    }
+    if (readHeader(fp) != 0) {
+        fclose(fp);
+        return -1;
+    }
+
+    memset(b, 0, sizeof(Baseline));
+
+    while (getline(&line, &cap, fp) > 0) {
+        line[strcspn(line, "\n")] = '\0';
+
+        if (strncmp(line, "host ", 5) == 0) {
+            inside = strcmp(line + 5, fingerprint) == 0;
+            if (inside) {
+                found = 1;
+                snprintf(b->fingerprint, sizeof(b->fingerprint), "%s", fingerprint);
+            }
+        } else if (!inside) {
+            continue;
+        } else if (strncmp(line, "cpu ", 4) == 0) {
+            snprintf(b->cpu, sizeof(b->cpu), "%s", line + 4);
+        } else if (strncmp(line, "cores ", 6) == 0) {
+            sscanf(line + 6, "%d%d", &b->ncpus, &b->ncores);
+        } else if (strncmp(line, "memory ", 7) == 0) {
+            b->memory = atoll(line + 7);
+        } else if (strncmp(line, "result ", 7) == 0) {
+            char engine[32];
+            int w, h, r, n, used;
+
+            if (sscanf(line + 7, "%31s %dx%d %d %d%n", engine, &w, &h, &r, &n, &used) != 5 || n < 1) {
+                continue;
+            }
+
+            double *samples = malloc(sizeof(double) * n);
+            char *p = line + 7 + used;
+            int k = 0;
+            while (k < n) {
+                char *end;
+                samples[k] = strtod(p, &end);
+                if (end == p) {
+                    break;
+                }
+                p = end;
+                k++;
+            }
+            if (k == n) {
+                BaselineAdd(b, engine, w, h, r, samples, n);
+            }
+            free(samples);
+        }
+    }
+
+    free(line);
+    fclose(fp);
+
+    return found ? 0 : 1;
+}
+
+static int compareDouble(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double medianOf(const double *v, int n) {
+    double *s = malloc(sizeof(double) * n);
+    memcpy(s, v, sizeof(double) * n);
+    qsort(s, n, sizeof(double), compareDouble);
+
+    double m = n % 2 ? s[n / 2] : 0.5 * (s[n / 2 - 1] + s[n / 2]);
+    free(s);
+    return m;
+}
+
+/**
+ * One-sided p-value of the Mann-Whitney U test for `y` being slower (larger)
+ * than `x`, using the normal approximation with continuity correction.
+ */
+static double slowerPValue(const double *x, int n1, const double *y, int n2) {
+    double u = 0.0;
+
+    for (int i = 0; i < n1; i++) {
+        for (int j = 0; j < n2; j++) {
+            u += y[j] > x[i] ? 1.0 : y[j] == x[i] ? 0.5 : 0.0;
+        }
+    }
+
+    double mean = 0.5 * n1 * n2;
+    double sd = sqrt(n1 * n2 * (n1 + n2 + 1) / 12.0);
+    double z = (u - mean - 0.5) / sd;
+
+    return 0.5 * erfc(z / sqrt(2.0));
+}
+
+int BaselineCompare(const Baseline *base, const Baseline *cur, double threshold, double alpha) {
+    int regressions = 0;
+
+    printf("engine,width,height,radius,base_median_s,median_s,change_pct,p_value,verdict\n");
+
+    for (int i = 0; i < cur->count; i++) {
+        const BenchResult *c = &cur->results[i];
+        const BenchResult *b = NULL;
+
+        for (int j = 0; j < base->count; j++) {
+            const BenchResult *r = &base->results[j];
+            if (strcmp(r->engine, c->engine) == 0 && r->width == c->width
+                    && r->height == c->height && r->radius == c->radius) {
+                b = r;
+            }
+        }
+        if (!b) {
+            continue;
+        }
+
+        double mb = medianOf(b->samples, b->n);
+        double mc = medianOf(c->samples, c->n);
+        double change = mc / mb - 1.0;
+        double p_slower = slowerPValue(b->samples, b->n, c->samples, c->n);
+        double p_faster = slowerPValue(c->samples, c->n, b->samples, b->n);
+        const char *verdict = "same";
+
+        if (p_slower < alpha && change > threshold) {
+            verdict = "REGRESSION";
+            regressions++;
+        } else if (p_faster < alpha && -change > threshold) {
+            verdict = "improvement";
+        }
+
+        printf("%s,%d,%d,%d,%.6f,%.6f,%.2f,%.4g,%s\n",
+               c->engine, c->width, c->height, c->radius,
+               mb, mc, 100.0 * change, change > 0 ? p_slower : p_faster, verdict);
+    }
+
+    return regressions;
+}
@@ -0,0 +1,72 @@
+/**
+ * Performance baselines.
+ *
+ * A baseline file keeps, for every host it was recorded on, the raw timing
+ * samples of each benchmark. Hosts are told apart by a fingerprint of their
+ * CPU model, CPU and core counts and memory size, so a file can be shared
+ * between machines and every machine is only compared against itself.
+ *
+ * The file is text:
+ *
+ *     fast-blur-baseline 1
+ *     host <fingerprint>
+ *     cpu <model name>
+ *     cores <logical> <physical>
+ *     memory <bytes>
+ *     result <engine> <width>x<height> <radius> <n> <sample 1> ... <sample n>
+ *     ...
+ *     host <fingerprint>
+ *     ...
+ */
+
+#ifndef BASELINE_H
+#define BASELINE_H
+
+#define BASELINE_VERSION 1
+
+typedef struct BenchResult {
+    char engine[32];
+    int width;
+    int height;
+    int radius;
+    int n;
+    double *samples;    // Seconds, one per repetition.
+} BenchResult;
+
+typedef struct Baseline {
+    char fingerprint[17];
+    char cpu[128];
+    int ncpus;
+    int ncores;
+    long long memory;
+
+    int count;
+    BenchResult *results;
+} Baseline;
+
+// Fill in the host fields of an empty baseline.
+void BaselineInit(Baseline *b);
+void BaselineFree(Baseline *b);
+
+// Append a result; the samples are copied.
+void BaselineAdd(
+    Baseline *b, const char *engine, int width, int height, int radius,
+    const double *samples, int n
+);
+
+// Write `b` into `filename`, replacing any section of the same host and
+// keeping the others. Returns 0 on success and -1 on error.
+int BaselineSave(const char *filename, const Baseline *b);
+
+// Read the section of the host `fingerprint` from `filename` into `b`.
+// Returns 0 on success, -1 if the file cannot be read or has another
+// version and 1 if it has no section for the host.
+int BaselineLoad(const char *filename, const char *fingerprint, Baseline *b);
+
+// Print a CSV comparison of every result of `cur` that `base` also has and
+// return the number of regressions: results whose samples are slower with
+// one-sided Mann-Whitney p-value below `alpha` and whose median is more than
+// `threshold` (a fraction) slower.
+int BaselineCompare(const Baseline *base, const Baseline *cur, double threshold, double alpha);
+
+#endif
@@ -0,0 +1,443 @@
+/**
+ * Benchmark harness, see bench.h.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <omp.h>
+
+#include "bench.h"
+#include "boxBlur.h"
+#include "diskBlur.h"
+#include "sepConv.h"
+#include "conv2d.h"
+#include "baseline.h"
+#include "topology.h"
+
+static const char *engine_names[BENCH_ENGINE_COUNT] = {
+    "box", "box-tiled", "box-interleaved", "disk", "polygon", "sep", "conv"
+};
+
+Image *BenchImage(int width, int height, unsigned seed) {
+    Image *img = ImageCreate(width, height);
+    size_t n = (size_t)width * height * 3;
+    unsigned x = seed ? seed : 1;
+
+    // xorshift32; the content does not matter, only that it is not constant.
+    for (size_t i = 0; i < n; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        img->data[i] = x >> 24;
+    }
+
+    return img;
+}
+
+static int compareDouble(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double median(double *v, int n) {
+    qsort(v, n, sizeof(double), compareDouble);
+    return n % 2 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+PassTimes BenchBoxPasses(Image *in, Image *out, int R, SatLayout layout, int reps) {
+    double *row = malloc(sizeof(double) * reps);
+    double *column = malloc(sizeof(double) * reps);
+    double *evaluate = malloc(sizeof(double) * reps);
+    double *total = malloc(sizeof(double) * reps);
+    Sat *sat = SatCreate(in->width, in->height, layout);
+
+    // One untimed run to fault in the table and warm up the thread pool.
+    SatRowPass(sat, in);
+    SatColumnPass(sat);
+    BoxBlur(out, sat, R);
+
+    for (int i = 0; i < reps; i++) {
+        double t0 = omp_get_wtime();
+        SatRowPass(sat, in);
+        double t1 = omp_get_wtime();
+        SatColumnPass(sat);
+        double t2 = omp_get_wtime();
+        BoxBlur(out, sat, R);
+        double t3 = omp_get_wtime();
+
+        row[i] = t1 - t0;
+        column[i] = t2 - t1;
+        evaluate[i] = t3 - t2;
+        total[i] = t3 - t0;
+    }
+
+    PassTimes t = {
+        median(row, reps), median(column, reps),
+        median(evaluate, reps), median(total, reps)
+    };
+
+    SatFree(sat);
+    free(row);
+    free(column);
+    free(evaluate);
+    free(total);
+
+    return t;
+}
+
+static void scalingUsage(void) {
+    fprintf(stderr,
+        "usage: fast_blur --bench-scaling [options]\n"
+        "\n"
+        "Sweeps the thread count from 1 to all CPUs and prints one CSV row per\n"
+        "run. Strong scaling keeps the image size fixed; weak scaling grows the\n"
+        "image height with the thread count.\n"
+        "\n"
+        "options:\n"
+        "  --size WxH           image size, per thread for weak scaling\n"
+        "                       (default 1024x1024)\n"
+        "  --radius R           blur radius (default 16)\n"
+        "  --reps N             repetitions per run, the median is kept (default 5)\n"
+        "  --scaling S          strong, weak or both (default both)\n"
+        "  --smt S              on, off or both (default both)\n"
+        "  --placement P        compact or scatter (default scatter)\n"
+        "  --layout L           rows, tiled or interleaved (default rows)\n");
+    exit(1);
+}
+
+int BenchScalingMain(int argc, char *argv[]) {
+    int W = 1024, H = 1024, R = 16, reps = 5;
+    int strong = 1, weak = 1;
+    int smt_on = 1, smt_off = 1;
+    Placement placement = PLACE_SCATTER;
+    SatLayout layout = SAT_ROW_MAJOR;
+
+    for (int i = 1; i < argc; i++) {
+        const char *opt = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (!val) {
+            scalingUsage();
+        } else if (strcmp(opt, "--size") == 0) {
+            if (sscanf(val, "%dx%d", &W, &H) != 2 || W < 1 || H < 1) {
+                scalingUsage();
+            }
+        } else if (strcmp(opt, "--radius") == 0) {
+            R = atoi(val);
+        } else if (strcmp(opt, "--reps") == 0) {
+            reps = atoi(val) > 0 ? atoi(val) : 1;
+        } else if (strcmp(opt, "--scaling") == 0) {
+            strong = strcmp(val, "weak") != 0;
+            weak = strcmp(val, "strong") != 0;
+        } else if (strcmp(opt, "--smt") == 0) {
+            smt_on = strcmp(val, "off") != 0;
+            smt_off = strcmp(val, "on") != 0;
+        } else if (strcmp(opt, "--placement") == 0) {
+            placement = strcmp(val, "compact") == 0 ? PLACE_COMPACT : PLACE_SCATTER;
+        } else if (strcmp(opt, "--layout") == 0) {
+            layout = SatLayoutFromName(val);
+            if (layout == SAT_LAYOUT_INVALID) {
+                scalingUsage();
+            }
+        } else {
+            scalingUsage();
+        }
+        i++;
+    }
+
+    Topology *topo = TopologyDetect();
+    int *cpus = malloc(sizeof(int) * topo->ncpus);
+    const int team = omp_get_max_threads();
+
+    fprintf(stderr, "bench: %d logical CPUs on %d cores\n", topo->ncpus, topo->ncores);
+    printf(
+        "scaling,smt,placement,threads,width,height,radius,"
+        "total_s,row_s,column_s,evaluate_s,"
+        "speedup,efficiency,row_speedup,column_speedup,evaluate_speedup\n"
+    );
+
+    for (int s = 0; s < 2; s++) {
+        int is_weak = s == 1;
+        if ((is_weak && !weak) || (!is_weak && !strong)) {
+            continue;
+        }
+
+        for (int smt = 1; smt >= 0; smt--) {
+            if ((smt && !smt_on) || (!smt && !smt_off)) {
+                continue;
+            }
+
+            int n = TopologyOrder(topo, smt, placement, cpus);
+            PassTimes base = { 0, 0, 0, 0 };
+
+            for (int threads = 1; threads <= n; threads++) {
+                int h = is_weak ? H * threads : H;
+                Image *in = BenchImage(W, h, 1);
+                Image *out = ImageCreate(W, h);
+
+                TopologyPin(cpus, threads);
+                PassTimes t = BenchBoxPasses(in, out, R, layout, reps);
+                if (threads == 1) {
+                    base = t;
+                }
+
+                // Weak scaling reports scaled speedup: the work grows with the
+                // thread count, so ideal time stays constant.
+                double scale = is_weak ? threads : 1.0;
+                double speedup = scale * base.total / t.total;
+
+                printf(
+                    "%s,%s,%s,%d,%d,%d,%d,%.6f,%.6f,%.6f,%.6f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+                    is_weak ? "weak" : "strong", smt ? "on" : "off",
+                    placement == PLACE_COMPACT ? "compact" : "scatter",
+                    threads, W, h, R,
+                    t.total, t.row, t.column, t.evaluate,
+                    speedup, speedup / threads,
+                    scale * base.row / t.row,
+                    scale * base.column / t.column,
+                    scale * base.evaluate / t.evaluate
+                );
+                fflush(stdout);
+
+                ImageFree(in);
+                ImageFree(out);
+            }
+        }
+    }
+
+    TopologyUnpin(topo, team);
+    TopologyFree(topo);
+    free(cpus);
+
+    return 0;
+}
+
+const char *BenchEngineName(BenchEngine engine) {
+    return engine_names[engine];
+}
+
+double BenchEngineRun(BenchEngine engine, Image *in, Image *out, int R) {
+    const int W = in->width;
+    const int H = in->height;
+    double t0 = omp_get_wtime();
+
+    if (engine == BENCH_SEP || engine == BENCH_CONV) {
+        // A (2R + 1) x (2R + 1) box, as separable taps or as a 2D kernel.
+        const int n = 2 * R + 1;
+        float *taps = malloc(sizeof(float) * n * n);
+        for (int i = 0; i < n * n; i++) {
+            taps[i] = 1.0f / (engine == BENCH_SEP ? n : n * n);
+        }
+
+        t0 = omp_get_wtime();
+        if (engine == BENCH_SEP) {
+            Kernel1D k = { R, taps };
+            SepConv(in, out, &k, &k);
+        } else {
+            Kernel2D k = { n, n, taps };
+            Conv2D(in, out, &k, ConvPlanCreate(&k, CONV_AUTO));
+        }
+        double t = omp_get_wtime() - t0;
+
+        free(taps);
+        return t;
+    }
+
+    Sat *sat = SatCreate(W, H, engine == BENCH_BOX_TILED       ? SAT_TILED
+                             : engine == BENCH_BOX_INTERLEAVED ? SAT_INTERLEAVED
+                             :                                   SAT_ROW_MAJOR);
+    SatRowPass(sat, in);
+
+    if (engine == BENCH_DISK) {
+        DiskBlur(out, sat, R);
+    } else {
+        SatColumnPass(sat);
+        if (engine == BENCH_POLYGON) {
+            PolygonBlur(out, sat, R, 4);
+        } else {
+            BoxBlur(out, sat, R);
+        }
+    }
+    double t = omp_get_wtime() - t0;
+
+    SatFree(sat);
+    return t;
+}
+
+/**
+ * Parse a comma separated list of integers, or of WxH sizes if `pairs`.
+ * Returns the number of entries.
+ */
+static int parseList(const char *spec, int *out, int max, int pairs) {
+    int n = 0;
+    const char *p = spec;
+
+    while (*p && n < max) {
+        int used;
+        if (pairs) {
+            if (sscanf(p, "%dx%d%n", &out[2 * n], &out[2 * n + 1], &used) != 2) {
+                return 0;
+            }
+        } else if (sscanf(p, "%d%n", &out[n], &used) != 1) {
+            return 0;
+        }
+        n++;
+        p += used;
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return n;
+}
+
+static void benchUsage(void) {
+    fprintf(stderr,
+        "usage: fast_blur --bench [options]\n"
+        "\n"
+        "Times every engine over a matrix of sizes and radii and prints the\n"
+        "median per run as CSV. With --save the raw samples are stored in a\n"
+        "baseline file under this host's fingerprint; with --compare they are\n"
+        "tested against this host's section of a baseline file, and the exit\n"
+        "status is 1 if any run regressed.\n"
+        "\n"
+        "options:\n"
+        "  --engines LIST   comma separated subset of box, box-tiled,\n"
+        "                   box-interleaved, disk, polygon, sep, conv\n"
+        "                   (default all)\n"
+        "  --sizes LIST     e.g. 512x512,2048x2048 (default)\n"
+        "  --radii LIST     e.g. 4,32 (default)\n"
+        "  --reps N         repetitions per run (default 10)\n"
+        "  --save FILE      store the samples in baseline FILE\n"
+        "  --compare FILE   compare against baseline FILE\n"
+        "  --threshold PCT  smallest median slowdown reported (default 5)\n"
+        "  --alpha P        significance level (default 0.01)\n");
+    exit(1);
+}
+
+int BenchMain(int argc, char *argv[]) {
+    int sizes[2 * 16] = { 512, 512, 2048, 2048 };
+    int radii[16] = { 4, 32 };
+    int nsizes = 2, nradii = 2, reps = 10;
+    int engines[BENCH_ENGINE_COUNT];
+    const char *save = NULL, *compare = NULL;
+    double threshold = 0.05, alpha = 0.01;
+
+    for (int e = 0; e < BENCH_ENGINE_COUNT; e++) {
+        engines[e] = 1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        const char *opt = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (!val) {
+            benchUsage();
+        } else if (strcmp(opt, "--engines") == 0) {
+            for (int e = 0; e < BENCH_ENGINE_COUNT; e++) {
+                const char *p = strstr(val, engine_names[e]);
+                size_t len = strlen(engine_names[e]);
+                engines[e] = 0;
+                while (p) {
+                    if ((p == val || p[-1] == ',') && (p[len] == ',' || p[len] == '\0')) {
+                        engines[e] = 1;
+                    }
+                    p = strstr(p + 1, engine_names[e]);
+                }
+            }
+        } else if (strcmp(opt, "--sizes") == 0) {
+            if (!(nsizes = parseList(val, sizes, 16, 1))) {
+                benchUsage();
+            }
+        } else if (strcmp(opt, "--radii") == 0) {
+            if (!(nradii = parseList(val, radii, 16, 0))) {
+                benchUsage();
+            }
+        } else if (strcmp(opt, "--reps") == 0) {
+            reps = atoi(val) > 1 ? atoi(val) : 2;
+        } else if (strcmp(opt, "--save") == 0) {
+            save = val;
+        } else if (strcmp(opt, "--compare") == 0) {
+            compare = val;
+        } else if (strcmp(opt, "--threshold") == 0) {
+            threshold = atof(val) / 100.0;
+        } else if (strcmp(opt, "--alpha") == 0) {
+            alpha = atof(val);
+        } else {
+            benchUsage();
+        }
+        i++;
+    }
+
+    Baseline cur;
+    BaselineInit(&cur);
+    fprintf(stderr, "bench: host %s (%s, %d CPUs, %d cores)\n",
+            cur.fingerprint, cur.cpu, cur.ncpus, cur.ncores);
+
+    double *samples = malloc(sizeof(double) * reps);
+
+    // The summary goes to stderr when stdout carries the comparison.
+    FILE *report = compare ? stderr : stdout;
+    fprintf(report, "engine,width,height,radius,reps,median_s,min_s\n");
+
+    for (int s = 0; s < nsizes; s++) {
+        const int W = sizes[2 * s];
+        const int H = sizes[2 * s + 1];
+        Image *in = BenchImage(W, H, 1);
+        Image *out = ImageCreate(W, H);
+
+        for (int e = 0; e < BENCH_ENGINE_COUNT; e++) {
+            if (!engines[e]) {
+                continue;
+            }
+            for (int r = 0; r < nradii; r++) {
+                BenchEngineRun(e, in, out, radii[r]);
+                for (int i = 0; i < reps; i++) {
+                    samples[i] = BenchEngineRun(e, in, out, radii[r]);
+                }
+                BaselineAdd(&cur, engine_names[e], W, H, radii[r], samples, reps);
+
+                qsort(samples, reps, sizeof(double), compareDouble);
+                fprintf(report, "%s,%d,%d,%d,%d,%.6f,%.6f\n",
+                        engine_names[e], W, H, radii[r], reps,
+                        median(samples, reps), samples[0]);
+                fflush(report);
+            }
+        }
+
+        ImageFree(in);
+        ImageFree(out);
+    }
+
+    free(samples);
+
+    int status = 0;
+
+    if (compare) {
+        Baseline base;
+        int found = BaselineLoad(compare, cur.fingerprint, &base);
+
+        if (found < 0) {
+            fprintf(stderr, "bench: cannot read baseline %s\n", compare);
+            status = 2;
+        } else if (found > 0) {
+            fprintf(stderr, "bench: %s has no baseline for host %s\n", compare, cur.fingerprint);
+            status = 2;
+        } else {
+            int regressions = BaselineCompare(&base, &cur, threshold, alpha);
+            fprintf(stderr, "bench: %d regression(s)\n", regressions);
+            status = regressions > 0;
+            BaselineFree(&base);
+        }
+    }
+
+    if (save && BaselineSave(save, &cur) != 0) {
+        fprintf(stderr, "bench: cannot write baseline %s\n", save);
+        status = 2;
+    }
+
+    BaselineFree(&cur);
+
+    return status;
+}
@@ -0,0 +1,44 @@
+/**
+ * Benchmark harness.
+ *
+ * Runs the engines on synthetic images and reports timings as CSV on stdout.
+ * Each timing is the median of several repetitions, taken per pass so that a
+ * regression or a scaling limit can be attributed to one loop.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "ppmFile.h"
+#include "sat.h"
+
+typedef struct PassTimes {
+    double row;         // SatRowPass()
+    double column;      // SatColumnPass()
+    double evaluate;    // BoxBlur()
+    double total;
+} PassTimes;
+
+typedef enum {
+    BENCH_BOX, BENCH_BOX_TILED, BENCH_BOX_INTERLEAVED, BENCH_DISK, BENCH_POLYGON, BENCH_SEP, BENCH_CONV,
+    BENCH_ENGINE_COUNT
+} BenchEngine;
+
+// An image of the given size filled with pseudo-random pixels.
+Image *BenchImage(int width, int height, unsigned seed);
+
+// Median time of each pass of the box blur over `reps` repetitions.
+PassTimes BenchBoxPasses(Image *in, Image *out, int R, SatLayout layout, int reps);
+
+const char *BenchEngineName(BenchEngine engine);
+
+// Run an engine end to end, including building its tables, and return the
+// time it took in seconds.
+double BenchEngineRun(BenchEngine engine, Image *in, Image *out, int R);
+
+// Entry points of `fast_blur --bench-scaling ...` and `fast_blur --bench ...`;
+// `argv[0]` is the mode.
+int BenchScalingMain(int argc, char *argv[]);
+int BenchMain(int argc, char *argv[]);
+
+#endif
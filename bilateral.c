@@ -0,0 +1,282 @@
+/**
+ * Bilateral grid, see bilateral.h.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bilateral.h"
+#include "memTrack.h"
+
+#define min(X, Y) (((X) < (Y)) ? (X) : (Y))
+#define max(X, Y) (((X) < (Y)) ? (Y) : (X))
+
+// Homogeneous sums of a cell: red, green, blue and the pixel count.
+#define SUMS 4
+
+typedef float Cell __attribute__((vector_size(SUMS * sizeof(float))));
+
+static inline int luma(int r, int g, int b) {
+    return (77 * r + 150 * g + 29 * b + 128) >> 8;
+}
+
+typedef struct Grid {
+    int width;      // Cells along x, y and luma.
+    int height;
+    int depth;
+    size_t plane;   // Cells per z slice.
+} Grid;
+
+/**
+ * Splat the pixels whose nearest z slice is in [z_first, z_first + slices)
+ * into `planes`: `slices` slices of SUMS planes each. Pixel rows that round to
+ * different grid rows never share a cell, so grid rows are split over the
+ * threads.
+ */
+static void splat(
+    float *planes, int z_first, int slices, const Grid *g,
+    Image *img, const unsigned char *lum, const BilateralOptions *opts
+) {
+    const int W = img->width;
+    const int H = img->height;
+    const int ss = opts->spatial;
+    const int sr = opts->range;
+
+    #pragma omp parallel for schedule(static, 1)
+    for (int gy = 0; gy < g->height; gy++) {
+        for (int y = max(gy * ss - ss / 2, 0); y < min(gy * ss + (ss + 1) / 2, H); y++) {
+            for (int x = 0; x < W; x++) {
+                const int l = lum[(size_t)y * W + x];
+                const int s = (l + sr / 2) / sr - z_first;
+
+                if (s < 0 || s >= slices) {
+                    continue;
+                }
+
+                const int gx = (x + ss / 2) / ss;
+                float *cell = planes + (size_t)s * SUMS * g->plane + (size_t)gy * g->width + gx;
+
+                cell[0] += ImageGetPixel(img, x, y, 0);
+                cell[g->plane] += ImageGetPixel(img, x, y, 1);
+                cell[2 * g->plane] += ImageGetPixel(img, x, y, 2);
+                cell[3 * g->plane] += 1.0f;
+            }
+        }
+    }
+}
+
+/**
+ * Sum the 2r + 1 cells around every cell of a W x H plane along x, then along
+ * y, with nothing outside the plane. Homogeneous sums must be padded with
+ * zeros: replicating the border cells would count their pixels again.
+ */
+static void boxPlane(float *plane, float *tmp, int W, int H, int r) {
+    #pragma omp parallel for schedule(static, 4)
+    for (int y = 0; y < H; y++) {
+        const float *src = plane + (size_t)y * W;
+        float *dst = tmp + (size_t)y * W;
+
+        for (int x = 0; x < W; x++) {
+            float sum = 0.0f;
+
+            for (int k = max(x - r, 0); k <= min(x + r, W - 1); k++) {
+                sum += src[k];
+            }
+            dst[x] = sum;
+        }
+    }
+
+    // Rows of taps outside, contiguous cells inside.
+    #pragma omp parallel for schedule(static, 4)
+    for (int y = 0; y < H; y++) {
+        float *dst = plane + (size_t)y * W;
+
+        for (int x = 0; x < W; x++) {
+            dst[x] = 0.0f;
+        }
+        for (int k = max(y - r, 0); k <= min(y + r, H - 1); k++) {
+            const float *src = tmp + (size_t)k * W;
+
+            for (int x = 0; x < W; x++) {
+                dst[x] += src[x];
+            }
+        }
+    }
+}
+
+/**
+ * Trilinear interpolation of the interleaved cells at (xf, yf, zf), with the
+ * z slice taken relative to the first slice of `cells`, divided through by
+ * the count.
+ */
+static inline Cell slice(const Cell *cells, const Grid *g, float xf, float yf, float zf) {
+    const int x = (int)xf;
+    const int y = (int)yf;
+    const int z = (int)zf;
+    const float wx = xf - x;
+    const float wy = yf - y;
+    const float wz = zf - z;
+    const Cell *c = cells + (size_t)z * g->plane + (size_t)y * g->width + x;
+    const Cell *n = c + g->plane;
+
+    Cell near = (1.0f - wy) * ((1.0f - wx) * c[0] + wx * c[1])
+              + wy * ((1.0f - wx) * c[g->width] + wx * c[g->width + 1]);
+    Cell far = (1.0f - wy) * ((1.0f - wx) * n[0] + wx * n[1])
+             + wy * ((1.0f - wx) * n[g->width] + wx * n[g->width + 1]);
+
+    return (1.0f - wz) * near + wz * far;
+}
+
+void BilateralGrid(Image *img_in, Image *img_out, const BilateralOptions *opts) {
+    const int W = img_in->width;
+    const int H = img_in->height;
+    const int ss = opts->spatial;
+    const int sr = opts->range;
+    const int r = opts->radius;
+
+    // One cell past the last splat position along each axis, for the upper
+    // corners of the interpolation.
+    Grid g;
+    g.width = (W - 1 + ss / 2) / ss + 2;
+    g.height = (H - 1 + ss / 2) / ss + 2;
+    g.depth = (255 + sr / 2) / sr + 2;
+    g.plane = (size_t)g.width * g.height;
+
+    // A slab of S slices is sliced from slices [z0, z0 + S], whose blur reads
+    // the splats of [z0 - r, z0 + S + r].
+    const int S = max(min(opts->slab, g.depth - 1), 1);
+    const int slices = S + 1 + 2 * r;
+    float *planes = MemAlloc(sizeof(float) * SUMS * g.plane * slices);
+    float *tmp = MemAlloc(sizeof(float) * g.plane);
+    Cell *cells = MemAlloc(sizeof(Cell) * g.plane * (S + 1));
+    unsigned char *lum = MemAlloc((size_t)W * H);
+
+    if (!planes || !tmp || !cells || !lum) {
+        fprintf(stderr, "bilateral: cannot allocate memory for grid\n");
+        exit(1);
+    }
+
+    #pragma omp parallel for schedule(static, 4)
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            lum[(size_t)y * W + x] = luma(
+                ImageGetPixel(img_in, x, y, 0),
+                ImageGetPixel(img_in, x, y, 1),
+                ImageGetPixel(img_in, x, y, 2)
+            );
+        }
+    }
+
+    for (int z0 = 0; z0 < g.depth - 1; z0 += S) {
+        const int z_first = z0 - r;
+
+        memset(planes, 0, sizeof(float) * SUMS * g.plane * slices);
+        splat(planes, z_first, slices, &g, img_in, lum, opts);
+
+        // x and y, then z: cells outside the grid hold nothing, and the
+        // homogeneous sums need no normalization, so the box is a plain sum
+        // along every axis. The result is interleaved for slicing.
+        for (size_t p = 0; p < (size_t)SUMS * slices; p++) {
+            boxPlane(planes + p * g.plane, tmp, g.width, g.height, r);
+        }
+
+        #pragma omp parallel for schedule(static, 4)
+        for (size_t i = 0; i < g.plane * (S + 1); i++) {
+            const size_t k = i / g.plane;
+            const size_t cell = i % g.plane;
+            Cell sum = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+            for (size_t s = k; s <= k + 2 * r; s++) {
+                const float *p = planes + s * SUMS * g.plane + cell;
+                Cell v = { p[0], p[g.plane], p[2 * g.plane], p[3 * g.plane] };
+                sum += v;
+            }
+            cells[i] = sum;
+        }
+
+        // The pixels whose luma lies between slices z0 and z0 + S.
+        #pragma omp parallel for schedule(static, 4)
+        for (int y = 0; y < H; y++) {
+            const float yf = (float)y / ss;
+
+            for (int x = 0; x < W; x++) {
+                const int l = lum[(size_t)y * W + x];
+                const float zf = (float)l / sr - z0;
+
+                if (zf < 0.0f || zf >= S) {
+                    continue;
+                }
+
+                Cell v = slice(cells, &g, (float)x / ss, yf, zf);
+                for (int color = 0; color < 3; color++) {
+                    const int s = v[3] > 0.0f
+                        ? (int)(v[color] / v[3] + 0.5f)
+                        : ImageGetPixel(img_in, x, y, color);
+                    ImageSetPixel(img_out, x, y, color, min(max(s, 0), 255));
+                }
+            }
+        }
+    }
+
+    MemFree(planes);
+    MemFree(tmp);
+    MemFree(cells);
+    MemFree(lum);
+}
+
+static void bilateralUsage(void) {
+    fprintf(stderr,
+        "usage: fast_blur --bilateral [options] input.ppm output.ppm\n"
+        "\n"
+        "Edge-preserving blur: averages pixels that are close both in space\n"
+        "and in luma, through a bilateral grid.\n"
+        "\n"
+        "options:\n"
+        "  --spatial S    pixels per grid cell along x and y (default 16)\n"
+        "  --range L      luma levels per grid cell (default 16)\n"
+        "  --radius R     box radius of the grid blur in cells (default 1)\n"
+        "  --slab N       z slices of the grid held at a time (default 4)\n");
+    exit(1);
+}
+
+int BilateralMain(int argc, char *argv[]) {
+    BilateralOptions opts = { 16, 16, 1, 4 };
+
+    if (argc < 3) {
+        bilateralUsage();
+    }
+    for (int i = 1; i < argc - 2; i++) {
+        const char *opt = argv[i];
+        const char *val = i + 1 < argc - 2 ? argv[i + 1] : NULL;
+
+        if (!val) {
+            bilateralUsage();
+        } else if (strcmp(opt, "--spatial") == 0) {
+            opts.spatial = atoi(val);
+        } else if (strcmp(opt, "--range") == 0) {
+            opts.range = atoi(val);
+        } else if (strcmp(opt, "--radius") == 0) {
+            opts.radius = atoi(val);
+        } else if (strcmp(opt, "--slab") == 0) {
+            opts.slab = atoi(val);
+        } else {
+            bilateralUsage();
+        }
+        i++;
+    }
+    if (opts.spatial < 1 || opts.range < 1 || opts.radius < 0 || opts.slab < 1) {
+        bilateralUsage();
+    }
+
+    Image *img_in = ImageRead(argv[argc - 2]);
+    Image *img_out = ImageCreate(img_in->width, img_in->height);
+
+    BilateralGrid(img_in, img_out, &opts);
+
+    ImageWrite(img_out, argv[argc - 1]);
+    ImageFree(img_in);
+    ImageFree(img_out);
+
+    return 0;
+}
@@ -0,0 +1,38 @@
+/**
+ * Edge-preserving blur with a bilateral grid.
+ *
+ * A bilateral filter averages pixels that are close both in space and in
+ * intensity, which costs O(R^2) per pixel when done directly. The bilateral
+ * grid instead splats every pixel into a coarse 3D grid over (x, y, luma),
+ * `spatial` pixels and `range` luma levels per cell, as homogeneous sums
+ * (r, g, b, count). The grid is box-blurred along all three axes, and each
+ * pixel reads its result back by trilinear interpolation at its own (x, y,
+ * luma): the sums divided by the count.
+ *
+ * The blur is a plain sum with zeros outside the grid along every axis, since
+ * replicating border cells would count their pixels twice. The grid is processed in slabs of z slices, so
+ * only a slab, plus the slices its blur reaches, is held at a time, and the
+ * pixels whose luma falls into the slab are sliced from it. Sliced cells are
+ * interleaved so that each of the eight corners is one vector of all four
+ * sums.
+ */
+
+#ifndef BILATERAL_H
+#define BILATERAL_H
+
+#include "ppmFile.h"
+
+typedef struct BilateralOptions {
+    int spatial;    // Pixels per grid cell along x and y.
+    int range;      // Luma levels per grid cell.
+    int radius;     // Box radius of the grid blur, in cells.
+    int slab;       // z slices per slab.
+} BilateralOptions;
+
+// Filter `img_in` into `img_out`, which has the same size.
+void BilateralGrid(Image *img_in, Image *img_out, const BilateralOptions *opts);
+
+// Entry point of `fast_blur --bilateral ...`; `argv[0]` is the mode.
+int BilateralMain(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,120 @@
+/**
+ * Box blur, see boxBlur.h.
+ */
+
+#include "boxBlur.h"
+
+#define min(X, Y) (((X) < (Y)) ? (X) : (Y))
+#define max(X, Y) (((X) < (Y)) ? (Y) : (X))
+
+// With interleaved entries each corner is one vector load and the rectangle
+// sum is computed for all channels at once.
+static void boxRowsInterleaved(Image *img_out, const Sat *sat, int R, int row0, int row1) {
+    const int H = sat->height;
+    const int W = sat->width;
+    const SatVec zero = { 0, 0, 0, 0 };
+
+    for (int row = row0; row < row1; row++) {
+        int y_min = max(row - R, 0);
+        int y_max = min(row + R, H - 1);
+        unsigned char *out = img_out->data + (size_t)row * img_out->stride;
+
+        for (int col = 0; col < W; col++, out += 3) {
+            int x_min = max(col - R, 0);
+            int x_max = min(col + R, W - 1);
+            int pixels = (x_max - (x_min - 1)) * (y_max - (y_min - 1));
+
+            // Same corners as below.
+            SatVec a = y_min < 1 || x_min < 1 ? zero : SatEntry(sat, y_min - 1, x_min - 1);
+            SatVec b = y_min < 1 ? zero : SatEntry(sat, y_min - 1, x_max);
+            SatVec c = x_min < 1 ? zero : SatEntry(sat, y_max, x_min - 1);
+            SatVec d = SatEntry(sat, y_max, x_max);
+            SatVec sum = d - (b + c - a);
+
+            out[0] = SatMean(sum[0], pixels);
+            out[1] = SatMean(sum[1], pixels);
+            out[2] = SatMean(sum[2], pixels);
+        }
+    }
+}
+
+void BoxBlurBand(Image *img_out, const Sat *sat, int R, int row0, int row1) {
+    const int H = sat->height;
+    const int W = sat->width;
+    int *sums_r = sat->sums_r;
+    int *sums_g = sat->sums_g;
+    int *sums_b = sat->sums_b;
+
+    if (sat->layout == SAT_INTERLEAVED) {
+        boxRowsInterleaved(img_out, sat, R, row0, row1);
+        return;
+    }
+
+    for (int row = row0; row < row1; row++) {
+        for (int col = 0; col < W; col++) {
+            // Coordinated of the corners of the square surrounding the pixel.
+            int x_min = max(col - R, 0);
+            int x_max = min(col + R, W - 1);
+            int y_min = max(row - R, 0);
+            int y_max = min(row + R, H - 1);
+
+            // Number of pixels in the square.
+            int pixels = (x_max - (x_min - 1)) * (y_max - (y_min - 1));
+
+            // Do for each color channel (red, green, blue).
+            for (int color = 0; color < 3; color++) {
+                int *sums_color
+                    = color == 0 ? sums_r
+                    : color == 1 ? sums_g
+                    :              sums_b;
+
+                // The computation occurring below can be visually described,
+                //      0      m        n
+                //    0 +------+--------+-> rows
+                //      |  a   |   b    |
+                //    p +------+--------+
+                //      |      |        |
+                //      |  c   |   d    |
+                //      |      |        |
+                //    q +------+--------+
+                //      |
+                //      v
+                //     columns
+                //
+                //  Where,
+                //     'a' is a rectangle from (0, 0) to (p, m)
+                //     'b' is a rectangle from (0, 0) to (p, n)
+                //     'c' is a rectangle from (0, 0) to (q, m)
+                //     'd' is a rectangle from (0, 0) to (q, n)
+                //
+                // The current pixel is in the middle of the box from (p, m) to
+                // (q, n). The sum of all the pixels in the box surrounding the
+                // pixel is then equal to `d - (c + b - a)`.
+                int a = y_min < 1 || x_min < 1
+                    ? 0
+                    : sums_color[SatIndex(sat, y_min - 1, x_min - 1)];
+                int b = y_min < 1
+                    ? 0
+                    : sums_color[SatIndex(sat, y_min - 1, x_max)];
+                int c = x_min < 1
+                    ? 0
+                    : sums_color[SatIndex(sat, y_max, x_min - 1)];
+                int d = sums_color[SatIndex(sat, y_max, x_max)];
+
+                // Pixel's blurred value
+                unsigned char s = SatMean(d - (b + c - a), pixels);
+
+                ImageSetPixel(img_out, col, row, color, s);
+            }
+        }
+    }
+}
+
+void BoxBlur(Image *img_out, const Sat *sat, int R) {
+    const int H = sat->height;
+
+    #pragma omp parallel for schedule(static, 4)
+    for (int row = 0; row < H; row++) {
+        BoxBlurBand(img_out, sat, R, row, row + 1);
+    }
+}
@@ -0,0 +1,18 @@
+/**
+ * Box blur: every pixel becomes the average of the (2R + 1) x (2R + 1) square
+ * surrounding it, clamped to the image.
+ */
+
+#ifndef BOX_BLUR_H
+#define BOX_BLUR_H
+
+#include "ppmFile.h"
+#include "sat.h"
+
+// Evaluate the blur from a table holding both passes.
+void BoxBlur(Image *img_out, const Sat *sat, int R);
+
+// Same for output rows [row0, row1) only, on the calling thread.
+void BoxBlurBand(Image *img_out, const Sat *sat, int R, int row0, int row1);
+
+#endif
@@ -0,0 +1,1272 @@
+/**
+ * Differential checker (fast_blur_check)
+ *
+ * Runs every engine against the golden references in reference.c over
+ * randomized cases: image sizes from 1 pixel up, radii including 0 and radii
+ * at least as large as the image, random kernels including negative lobes.
+ * Exact engines must match the reference bit for bit; engines that round
+ * differently (float accumulation, FFT) must stay within their declared error
+ * bound. Prints one CSV row per engine and exits with status 1 on a failure.
+ *
+ * Each engine has one border rule, which the reference follows: windowed
+ * means and the median shrink the window to the part inside the image, the
+ * convolutions clamp coordinates. Engines on packed RGB or masks are run at
+ * that channel count; the plane engines take any count, from 1 to 4 per case.
+ *
+ * Template matching is checked by cutting the template out of the image: the
+ * output marks the best peak, which must be where the template came from.
+ *
+ * Readers of untrusted headers are checked on every truncation of a valid
+ * one, in a forked process that must die instead of succeeding or hanging.
+ *
+ * The tiled container is checked through its blur: the case is written to a
+ * temporary tiled file, blurred tile by tile into another and read back.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+
+#include "ppmFile.h"
+#include "sat.h"
+#include "satQuery.h"
+#include "boxBlur.h"
+#include "diskBlur.h"
+#include "sepConv.h"
+#include "conv2d.h"
+#include "match.h"
+#include "histogram.h"
+#include "clahe.h"
+#include "bilateral.h"
+#include "mosaic.h"
+#include "maskBlur.h"
+#include "atlas.h"
+#include "tiledFile.h"
+#include "journal.h"
+#include "ring.h"
+#include "daemon.h"
+#include "reference.h"
+
+/**
+ * One randomized case. Every engine uses the fields that apply to it.
+ */
+typedef struct Case {
+    int width;
+    int height;
+    int channels;
+    const unsigned char *pixels;
+    int R;
+
+    Kernel1D kx;        // Separable kernels, normalized.
+    Kernel1D ky;
+    Kernel2D kernel;    // 2D kernel, normalized.
+} Case;
+
+typedef struct EngineCheck {
+    const char *name;
+    int channels;       // Channel count the engine supports, 0 for any.
+    int max_error;      // 0 if the engine must be bit-exact.
+    void (*run)(const Case *c, unsigned char *out);
+    void (*ref)(const Case *c, unsigned char *out);
+} EngineCheck;
+
+static unsigned rng = 12345;
+
+static unsigned next(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static float uniform(float lo, float hi) {
+    return lo + (hi - lo) * (next() >> 8) / (float)(1 << 24);
+}
+
+/**
+ * Run a summed-area table engine on the case's image.
+ */
+static void runSat(const Case *c, unsigned char *out, SatLayout layout, int disk, int bands) {
+    Image *in = ImageCreate(c->width, c->height);
+    Image *res = ImageCreate(c->width, c->height);
+    Sat *sat = SatCreate(c->width, c->height, layout);
+
+    memcpy(in->data, c->pixels, (size_t)c->width * c->height * 3);
+    SatRowPass(sat, in);
+    if (disk) {
+        DiskBlur(res, sat, c->R);
+    } else {
+        SatColumnPass(sat);
+        if (bands) {
+            PolygonBlur(res, sat, c->R, bands);
+        } else {
+            BoxBlur(res, sat, c->R);
+        }
+    }
+    memcpy(out, res->data, (size_t)c->width * c->height * 3);
+
+    SatFree(sat);
+    ImageFree(in);
+    ImageFree(res);
+}
+
+static void runBox(const Case *c, unsigned char *out) {
+    runSat(c, out, SAT_ROW_MAJOR, 0, 0);
+}
+
+static void runBoxTiled(const Case *c, unsigned char *out) {
+    runSat(c, out, SAT_TILED, 0, 0);
+}
+
+static void runBoxInterleaved(const Case *c, unsigned char *out) {
+    runSat(c, out, SAT_INTERLEAVED, 0, 0);
+}
+
+static void runDisk(const Case *c, unsigned char *out) {
+    runSat(c, out, SAT_ROW_MAJOR, 1, 0);
+}
+
+// With one band per row the polygon is exactly the disk. The radius picks the
+// layout, so that every layout is covered.
+static void runPolygon(const Case *c, unsigned char *out) {
+    const SatLayout layouts[3] = { SAT_ROW_MAJOR, SAT_TILED, SAT_INTERLEAVED };
+    runSat(c, out, layouts[c->R % 3], 0, c->R + 1);
+}
+
+// Band counts from 1 to past R + 1, which the engine clamps.
+static int polygonBands(const Case *c) {
+    return 1 + c->kernel.width * c->kernel.height % (c->R + 3);
+}
+
+static void runPolygonBands(const Case *c, unsigned char *out) {
+    const SatLayout layouts[3] = { SAT_ROW_MAJOR, SAT_TILED, SAT_INTERLEAVED };
+    runSat(c, out, layouts[c->kernel.height % 3], 0, polygonBands(c));
+}
+
+/**
+ * The box blur through the rectangle queries: one rectangle per pixel as a
+ * batch, or a template swept with a step of one pixel. The template weighs the
+ * box twice and subtracts it once, to exercise the weights.
+ */
+static void runRects(const Case *c, unsigned char *out, SatLayout layout, int sweep) {
+    const int W = c->width, H = c->height, R = c->R;
+    const size_t n = (size_t)W * H;
+    Image *in = ImageCreate(W, H);
+    Sat *sat = SatCreate(W, H, layout);
+    int *sums = malloc(sizeof(int) * 3 * n);
+
+    memcpy(in->data, c->pixels, n * 3);
+    SatRowPass(sat, in);
+    SatColumnPass(sat);
+
+    if (sweep) {
+        const SatRect box[2] = { { -R, -R, R, R }, { -R, -R, R, R } };
+        const int weights[2] = { 2, -1 };
+        const SatTemplate tpl = { box, weights, 2 };
+        SatSweep(sat, &tpl, 0, 0, 1, 1, W, H, sums);
+    } else {
+        SatRect *rects = malloc(sizeof(SatRect) * n);
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                rects[(size_t)y * W + x] = (SatRect){ x - R, y - R, x + R, y + R };
+            }
+        }
+        SatQuery(sat, rects, n, sums);
+        free(rects);
+    }
+
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            int w = (x + R < W ? x + R : W - 1) - (x - R > 0 ? x - R : 0) + 1;
+            int h = (y + R < H ? y + R : H - 1) - (y - R > 0 ? y - R : 0) + 1;
+            for (int k = 0; k < 3; k++) {
+                size_t i = ((size_t)y * W + x) * 3 + k;
+                out[i] = SatMean(sums[i], w * h);
+            }
+        }
+    }
+
+    free(sums);
+    SatFree(sat);
+    ImageFree(in);
+}
+
+static void runBoxQuery(const Case *c, unsigned char *out) {
+    runRects(c, out, c->R % 2 ? SAT_INTERLEAVED : SAT_ROW_MAJOR, 0);
+}
+
+static void runBoxSweep(const Case *c, unsigned char *out) {
+    runRects(c, out, c->R % 2 ? SAT_ROW_MAJOR : SAT_INTERLEAVED, 1);
+}
+
+// Input and output as views into larger buffers, with padding between rows.
+static void runBoxView(const Case *c, unsigned char *out) {
+    const int stride = 3 * c->width + 5;
+    unsigned char *in_buf = malloc((size_t)stride * c->height);
+    unsigned char *out_buf = malloc((size_t)stride * c->height);
+    Image in = ImageView(in_buf, c->width, c->height, stride);
+    Image res = ImageView(out_buf, c->width, c->height, stride);
+    Sat *sat = SatCreate(c->width, c->height, SAT_ROW_MAJOR);
+
+    for (int y = 0; y < c->height; y++) {
+        memcpy(in_buf + (size_t)y * stride, c->pixels + (size_t)y * c->width * 3, c->width * 3);
+    }
+    SatRowPass(sat, &in);
+    SatColumnPass(sat);
+    BoxBlur(&res, sat, c->R);
+    for (int y = 0; y < c->height; y++) {
+        memcpy(out + (size_t)y * c->width * 3, out_buf + (size_t)y * stride, c->width * 3);
+    }
+
+    SatFree(sat);
+    free(in_buf);
+    free(out_buf);
+}
+
+static void runSep(const Case *c, unsigned char *out) {
+    Image *in = ImageCreate(c->width, c->height);
+    Image *res = ImageCreate(c->width, c->height);
+
+    memcpy(in->data, c->pixels, (size_t)c->width * c->height * 3);
+    SepConv(in, res, &c->kx, &c->ky);
+    memcpy(out, res->data, (size_t)c->width * c->height * 3);
+
+    ImageFree(in);
+    ImageFree(res);
+}
+
+/**
+ * The separable convolution plane by plane, for any channel count: the
+ * channels are split into planes, convolved one at a time and rounded back
+ * as PlanesToImage() does.
+ */
+static void runSepChannels(const Case *c, unsigned char *out) {
+    const int C = c->channels;
+    const size_t n = (size_t)c->width * c->height;
+    float *plane = malloc(sizeof(float) * n);
+    float *tmp = malloc(sizeof(float) * n);
+
+    for (int ch = 0; ch < C; ch++) {
+        for (size_t i = 0; i < n; i++) {
+            plane[i] = c->pixels[i * C + ch];
+        }
+        SepConvPlane(plane, plane, tmp, c->width, c->height, &c->kx, &c->ky);
+        for (size_t i = 0; i < n; i++) {
+            float v = plane[i] + 0.5f;
+            out[i * C + ch] = v < 0.0f ? 0 : v > 255.0f ? 255 : (unsigned char)v;
+        }
+    }
+
+    free(plane);
+    free(tmp);
+}
+
+static void runConv(const Case *c, unsigned char *out, ConvEngine engine) {
+    Image *in = ImageCreate(c->width, c->height);
+    Image *res = ImageCreate(c->width, c->height);
+
+    memcpy(in->data, c->pixels, (size_t)c->width * c->height * 3);
+    Conv2D(in, res, &c->kernel, ConvPlanCreate(&c->kernel, engine));
+    memcpy(out, res->data, (size_t)c->width * c->height * 3);
+
+    ImageFree(in);
+    ImageFree(res);
+}
+
+static void runConvDirect(const Case *c, unsigned char *out) {
+    runConv(c, out, CONV_DIRECT);
+}
+
+static void runConvFft(const Case *c, unsigned char *out) {
+    runConv(c, out, CONV_FFT);
+}
+
+static void refBox(const Case *c, unsigned char *out) {
+    RefBlur(c->pixels, out, c->width, c->height, c->channels, c->R, REF_SQUARE);
+}
+
+static void refDisk(const Case *c, unsigned char *out) {
+    RefBlur(c->pixels, out, c->width, c->height, c->channels, c->R, REF_DISK);
+}
+
+static void refPolygon(const Case *c, unsigned char *out) {
+    RefPolygon(c->pixels, out, c->width, c->height, c->channels, c->R, polygonBands(c));
+}
+
+static void refSep(const Case *c, unsigned char *out) {
+    const int kw = 2 * c->kx.radius + 1;
+    const int kh = 2 * c->ky.radius + 1;
+    float *taps = malloc(sizeof(float) * kw * kh);
+
+    for (int i = 0; i < kh; i++) {
+        for (int j = 0; j < kw; j++) {
+            taps[i * kw + j] = c->ky.taps[i] * c->kx.taps[j];
+        }
+    }
+    RefConvolve(c->pixels, out, c->width, c->height, c->channels, taps, kw, kh);
+
+    free(taps);
+}
+
+static void refConv(const Case *c, unsigned char *out) {
+    RefConvolve(
+        c->pixels, out, c->width, c->height, c->channels,
+        c->kernel.taps, c->kernel.width, c->kernel.height
+    );
+}
+
+/**
+ * Where the template of a matching case comes from: a window of the case's 2D
+ * kernel size, clamped to the image, at a position derived from the radius.
+ * Windows of fewer than 4 pixels are skipped, since noise can repeat there.
+ */
+static int matchWindow(const Case *c, int *x, int *y, int *tw, int *th) {
+    *tw = c->kernel.width < c->width ? c->kernel.width : c->width;
+    *th = c->kernel.height < c->height ? c->kernel.height : c->height;
+    *x = c->R % (c->width - *tw + 1);
+    *y = c->R / 2 % (c->height - *th + 1);
+    return *tw * *th >= 4;
+}
+
+static void runMatch(const Case *c, unsigned char *out) {
+    int x, y, tw, th;
+
+    memset(out, 0, (size_t)c->width * c->height * 3);
+    if (!matchWindow(c, &x, &y, &tw, &th)) {
+        return;
+    }
+
+    Image *img = ImageCreate(c->width, c->height);
+    Image *tpl = ImageCreate(tw, th);
+    memcpy(img->data, c->pixels, (size_t)c->width * c->height * 3);
+    for (int row = 0; row < th; row++) {
+        memcpy(tpl->data + (size_t)row * tw * 3,
+               c->pixels + ((size_t)(y + row) * c->width + x) * 3, (size_t)tw * 3);
+    }
+
+    // Both correlation engines, by the kernel's width.
+    MatchOptions opts = { c->kernel.width % 4 == 1 ? CONV_DIRECT : CONV_FFT, 1, 1 };
+    MatchPeak peak;
+    if (MatchTemplate(img, tpl, &opts, &peak) == 1) {
+        out[((size_t)peak.y * c->width + peak.x) * 3] = 1;
+    }
+
+    ImageFree(img);
+    ImageFree(tpl);
+}
+
+static void refMatch(const Case *c, unsigned char *out) {
+    int x, y, tw, th;
+
+    memset(out, 0, (size_t)c->width * c->height * 3);
+    if (matchWindow(c, &x, &y, &tw, &th)) {
+        out[((size_t)y * c->width + x) * 3] = 1;
+    }
+}
+
+/**
+ * Scores of the best peaks for a template cut out of the image with its low
+ * bits scrambled, so that no window matches exactly. Each of the first
+ * MATCH_PEAKS bytes holds a score mapped from [-1, 1] to [0, 255], best
+ * first, and 0 past the peaks found: a difference of 1 is a score error of
+ * at most 2/255.
+ */
+#define MATCH_PEAKS 3
+
+static unsigned char scoreByte(double score) {
+    return (unsigned char)lround((score + 1.0) * 127.5);
+}
+
+static Image *scrambledTemplate(const Case *c, int x, int y, int tw, int th) {
+    Image *tpl = ImageCreate(tw, th);
+
+    for (int row = 0; row < th; row++) {
+        for (int i = 0; i < tw * 3; i++) {
+            const unsigned char v = c->pixels[((size_t)(y + row) * c->width + x) * 3 + i];
+            tpl->data[(size_t)row * tw * 3 + i] = v ^ ((row * 5 + i * 3) & 15);
+        }
+    }
+    return tpl;
+}
+
+static void runMatchScores(const Case *c, unsigned char *out) {
+    int x, y, tw, th;
+
+    memset(out, 0, (size_t)c->width * c->height * 3);
+    if (!matchWindow(c, &x, &y, &tw, &th)) {
+        return;
+    }
+
+    Image *img = ImageCreate(c->width, c->height);
+    Image *tpl = scrambledTemplate(c, x, y, tw, th);
+    memcpy(img->data, c->pixels, (size_t)c->width * c->height * 3);
+
+    MatchOptions opts = {
+        c->kernel.height % 4 == 1 ? CONV_DIRECT : CONV_FFT, MATCH_PEAKS, 1 + c->R % 3
+    };
+    MatchPeak peaks[MATCH_PEAKS];
+    const int n = MatchTemplate(img, tpl, &opts, peaks);
+    for (int i = 0; i < n; i++) {
+        out[i] = scoreByte(peaks[i].score);
+    }
+
+    ImageFree(img);
+    ImageFree(tpl);
+}
+
+/**
+ * The same peaks from the reference scores: a peak is the best score within
+ * min_distance pixels, the first in raster order among equal ones, and peaks
+ * are ranked by score, earlier first among equal ones.
+ */
+static void refMatchScores(const Case *c, unsigned char *out) {
+    int x, y, tw, th;
+
+    memset(out, 0, (size_t)c->width * c->height * 3);
+    if (!matchWindow(c, &x, &y, &tw, &th)) {
+        return;
+    }
+
+    Image *tpl = scrambledTemplate(c, x, y, tw, th);
+    const int MW = c->width - tw + 1;
+    const int MH = c->height - th + 1;
+    const int d = 1 + c->R % 3;
+    double *score = malloc(sizeof(double) * MW * MH);
+    double best[MATCH_PEAKS];
+    int n = 0;
+
+    RefNcc(c->pixels, c->width, c->height, tpl->data, tw, th, score);
+
+    for (int py = 0; py < MH; py++) {
+        for (int px = 0; px < MW; px++) {
+            const double s = score[(size_t)py * MW + px];
+            int peak = 1;
+
+            for (int yy = py - d; peak && yy <= py + d; yy++) {
+                for (int xx = px - d; xx <= px + d; xx++) {
+                    if (yy < 0 || yy >= MH || xx < 0 || xx >= MW) {
+                        continue;
+                    }
+                    const double o = score[(size_t)yy * MW + xx];
+                    if (o > s || (o == s && (yy < py || (yy == py && xx < px)))) {
+                        peak = 0;
+                        break;
+                    }
+                }
+            }
+            if (!peak || (n == MATCH_PEAKS && s <= best[n - 1])) {
+                continue;
+            }
+
+            int i = n < MATCH_PEAKS ? n++ : n - 1;
+            while (i > 0 && best[i - 1] < s) {
+                best[i] = best[i - 1];
+                i--;
+            }
+            best[i] = s;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        out[i] = scoreByte(best[i]);
+    }
+
+    free(score);
+    ImageFree(tpl);
+}
+
+/**
+ * Median filter through the local-histogram queries, one table per channel.
+ * The cell size varies with the radius so that queries hit both the grid and
+ * the border strips.
+ */
+static void runHistMedian(const Case *c, unsigned char *out) {
+    const int W = c->width, H = c->height, R = c->R;
+    unsigned char *plane = malloc((size_t)W * H);
+    uint32_t counts[256];
+
+    for (int k = 0; k < 3; k++) {
+        for (size_t i = 0; i < (size_t)W * H; i++) {
+            plane[i] = c->pixels[3 * i + k];
+        }
+
+        Hist *hist = HistCreate(plane, W, H, W, 256, 1 + R % 7);
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                int pixels = HistQuery(hist, x - R, y - R, x + R, y + R, counts);
+                out[((size_t)y * W + x) * 3 + k] = HistRank(counts, 256, (pixels + 1) / 2);
+            }
+        }
+        HistFree(hist);
+    }
+
+    free(plane);
+}
+
+static void refMedian(const Case *c, unsigned char *out) {
+    RefMedian(c->pixels, out, c->width, c->height, c->channels, c->R);
+}
+
+// Tile counts and clip limit from the case; clip 0 disables clipping.
+static ClaheOptions claheOptions(const Case *c) {
+    ClaheOptions opts = { 1 + c->R % 5, 1 + c->kernel.width % 5, (c->kernel.height % 4) * 1.5f };
+    return opts;
+}
+
+static void runClahe(const Case *c, unsigned char *out) {
+    const ClaheOptions opts = claheOptions(c);
+    Image *in = ImageCreate(c->width, c->height);
+    Image *res = ImageCreate(c->width, c->height);
+
+    memcpy(in->data, c->pixels, (size_t)c->width * c->height * 3);
+    Clahe(in, res, &opts);
+    memcpy(out, res->data, (size_t)c->width * c->height * 3);
+
+    ImageFree(in);
+    ImageFree(res);
+}
+
+static void refClahe(const Case *c, unsigned char *out) {
+    const ClaheOptions opts = claheOptions(c);
+    RefClahe(c->pixels, out, c->width, c->height, opts.tiles_x, opts.tiles_y, opts.clip);
+}
+
+// Grid cell sizes and blur radius from the case; slabs of one to three slices
+// so that most cases cross slab boundaries.
+static BilateralOptions bilateralOptions(const Case *c) {
+    BilateralOptions opts = {
+        1 + c->R % 6, 4 + c->kernel.width * 7 % 60, c->kernel.height % 3, 1 + c->R % 3
+    };
+    return opts;
+}
+
+static void runBilateral(const Case *c, unsigned char *out) {
+    const BilateralOptions opts = bilateralOptions(c);
+    Image *in = ImageCreate(c->width, c->height);
+    Image *res = ImageCreate(c->width, c->height);
+
+    memcpy(in->data, c->pixels, (size_t)c->width * c->height * 3);
+    BilateralGrid(in, res, &opts);
+    memcpy(out, res->data, (size_t)c->width * c->height * 3);
+
+    ImageFree(in);
+    ImageFree(res);
+}
+
+static void refBilateral(const Case *c, unsigned char *out) {
+    const BilateralOptions opts = bilateralOptions(c);
+    RefBilateralGrid(c->pixels, out, c->width, c->height, opts.spatial, opts.range, opts.radius);
+}
+
+// Block size, alignment and regions from the case: the whole image, one
+// region, or two overlapping ones, some reaching past the image.
+static MosaicOptions mosaicOptions(const Case *c, SatRect *rois) {
+    const int W = c->width;
+    const int H = c->height;
+    const SatLayout layouts[3] = { SAT_ROW_MAJOR, SAT_TILED, SAT_INTERLEAVED };
+    MosaicOptions opts = {
+        1 + c->R % 9, c->kernel.width - 8, c->kernel.height, c->kernel.width % 4 == 1,
+        rois, c->R % 3, layouts[c->kernel.height % 3]
+    };
+
+    rois[0] = (SatRect){ W / 4, H / 4, W - 1, H * 3 / 4 };
+    rois[1] = (SatRect){ -2, -1, W / 2, H / 2 + 3 };
+    return opts;
+}
+
+static void runMosaic(const Case *c, unsigned char *out) {
+    SatRect rois[2];
+    const MosaicOptions opts = mosaicOptions(c, rois);
+    Image *in = ImageCreate(c->width, c->height);
+    Image *res = ImageCreate(c->width, c->height);
+
+    memcpy(in->data, c->pixels, (size_t)c->width * c->height * 3);
+    Mosaic(in, res, &opts);
+    memcpy(out, res->data, (size_t)c->width * c->height * 3);
+
+    ImageFree(in);
+    ImageFree(res);
+}
+
+static void refMosaic(const Case *c, unsigned char *out) {
+    SatRect rois[2];
+    const MosaicOptions opts = mosaicOptions(c, rois);
+    int corners[8];
+
+    for (int k = 0; k < 2; k++) {
+        corners[4 * k] = rois[k].x0;
+        corners[4 * k + 1] = rois[k].y0;
+        corners[4 * k + 2] = rois[k].x1;
+        corners[4 * k + 3] = rois[k].y1;
+    }
+    RefMosaic(
+        c->pixels, out, c->width, c->height, opts.block,
+        opts.align_x, opts.align_y, opts.align_roi, corners, opts.nrois
+    );
+}
+
+// The mask is the top bit of each pixel; a dense or sparse mask depending on
+// the case so that runs of set and clear words both occur.
+static int maskBit(const Case *c, size_t i) {
+    return c->kernel.width % 3 == 0 ? c->pixels[i] >= 32 : c->pixels[i] >= 128;
+}
+
+static void runMask(const Case *c, unsigned char *out) {
+    Bitmap *mask = BitmapCreate(c->width, c->height);
+
+    for (int y = 0; y < c->height; y++) {
+        for (int x = 0; x < c->width; x++) {
+            if (maskBit(c, (size_t)y * c->width + x)) {
+                mask->bits[(size_t)y * mask->stride + x / 8] |= 0x80 >> x % 8;
+            }
+        }
+    }
+    MaskBlur(mask, out, c->R);
+
+    BitmapFree(mask);
+}
+
+static void refMask(const Case *c, unsigned char *out) {
+    unsigned char *mask = malloc((size_t)c->width * c->height);
+
+    for (size_t i = 0; i < (size_t)c->width * c->height; i++) {
+        mask[i] = maskBit(c, i);
+    }
+    RefMaskBlur(mask, out, c->width, c->height, c->R);
+
+    free(mask);
+}
+
+/**
+ * The mask through a P4 file with a comment in its header, read back with
+ * BitmapRead(). Every truncation of that header, down to the comment alone
+ * and the empty file, must make a forked reader die with status 1 within a
+ * second instead of succeeding or spinning; if one does not, the output is
+ * cleared.
+ */
+static void runMaskFile(const Case *c, unsigned char *out) {
+    char path[64], header[64];
+    int ok = 1;
+
+    snprintf(path, sizeof(path), "/tmp/fast_blur_check_%d.pbm", (int)getpid());
+    const int len = snprintf(header, sizeof(header), "P4\n# check\n%d %d\n", c->width, c->height);
+    const size_t row = (c->width + 7) / 8;
+    unsigned char *bits = calloc(row, c->height);
+
+    for (int y = 0; y < c->height; y++) {
+        for (int x = 0; x < c->width; x++) {
+            if (maskBit(c, (size_t)y * c->width + x)) {
+                bits[y * row + x / 8] |= 0x80 >> x % 8;
+            }
+        }
+    }
+
+    for (int cut = 0; cut <= len; cut++) {
+        FILE *fp = fopen(path, "w");
+
+        if (!fp) {
+            fprintf(stderr, "check: cannot open %s\n", path);
+            exit(1);
+        }
+        fwrite(header, 1, cut, fp);
+        if (cut == len) {
+            fwrite(bits, row, c->height, fp);
+        }
+        fclose(fp);
+        if (cut == len) {
+            break;
+        }
+
+        // The reader dies through exit(), which would flush a copy of our
+        // pending output.
+        fflush(stdout);
+        pid_t reader = fork();
+        if (reader == 0) {
+            alarm(1);
+            freopen("/dev/null", "w", stderr);
+            BitmapFree(BitmapRead(path));
+            _exit(0);
+        }
+
+        int status;
+        waitpid(reader, &status, 0);
+        ok &= WIFEXITED(status) && WEXITSTATUS(status) == 1;
+    }
+
+    Bitmap *mask = BitmapRead(path);
+    MaskBlur(mask, out, c->R);
+    if (!ok) {
+        memset(out, 0, (size_t)c->width * c->height);
+    }
+
+    BitmapFree(mask);
+    free(bits);
+    unlink(path);
+}
+
+// Four sprites around a split point taken from the case, with a gap column,
+// rectangles reaching past the image and, for thin images, empty ones.
+static void atlasRects(const Case *c, SatRect *rects) {
+    const int cx = c->width * c->kernel.width / 16;
+    const int cy = c->height * c->kernel.height / 16;
+
+    rects[0] = (SatRect){ 0, 0, cx - 1, cy - 1 };
+    rects[1] = (SatRect){ cx + 1, 0, c->width - 1, cy - 1 };
+    rects[2] = (SatRect){ -3, cy, cx, c->height + 2 };
+    rects[3] = (SatRect){ cx + 1, cy + 1, c->width + 5, c->height - 1 };
+}
+
+static void runAtlas(const Case *c, unsigned char *out) {
+    const SatLayout layouts[3] = { SAT_ROW_MAJOR, SAT_TILED, SAT_INTERLEAVED };
+    SatRect rects[4];
+    Image *in = ImageCreate(c->width, c->height);
+    Image res = ImageView(out, c->width, c->height, c->width * 3);
+    Sat *sat = SatCreate(c->width, c->height, layouts[c->R % 3]);
+
+    atlasRects(c, rects);
+    memcpy(in->data, c->pixels, (size_t)c->width * c->height * 3);
+    memcpy(out, c->pixels, (size_t)c->width * c->height * 3);
+    SatRowPass(sat, in);
+    SatColumnPass(sat);
+    AtlasBlur(&res, sat, rects, 4, c->R);
+
+    SatFree(sat);
+    ImageFree(in);
+}
+
+static void refAtlas(const Case *c, unsigned char *out) {
+    SatRect rects[4];
+    int corners[16];
+
+    atlasRects(c, rects);
+    for (int k = 0; k < 4; k++) {
+        corners[4 * k] = rects[k].x0;
+        corners[4 * k + 1] = rects[k].y0;
+        corners[4 * k + 2] = rects[k].x1;
+        corners[4 * k + 3] = rects[k].y1;
+    }
+    RefAtlas(c->pixels, out, c->width, c->height, corners, 4, c->R);
+}
+
+// Tile sizes from 1 up, both codecs; odd radii blur the whole image as one
+// region instead of tile by tile.
+static void runTiled(const Case *c, unsigned char *out) {
+    const int W = c->width;
+    const int H = c->height;
+    const TiledCodec codec = c->kernel.height % 4 == 1 ? TILED_RAW : TILED_QOI;
+    char in_path[64], out_path[64];
+
+    snprintf(in_path, sizeof(in_path), "/tmp/fast_blur_check_%d_in.fbt", (int)getpid());
+    snprintf(out_path, sizeof(out_path), "/tmp/fast_blur_check_%d_out.fbt", (int)getpid());
+
+    TiledFile *in = TiledCreate(in_path, W, H, c->kernel.width + c->kernel.height / 2, codec);
+    for (int t = 0; t < in->tiles_x * in->tiles_y; t++) {
+        int x0, y0, w, h;
+
+        TiledTileBounds(in, t, &x0, &y0, &w, &h);
+        TiledWriteTile(in, t, c->pixels + ((size_t)y0 * W + x0) * 3, W * 3);
+    }
+    TiledClose(in);
+    in = TiledOpen(in_path);
+
+    if (c->R % 2) {
+        TiledBlurRegion(in, c->R, 0, 0, W, H, out, W * 3);
+    } else {
+        TiledFile *res = TiledCreate(out_path, W, H, in->tile, codec);
+        TiledBlur(in, res, c->R);
+        TiledClose(res);
+
+        res = TiledOpen(out_path);
+        TiledReadRegion(res, 0, 0, W, H, out, W * 3);
+        TiledClose(res);
+        unlink(out_path);
+    }
+
+    TiledClose(in);
+    unlink(in_path);
+}
+
+/**
+ * A journaled blur interrupted midway: the first half of the tiles is
+ * committed, one more tile is written but not recorded, and a torn record
+ * naming an unwritten tile follows the valid ones. Resuming must skip only
+ * the committed tiles and ignore the torn record.
+ */
+static void runTiledJournal(const Case *c, unsigned char *out) {
+    const int W = c->width;
+    const int H = c->height;
+    const TiledCodec codec = c->kernel.height % 4 == 1 ? TILED_RAW : TILED_QOI;
+    const int key = c->R;
+    char in_path[64], out_path[64], journal_path[72];
+
+    snprintf(in_path, sizeof(in_path), "/tmp/fast_blur_check_%d_in.fbt", (int)getpid());
+    snprintf(out_path, sizeof(out_path), "/tmp/fast_blur_check_%d_out.fbt", (int)getpid());
+    snprintf(journal_path, sizeof(journal_path), "%s.journal", out_path);
+
+    TiledFile *in = TiledCreate(in_path, W, H, c->kernel.width + c->kernel.height / 2, codec);
+    const int tiles = in->tiles_x * in->tiles_y;
+    int *order = malloc(sizeof(int) * tiles);
+    unsigned char *done = malloc(tiles);
+    int recorded, n = 0;
+
+    for (int t = 0; t < tiles; t++) {
+        int x0, y0, w, h;
+
+        TiledTileBounds(in, t, &x0, &y0, &w, &h);
+        TiledWriteTile(in, t, c->pixels + ((size_t)y0 * W + x0) * 3, W * 3);
+        order[t] = t;
+    }
+    TiledClose(in);
+    in = TiledOpen(in_path);
+
+    // The interrupted run.
+    const int committed = tiles / 2;
+    TiledFile *res = TiledCreate(out_path, W, H, in->tile, codec);
+    TiledSync(res);
+    Journal *journal = JournalCreate(journal_path, &key, sizeof(key), tiles);
+
+    TiledBlurTiles(in, res, c->R, order, committed);
+    TiledSync(res);
+    JournalCommit(journal, order, committed);
+    if (committed + 1 < tiles) {
+        TiledBlurTiles(in, res, c->R, order + committed, 1);
+    }
+    JournalClose(journal);
+    TiledClose(res);
+
+    const uint32_t torn[2] = { (uint32_t)(tiles - 1), 0 };
+    int fd = open(journal_path, O_WRONLY | O_APPEND);
+    if (fd < 0 || write(fd, torn, sizeof(torn)) != sizeof(torn)) {
+        fprintf(stderr, "check: cannot append to %s\n", journal_path);
+        exit(1);
+    }
+    close(fd);
+
+    // The resumed run.
+    journal = JournalOpen(journal_path, &key, sizeof(key), tiles, done, &recorded);
+    if (!journal || recorded != committed) {
+        fprintf(stderr, "check: journal replayed %d of %d tiles\n", journal ? recorded : -1, committed);
+        exit(1);
+    }
+    res = TiledOpenUpdate(out_path);
+    for (int t = 0; t < tiles; t++) {
+        if (!done[t]) {
+            order[n++] = t;
+        }
+    }
+    TiledBlurTiles(in, res, c->R, order, n);
+    TiledSync(res);
+    JournalCommit(journal, order, n);
+    JournalFinish(journal);
+    TiledClose(res);
+
+    res = TiledOpen(out_path);
+    TiledReadRegion(res, 0, 0, W, H, out, W * 3);
+    TiledClose(res);
+    TiledClose(in);
+    unlink(out_path);
+    unlink(in_path);
+    free(order);
+    free(done);
+}
+
+/**
+ * Frames through a shared-memory ring: a forked producer copies the image
+ * into each slot and a forked consumer, linking nothing but the ring, checks
+ * that the frames arrive in order and identical and pipes the last one back.
+ * This process is the blur stage, as `fast_blur --ring` would be.
+ */
+static void runRing(const Case *c, unsigned char *out) {
+    const int W = c->width;
+    const int H = c->height;
+    const int frames = 5;
+    const size_t bytes = (size_t)W * H * 3;
+    char name[64];
+    int fds[2];
+
+    snprintf(name, sizeof(name), "/fast_blur_check_%d", (int)getpid());
+    Ring *ring = RingCreate(name, W, H, 2);
+    if (!ring || pipe(fds) != 0) {
+        fprintf(stderr, "check: cannot create ring %s\n", name);
+        exit(1);
+    }
+
+    pid_t producer = fork();
+    if (producer == 0) {
+        Ring *r = RingOpen(name);
+        RingFrame *f;
+
+        for (int k = 0; r && k < frames && (f = RingAcquire(r, RING_PRODUCER)); k++) {
+            f->tag = k;
+            memcpy(f->pixels, c->pixels, bytes);
+            RingRelease(r, RING_PRODUCER);
+        }
+        if (r) {
+            RingClose(r, RING_PRODUCER);
+        }
+        _exit(r ? 0 : 1);
+    }
+
+    pid_t consumer = fork();
+    if (consumer == 0) {
+        Ring *r = RingOpen(name);
+        unsigned char *first = malloc(bytes);
+        RingFrame *f;
+        int k = 0, ok = r != NULL;
+
+        while (r && (f = RingAcquire(r, RING_CONSUMER))) {
+            ok &= f->tag == (uint64_t)k;
+            if (k++ == 0) {
+                memcpy(first, f->pixels, bytes);
+            }
+            ok &= memcmp(first, f->pixels, bytes) == 0;
+            RingRelease(r, RING_CONSUMER);
+        }
+        if (!ok || k != frames) {
+            memset(first, 0, bytes);
+        }
+        _exit(write(fds[1], first, bytes) == (ssize_t)bytes ? 0 : 1);
+    }
+
+    Sat *sat = SatCreate(W, H, SAT_ROW_MAJOR);
+    RingFrame *frame;
+
+    while ((frame = RingAcquire(ring, RING_WORKER))) {
+        Image img = RingImage(ring, frame);
+
+        SatRowPass(sat, &img);
+        SatColumnPass(sat);
+        BoxBlur(&img, sat, c->R);
+        RingRelease(ring, RING_WORKER);
+    }
+    RingClose(ring, RING_WORKER);
+
+    size_t got = 0;
+    ssize_t n;
+    while (got < bytes && (n = read(fds[0], out + got, bytes - got)) > 0) {
+        got += n;
+    }
+    waitpid(producer, NULL, 0);
+    waitpid(consumer, NULL, 0);
+    if (got < bytes) {
+        memset(out, 0, bytes);
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+    SatFree(sat);
+    RingDetach(ring);
+    RingUnlink(name);
+}
+
+/**
+ * Scheduling and failure isolation of a forked `fast_blur --daemon` with one
+ * worker. The first job is a batch job reading a FIFO; once the worker has
+ * opened it, the other jobs are queued behind it, and the daemon reports the
+ * malformed line after them once it has queued them all. Only then is the
+ * FIFO fed, and the order the jobs finish in is fixed:
+ *
+ *     tight   interactive, deadline 1 us   runs first and misses it
+ *     bad     interactive, no deadline     fails on its input, alone
+ *     soon    normal, deadline 100 s       overtakes `late`, queued before it
+ *     late    normal, no deadline
+ *     gate    batch, the FIFO              resumes only when nothing else is
+ *
+ * The output is the FIFO job's, cleared unless the order, the statuses and
+ * all four images are right.
+ */
+static void runDaemon(const Case *c, unsigned char *out) {
+    const size_t bytes = (size_t)c->width * c->height * 3;
+    const char *ids[5] = { "tight", "bad", "soon", "late", "gate" };
+    const char *statuses[5] = { "missed", "failed", "met", "none", "none" };
+    const char *outputs[3] = { "late", "soon", "tight" };
+    const char *files[4] = { "in", "bad", "gate", "gate_out" };
+    char dir[64], path[160], requests[1024], text[4096];
+    int in[2], res[2], err[2], fifo, ok = 1;
+
+    snprintf(dir, sizeof(dir), "/tmp/fast_blur_check_%d", (int)getpid());
+    Image *img = ImageCreate(c->width, c->height);
+    memcpy(img->data, c->pixels, bytes);
+
+    snprintf(path, sizeof(path), "%s_in.ppm", dir);
+    ImageWrite(img, path);
+    snprintf(path, sizeof(path), "%s_bad.ppm", dir);
+    FILE *fp = fopen(path, "w");
+    if (!fp || fputs("P6\n# truncated\n", fp) < 0 || fclose(fp) != 0) {
+        fprintf(stderr, "check: cannot write %s\n", path);
+        exit(1);
+    }
+    snprintf(path, sizeof(path), "%s_gate.ppm", dir);
+    if (mkfifo(path, 0600) != 0 || pipe(in) != 0 || pipe(res) != 0 || pipe(err) != 0) {
+        fprintf(stderr, "check: cannot create %s\n", path);
+        exit(1);
+    }
+
+    fflush(stdout);
+    pid_t daemon = fork();
+    if (daemon == 0) {
+        char *argv[] = { "--daemon", "--workers", "1", "--band", "1", NULL };
+
+        dup2(in[0], 0);
+        dup2(res[1], 1);
+        dup2(err[1], 2);
+        close(in[1]);
+        close(res[0]);
+        close(err[0]);
+        DaemonMain(5, argv);
+        fflush(stdout);
+        _exit(0);
+    }
+    close(in[0]);
+    close(res[1]);
+    close(err[1]);
+
+    // The FIFO opens for writing without blocking only once a reader has it:
+    // the worker is then held in the gate job's read.
+    snprintf(requests, sizeof(requests),
+             "gate batch 0 box %d %s_gate.ppm %s_gate_out.ppm\n", c->R, dir, dir);
+    if (write(in[1], requests, strlen(requests)) != (ssize_t)strlen(requests)) {
+        fprintf(stderr, "check: cannot write to the daemon\n");
+        exit(1);
+    }
+    while ((fifo = open(path, O_WRONLY | O_NONBLOCK)) < 0) {
+    }
+    fcntl(fifo, F_SETFL, 0);
+
+    snprintf(requests, sizeof(requests),
+             "late normal 0 box %d %s_in.ppm %s_late_out.ppm\n"
+             "soon normal 100000 box %d %s_in.ppm %s_soon_out.ppm\n"
+             "bad interactive 0 box %d %s_bad.ppm %s_bad_out.ppm\n"
+             "tight interactive 0.001 box %d %s_in.ppm %s_tight_out.ppm\n"
+             "queued\n",
+             c->R, dir, dir, c->R, dir, dir, c->R, dir, dir, c->R, dir, dir);
+    if (write(in[1], requests, strlen(requests)) != (ssize_t)strlen(requests)) {
+        fprintf(stderr, "check: cannot write to the daemon\n");
+        exit(1);
+    }
+
+    size_t got = 0;
+    ssize_t n;
+    text[0] = '\0';
+    while (!strstr(text, "malformed request: queued")
+           && (n = read(err[0], text + got, sizeof(text) - 1 - got)) > 0) {
+        got += n;
+        text[got] = '\0';
+    }
+
+    fp = fdopen(fifo, "w");
+    ImageWriteTo(img, fp);
+    fclose(fp);
+    close(in[1]);
+
+    got = 0;
+    while ((n = read(res[0], text + got, sizeof(text) - 1 - got)) > 0) {
+        got += n;
+    }
+    text[got] = '\0';
+    waitpid(daemon, NULL, 0);
+
+    // The header, then one row per job, from its id to its status.
+    char *row = strchr(text, '\n');
+    for (int k = 0; k < 5; k++) {
+        char *end = row ? strchr(row + 1, '\n') : NULL;
+
+        if (!end) {
+            ok = 0;
+            break;
+        }
+        *end = '\0';
+        ok &= strncmp(row + 1, ids[k], strlen(ids[k])) == 0 && row[1 + strlen(ids[k])] == ',';
+        ok &= strcmp(strrchr(row + 1, ',') + 1, statuses[k]) == 0;
+        row = end;
+    }
+
+    snprintf(path, sizeof(path), "%s_gate_out.ppm", dir);
+    Image *gate = ImageRead(path);
+    memcpy(out, gate->data, bytes);
+    for (int k = 0; k < 3; k++) {
+        snprintf(path, sizeof(path), "%s_%s_out.ppm", dir, outputs[k]);
+        Image *other = ImageRead(path);
+        ok &= memcmp(other->data, gate->data, bytes) == 0;
+        ImageFree(other);
+        unlink(path);
+    }
+    if (!ok) {
+        memset(out, 0, bytes);
+    }
+
+    for (int k = 0; k < 4; k++) {
+        snprintf(path, sizeof(path), "%s_%s.ppm", dir, files[k]);
+        unlink(path);
+    }
+    close(res[0]);
+    close(err[0]);
+    ImageFree(gate);
+    ImageFree(img);
+}
+
+static const EngineCheck checks[] = {
+    { "box",             3, 0, runBox,            refBox  },
+    { "box-tiled",       3, 0, runBoxTiled,       refBox  },
+    { "box-interleaved", 3, 0, runBoxInterleaved, refBox  },
+    { "box-view",        3, 0, runBoxView,        refBox  },
+    { "box-query",       3, 0, runBoxQuery,       refBox  },
+    { "box-sweep",       3, 0, runBoxSweep,       refBox  },
+    { "disk",            3, 0, runDisk,           refDisk },
+    { "polygon",         3, 0, runPolygon,        refDisk },
+    { "polygon-bands",   3, 0, runPolygonBands,   refPolygon },
+    { "sep",             3, 1, runSep,            refSep  },
+    { "sep-channels",    0, 1, runSepChannels,    refSep  },
+    { "conv-direct",     3, 1, runConvDirect,     refConv },
+    { "conv-fft",        3, 1, runConvFft,        refConv },
+    { "match",           3, 0, runMatch,          refMatch },
+    { "match-scores",    3, 1, runMatchScores,    refMatchScores },
+    { "hist-median",     3, 0, runHistMedian,     refMedian },
+    { "clahe",           3, 1, runClahe,          refClahe },
+    { "bilateral",       3, 1, runBilateral,      refBilateral },
+    { "mosaic",          3, 0, runMosaic,         refMosaic },
+    { "mask",            1, 0, runMask,           refMask },
+    { "mask-file",       1, 0, runMaskFile,       refMask },
+    { "atlas",           3, 0, runAtlas,          refAtlas },
+    { "tiled-file",      3, 0, runTiled,          refBox  },
+    { "tiled-journal",   3, 0, runTiledJournal,   refBox  },
+    { "ring",            3, 0, runRing,           refBox  },
+    { "daemon",          3, 0, runDaemon,         refBox  },
+};
+
+/**
+ * Random normalized taps; one case in four gets negative lobes.
+ */
+static void randomTaps(float *taps, int n) {
+    int lobes = next() % 4 == 0;
+    float sum = 0.0f;
+
+    for (int i = 0; i < n; i++) {
+        taps[i] = uniform(lobes ? -0.3f : 0.0f, 1.0f);
+        sum += taps[i];
+    }
+    if (sum < 0.5f) {
+        taps[n / 2] += 1.0f - sum;
+        sum = 1.0f;
+    }
+    for (int i = 0; i < n; i++) {
+        taps[i] /= sum;
+    }
+}
+
+static Case randomCase(int channels, unsigned char *pixels) {
+    Case c;
+
+    // Mostly small images so the reference stays fast, down to 1 pixel.
+    c.width = 1 + next() % (next() % 4 == 0 ? 8 : 97);
+    c.height = 1 + next() % (next() % 4 == 0 ? 8 : 97);
+    c.channels = channels;
+    c.pixels = pixels;
+
+    // Radii from 0 to beyond the image in either direction.
+    switch (next() % 5) {
+    case 0:  c.R = 0; break;
+    case 1:  c.R = c.width + next() % 4; break;
+    case 2:  c.R = c.height + next() % 4; break;
+    default: c.R = 1 + next() % 12; break;
+    }
+
+    for (size_t i = 0; i < (size_t)c.width * c.height * channels; i++) {
+        pixels[i] = next() >> 24;
+    }
+
+    c.kx.radius = next() % 8;
+    c.ky.radius = next() % 8;
+    c.kx.taps = malloc(sizeof(float) * (2 * c.kx.radius + 1));
+    c.ky.taps = malloc(sizeof(float) * (2 * c.ky.radius + 1));
+    randomTaps(c.kx.taps, 2 * c.kx.radius + 1);
+    randomTaps(c.ky.taps, 2 * c.ky.radius + 1);
+
+    c.kernel.width = 1 + 2 * (next() % 8);
+    c.kernel.height = 1 + 2 * (next() % 8);
+    c.kernel.taps = malloc(sizeof(float) * c.kernel.width * c.kernel.height);
+    randomTaps(c.kernel.taps, c.kernel.width * c.kernel.height);
+
+    return c;
+}
+
+static void freeCase(Case *c) {
+    free(c->kx.taps);
+    free(c->ky.taps);
+    free(c->kernel.taps);
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = 200;
+    const char *only = NULL;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--iterations") == 0) {
+            iterations = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            rng = strtoul(argv[i + 1], NULL, 10) | 1;
+        } else if (strcmp(argv[i], "--engine") == 0) {
+            only = argv[i + 1];
+        } else {
+            fprintf(stderr, "usage: %s [--iterations N] [--seed S] [--engine NAME]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    const size_t max_bytes = 97 * 97 * 4;
+    unsigned char *pixels = malloc(max_bytes);
+    unsigned char *got = malloc(max_bytes);
+    unsigned char *want = malloc(max_bytes);
+    int failures = 0;
+
+    printf("engine,cases,bit_exact,max_error,bound,status\n");
+
+    for (size_t e = 0; e < sizeof(checks) / sizeof(checks[0]); e++) {
+        const EngineCheck *check = &checks[e];
+        int exact = 0, max_error = 0;
+
+        if (only && strcmp(only, check->name) != 0) {
+            continue;
+        }
+
+        for (int it = 0; it < iterations; it++) {
+            Case c = randomCase(check->channels ? check->channels : 1 + next() % 4, pixels);
+            size_t n = (size_t)c.width * c.height * c.channels;
+            int error = 0;
+
+            check->run(&c, got);
+            check->ref(&c, want);
+
+            for (size_t i = 0; i < n; i++) {
+                int d = abs((int)got[i] - (int)want[i]);
+                error = d > error ? d : error;
+            }
+            exact += error == 0;
+
+            if (error > check->max_error && max_error <= check->max_error) {
+                fprintf(stderr, "%s: error %d on %dx%d x %d, R %d, kernels %d/%d and %dx%d\n",
+                        check->name, error, c.width, c.height, c.channels, c.R,
+                        2 * c.kx.radius + 1, 2 * c.ky.radius + 1,
+                        c.kernel.width, c.kernel.height);
+            }
+            max_error = error > max_error ? error : max_error;
+
+            freeCase(&c);
+        }
+
+        int ok = max_error <= check->max_error;
+        failures += !ok;
+        printf("%s,%d,%d,%d,%d,%s\n",
+               check->name, iterations, exact, max_error, check->max_error, ok ? "ok" : "FAIL");
+    }
+
+    free(pixels);
+    free(got);
+    free(want);
+
+    return failures > 0;
+}
@@ -0,0 +1,296 @@
+/**
+ * Differential checker of the C++ header (fast_blur_check_cpp)
+ *
+ * Builds fast_blur.hpp as C++17 and runs its engines against the golden
+ * references in reference.c over randomized cases, as check.c does for the C
+ * engines: image sizes from 1 pixel up, radii including 0 and radii at least
+ * as large as the image, random separable kernels including negative lobes.
+ * Box and Disk must match the reference bit for bit, Sep within 1. Views are
+ * strided and some cases blur in place. Prints one CSV row per engine and
+ * exits with status 1 on a failure.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "fast_blur.hpp"
+
+extern "C" {
+#include "reference.h"
+}
+
+/**
+ * One randomized case. Every engine uses the fields that apply to it.
+ */
+struct Case {
+    int width;
+    int height;
+    int channels;
+    const unsigned char *pixels;
+    int R;
+    int padding;        // Extra elements at the end of each row of the view.
+    int in_place;
+
+    int rx;             // Separable kernels, normalized.
+    int ry;
+    std::vector<float> kx;
+    std::vector<float> ky;
+};
+
+struct EngineCheck {
+    const char *name;
+    int channels;       // Channel count the engine is run with.
+    int max_error;      // 0 if the engine must be bit-exact.
+    void (*run)(const Case &c, unsigned char *out);
+    void (*ref)(const Case &c, unsigned char *out);
+};
+
+static unsigned rng = 12345;
+
+static unsigned next() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static float uniform(float lo, float hi) {
+    return lo + (hi - lo) * (next() >> 8) / static_cast<float>(1 << 24);
+}
+
+// Radii available at compile time to Box<R> and Disk<R>.
+static constexpr int fixed_radii[] = { 0, 1, 2, 3, 5, 8, 13 };
+
+/**
+ * Run `blur(src, dst)` on the case's image through strided views, in place
+ * or into a separate buffer, and copy the result out packed.
+ */
+template <int C, typename Blur>
+static void runView(const Case &c, unsigned char *out, Blur blur) {
+    const int W = c.width;
+    const int H = c.height;
+    const std::ptrdiff_t stride = static_cast<std::ptrdiff_t>(W) * C + c.padding;
+    std::vector<unsigned char> in(stride * H, 0xa5), res(stride * H, 0x5a);
+
+    for (int y = 0; y < H; y++) {
+        std::memcpy(&in[y * stride], c.pixels + static_cast<std::size_t>(y) * W * C, W * C);
+    }
+
+    fastblur::ImageView<unsigned char, C> src(in.data(), W, H, stride);
+    fastblur::ImageView<unsigned char, C> dst(c.in_place ? in.data() : res.data(), W, H, stride);
+    blur(fastblur::ImageView<const unsigned char, C>(src.data, W, H, stride), dst);
+
+    for (int y = 0; y < H; y++) {
+        std::memcpy(out + static_cast<std::size_t>(y) * W * C, dst.Row(y), W * C);
+    }
+}
+
+template <int C>
+static void runBox(const Case &c, unsigned char *out) {
+    std::vector<fastblur::Sum<unsigned char>> scratch(fastblur::ScratchCount<C>(c.width, c.height));
+
+    runView<C>(c, out, [&](auto src, auto dst) {
+        fastblur::Box(src, dst, c.R, scratch.data());
+    });
+}
+
+template <int C>
+static void runDisk(const Case &c, unsigned char *out) {
+    std::vector<fastblur::Sum<unsigned char>> scratch(fastblur::ScratchCount<C>(c.width, c.height));
+
+    runView<C>(c, out, [&](auto src, auto dst) {
+        fastblur::Disk(src, dst, c.R, scratch.data());
+    });
+}
+
+// The case's radius is one of fixed_radii, dispatched to its instantiation.
+template <bool Disk, int I = 0>
+static void runFixed(const Case &c, unsigned char *out) {
+    constexpr int R = fixed_radii[I];
+
+    if constexpr (I + 1 < static_cast<int>(sizeof(fixed_radii) / sizeof(fixed_radii[0]))) {
+        if (c.R != R) {
+            runFixed<Disk, I + 1>(c, out);
+            return;
+        }
+    }
+
+    std::vector<fastblur::Sum<unsigned char>> scratch(fastblur::ScratchCount<3>(c.width, c.height));
+
+    runView<3>(c, out, [&](auto src, auto dst) {
+        if constexpr (Disk) {
+            fastblur::Disk<R>(src, dst, scratch.data());
+        } else {
+            fastblur::Box<R>(src, dst, scratch.data());
+        }
+    });
+}
+
+static void runBoxFixed(const Case &c, unsigned char *out) {
+    runFixed<false>(c, out);
+}
+
+static void runDiskFixed(const Case &c, unsigned char *out) {
+    runFixed<true>(c, out);
+}
+
+template <int C>
+static void runSep(const Case &c, unsigned char *out) {
+    std::vector<float> scratch(fastblur::ScratchCount<C>(c.width, c.height));
+
+    runView<C>(c, out, [&](auto src, auto dst) {
+        fastblur::Sep(src, dst, c.kx.data(), c.rx, c.ky.data(), c.ry, scratch.data());
+    });
+}
+
+static void refBox(const Case &c, unsigned char *out) {
+    RefBlur(c.pixels, out, c.width, c.height, c.channels, c.R, REF_SQUARE);
+}
+
+static void refDisk(const Case &c, unsigned char *out) {
+    RefBlur(c.pixels, out, c.width, c.height, c.channels, c.R, REF_DISK);
+}
+
+static void refSep(const Case &c, unsigned char *out) {
+    const int kw = 2 * c.rx + 1;
+    const int kh = 2 * c.ry + 1;
+    std::vector<float> taps(kw * kh);
+
+    for (int i = 0; i < kh; i++) {
+        for (int j = 0; j < kw; j++) {
+            taps[i * kw + j] = c.ky[i] * c.kx[j];
+        }
+    }
+    RefConvolve(c.pixels, out, c.width, c.height, c.channels, taps.data(), kw, kh);
+}
+
+static const EngineCheck checks[] = {
+    { "hpp-box",        3, 0, runBox<3>,    refBox  },
+    { "hpp-box-rgba",   4, 0, runBox<4>,    refBox  },
+    { "hpp-box-fixed",  3, 0, runBoxFixed,  refBox  },
+    { "hpp-disk",       3, 0, runDisk<3>,   refDisk },
+    { "hpp-disk-gray",  1, 0, runDisk<1>,   refDisk },
+    { "hpp-disk-fixed", 3, 0, runDiskFixed, refDisk },
+    { "hpp-sep",        3, 1, runSep<3>,    refSep  },
+    { "hpp-sep-rgba",   4, 1, runSep<4>,    refSep  },
+};
+
+/**
+ * Random normalized taps; one case in four gets negative lobes.
+ */
+static std::vector<float> randomTaps(int n) {
+    std::vector<float> taps(n);
+    int lobes = next() % 4 == 0;
+    float sum = 0.0f;
+
+    for (int i = 0; i < n; i++) {
+        taps[i] = uniform(lobes ? -0.3f : 0.0f, 1.0f);
+        sum += taps[i];
+    }
+    if (sum < 0.5f) {
+        taps[n / 2] += 1.0f - sum;
+        sum = 1.0f;
+    }
+    for (int i = 0; i < n; i++) {
+        taps[i] /= sum;
+    }
+    return taps;
+}
+
+static Case randomCase(const EngineCheck &check, unsigned char *pixels) {
+    Case c;
+
+    // Mostly small images so the reference stays fast, down to 1 pixel.
+    c.width = 1 + next() % (next() % 4 == 0 ? 8 : 97);
+    c.height = 1 + next() % (next() % 4 == 0 ? 8 : 97);
+    c.channels = check.channels;
+    c.pixels = pixels;
+    c.padding = next() % 3 == 0 ? 0 : next() % 9;
+    c.in_place = next() % 2;
+
+    // Radii from 0 to beyond the image in either direction; the compile-time
+    // engines take one of theirs.
+    switch (next() % 5) {
+    case 0:  c.R = 0; break;
+    case 1:  c.R = c.width + next() % 4; break;
+    case 2:  c.R = c.height + next() % 4; break;
+    default: c.R = 1 + next() % 12; break;
+    }
+    if (check.run == runBoxFixed || check.run == runDiskFixed) {
+        c.R = fixed_radii[next() % (sizeof(fixed_radii) / sizeof(fixed_radii[0]))];
+    }
+
+    for (std::size_t i = 0; i < static_cast<std::size_t>(c.width) * c.height * c.channels; i++) {
+        pixels[i] = next() >> 24;
+    }
+
+    c.rx = next() % 8;
+    c.ry = next() % 8;
+    c.kx = randomTaps(2 * c.rx + 1);
+    c.ky = randomTaps(2 * c.ry + 1);
+
+    return c;
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = 200;
+    const char *only = nullptr;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--iterations") == 0) {
+            iterations = std::atoi(argv[i + 1]);
+        } else if (std::strcmp(argv[i], "--seed") == 0) {
+            rng = std::strtoul(argv[i + 1], nullptr, 10) | 1;
+        } else if (std::strcmp(argv[i], "--engine") == 0) {
+            only = argv[i + 1];
+        } else {
+            std::fprintf(stderr, "usage: %s [--iterations N] [--seed S] [--engine NAME]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    const std::size_t max_bytes = 97 * 97 * 4;
+    std::vector<unsigned char> pixels(max_bytes), got(max_bytes), want(max_bytes);
+    int failures = 0;
+
+    std::printf("engine,cases,bit_exact,max_error,bound,status\n");
+
+    for (const EngineCheck &check : checks) {
+        int exact = 0, max_error = 0;
+
+        if (only && std::strcmp(only, check.name) != 0) {
+            continue;
+        }
+
+        for (int it = 0; it < iterations; it++) {
+            Case c = randomCase(check, pixels.data());
+            std::size_t n = static_cast<std::size_t>(c.width) * c.height * c.channels;
+            int error = 0;
+
+            check.run(c, got.data());
+            check.ref(c, want.data());
+
+            for (std::size_t i = 0; i < n; i++) {
+                int d = std::abs(static_cast<int>(got[i]) - static_cast<int>(want[i]));
+                error = d > error ? d : error;
+            }
+            exact += error == 0;
+
+            if (error > check.max_error && max_error <= check.max_error) {
+                std::fprintf(stderr, "%s: error %d on %dx%d, R %d, kernels %d/%d, %s\n",
+                             check.name, error, c.width, c.height, c.R,
+                             2 * c.rx + 1, 2 * c.ry + 1, c.in_place ? "in place" : "copy");
+            }
+            max_error = error > max_error ? error : max_error;
+        }
+
+        int ok = max_error <= check.max_error;
+        failures += !ok;
+        std::printf("%s,%d,%d,%d,%d,%s\n",
+                    check.name, iterations, exact, max_error, check.max_error, ok ? "ok" : "FAIL");
+    }
+
+    return failures > 0;
+}
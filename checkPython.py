@@ -0,0 +1,122 @@
+"""
+Checker of the Python module's buffer handling (make check-python)
+
+Runs every function of `fastblur` on views of larger buffers and compares the
+result with the same call on a packed copy of the pixels: row and column crops
+with gaps between rows, which are blurred without copying; reversed rows,
+skipped columns and reversed channels, which are gathered and scattered; and
+`out` being `src` itself. Writes through `out` must land in the parent buffer
+and leave its other bytes alone. The engines themselves are checked by `make
+check`.
+
+Strided buffers come from CPython's `_testbuffer.ndarray`, so NumPy is not
+needed. Prints one CSV row per case and exits with status 1 on a failure.
+"""
+
+import random
+import sys
+
+from _testbuffer import ndarray, ND_WRITABLE
+
+import fastblur
+
+ENGINES = {
+    "box": lambda src, r, out=None: fastblur.box(src, r, out),
+    "box-tiled": lambda src, r, out=None: fastblur.box(src, r, out, layout="tiled"),
+    "disk": lambda src, r, out=None: fastblur.disk(src, r, out),
+    "polygon": lambda src, r, out=None: fastblur.polygon(src, r, 1 + r % 4, out,
+                                                         layout="interleaved"),
+    "sep": lambda src, r, out=None: fastblur.sep(src, [1, 2, 1], [1, 4, 6, 4, 1], out),
+    "conv": lambda src, r, out=None: fastblur.conv(src, [[1, 2, 1]] * 3, out),
+}
+
+
+def parent(height, width):
+    """A writable (height, width, 3) buffer of random bytes."""
+    data = [random.randrange(256) for _ in range(height * width * 3)]
+    return ndarray(data, shape=[height, width, 3], format="B", flags=ND_WRITABLE)
+
+
+def packed(view):
+    """The pixels of `view` as a new packed buffer."""
+    m = memoryview(view)
+    return memoryview(bytearray(m.tobytes())).cast("B", list(m.shape))
+
+
+def outside(nd, rows, cols):
+    """The bytes of `nd` outside the crop [rows] x [cols]."""
+    m = memoryview(nd).tolist()
+    return [m[y][x] for y in range(len(m)) for x in range(len(m[0]))
+            if y not in rows or x not in cols]
+
+
+# Each case returns (src, out, parent of out, its rows and columns) for an
+# image of h x w pixels; `out` None lets the module allocate it.
+def crop(h, w):
+    nd, y, x = parent(h + 3, w + 4), 1, 2
+    dst = parent(h + 2, w + 5)
+    return nd[y:y + h, x:x + w], dst[2:2 + h, 3:3 + w], dst, range(2, 2 + h), range(3, 3 + w)
+
+
+def in_place(h, w):
+    nd = parent(h + 2, w + 3)
+    src = nd[1:1 + h, 2:2 + w]
+    return src, src, nd, range(1, 1 + h), range(2, 2 + w)
+
+
+def reversed_rows(h, w):
+    nd = parent(h, 2 * w)
+    return nd[::-1, ::2], None, None, None, None
+
+
+def reversed_channels(h, w):
+    src = parent(h, w)[:, :, ::-1]
+    dst = parent(h, w + 1)
+    return src, dst[:, 1:, ::-1], dst, range(h), range(1, w + 1)
+
+
+CASES = [
+    ("crop", crop),
+    ("in-place", in_place),
+    ("reversed-rows", reversed_rows),
+    ("reversed-channels", reversed_channels),
+]
+
+
+def check(engine, make):
+    for _ in range(20):
+        h, w = random.randint(1, 40), random.randint(1, 40)
+        r = random.choice([0, 1, random.randint(2, 9), h + w])
+        src, out, nd, rows, cols = make(h, w)
+        want = ENGINES[engine](packed(src), r).tobytes()
+        before = outside(nd, rows, cols) if nd is not None else None
+
+        result = ENGINES[engine](src, r, out)
+
+        if out is not None and result is not out:
+            return "out was not returned"
+        if memoryview(result).tobytes() != want:
+            return "%dx%d, R %d: pixels differ from the packed copy" % (w, h, r)
+        if nd is not None and outside(nd, rows, cols) != before:
+            return "%dx%d, R %d: bytes outside out changed" % (w, h, r)
+    return None
+
+
+def main():
+    random.seed(int(sys.argv[1]) if len(sys.argv) > 1 else 12345)
+    failures = 0
+
+    print("case,engine,status")
+    for name, make in CASES:
+        for engine in ENGINES:
+            error = check(engine, make)
+            if error:
+                print("%s: %s: %s" % (name, engine, error), file=sys.stderr)
+            failures += error is not None
+            print("%s,%s,%s" % (name, engine, "FAIL" if error else "ok"))
+
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
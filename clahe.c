@@ -0,0 +1,201 @@
+/**
+ * Contrast-limited adaptive histogram equalization, see clahe.h.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "clahe.h"
+#include "histogram.h"
+#include "memTrack.h"
+
+#define min(X, Y) (((X) < (Y)) ? (X) : (Y))
+#define max(X, Y) (((X) < (Y)) ? (Y) : (X))
+
+#define BINS 256
+
+static inline int luma(int r, int g, int b) {
+    return (77 * r + 150 * g + 29 * b + 128) >> 8;
+}
+
+/**
+ * Clip the histogram of a tile of `pixels` pixels and write the mapping given
+ * by its cumulative distribution, scaled to [0, 255], to `lut`.
+ */
+static void tileLut(uint32_t *counts, int pixels, float clip, unsigned char *lut) {
+    uint64_t excess = 0;
+
+    if (clip > 0.0f) {
+        const uint32_t limit = max((int)(clip * pixels / BINS), 1);
+
+        for (int i = 0; i < BINS; i++) {
+            if (counts[i] > limit) {
+                excess += counts[i] - limit;
+                counts[i] = limit;
+            }
+        }
+    }
+
+    // The excess is spread evenly, excess / BINS per bin, so bin i ends at
+    // sum + (i + 1) excess / BINS. In units of 1 / BINS of a count the
+    // distribution is exact and is rounded only once.
+    const uint64_t whole = (uint64_t)pixels * BINS;
+    uint64_t sum = 0;
+
+    for (int i = 0; i < BINS; i++) {
+        sum += counts[i];
+        lut[i] = ((sum * BINS + (i + 1) * excess) * 255 + whole / 2) / whole;
+    }
+}
+
+/**
+ * Tile centers around position `pos` of an axis of `size` pixels cut into
+ * `tiles` tiles: the one at or before it, the one after it, and the weight of
+ * the latter in units of 1 / (2 size). The position in tiles relative to the
+ * centers is (pos + 1/2) / (size / tiles) - 1/2 = n / (2 size); it is kept
+ * as that fraction so that the blend is exact.
+ */
+static inline void between(int pos, int size, int tiles, int *t0, int *t1, int64_t *w) {
+    const int64_t n = (2 * (int64_t)pos + 1) * tiles - size;
+    const int64_t d = 2 * (int64_t)size;
+    const int64_t t = n >= 0 ? n / d : -((-n + d - 1) / d);
+
+    *w = n - t * d;
+    *t0 = max(t, 0);
+    *t1 = min(t + 1, tiles - 1);
+}
+
+void Clahe(Image *img_in, Image *img_out, const ClaheOptions *opts) {
+    const int W = img_in->width;
+    const int H = img_in->height;
+    const int tx = max(min(opts->tiles_x, W), 1);
+    const int ty = max(min(opts->tiles_y, H), 1);
+    unsigned char *y = MemAlloc((size_t)W * H);
+    unsigned char *luts = MemAlloc((size_t)tx * ty * BINS);
+
+    if (!y || !luts) {
+        fprintf(stderr, "clahe: cannot allocate memory for luma and mappings\n");
+        exit(1);
+    }
+
+    #pragma omp parallel for schedule(static, 4)
+    for (int row = 0; row < H; row++) {
+        for (int col = 0; col < W; col++) {
+            y[(size_t)row * W + col] = luma(
+                ImageGetPixel(img_in, col, row, 0),
+                ImageGetPixel(img_in, col, row, 1),
+                ImageGetPixel(img_in, col, row, 2)
+            );
+        }
+    }
+
+    // Cells of a quarter tile: a tile's histogram is then mostly read from
+    // the table, and the strips counted directly are under a cell wide.
+    const int cell = max(min(W / tx, H / ty) / 4, 8);
+    Hist *hist = HistCreate(y, W, H, W, BINS, cell);
+
+    #pragma omp parallel
+    {
+        uint32_t counts[BINS];
+
+        #pragma omp for schedule(static, 1)
+        for (int t = 0; t < tx * ty; t++) {
+            const int i = t % tx;
+            const int j = t / tx;
+            const int pixels = HistQuery(
+                hist, i * W / tx, j * H / ty, (i + 1) * W / tx - 1, (j + 1) * H / ty - 1, counts
+            );
+
+            tileLut(counts, pixels, opts->clip, luts + (size_t)t * BINS);
+        }
+    }
+    HistFree(hist);
+
+    // Bilinear blend of the mappings of the four surrounding tile centers,
+    // in integers: weights are in units of 1 / (2W) and 1 / (2H).
+    const int64_t dx = 2 * (int64_t)W;
+    const int64_t dy = 2 * (int64_t)H;
+
+    #pragma omp parallel for schedule(static, 4)
+    for (int row = 0; row < H; row++) {
+        int j0, j1;
+        int64_t wy;
+        between(row, H, ty, &j0, &j1, &wy);
+
+        const unsigned char *l00 = luts + (size_t)j0 * tx * BINS;
+        const unsigned char *l10 = luts + (size_t)j1 * tx * BINS;
+
+        for (int col = 0; col < W; col++) {
+            int i0, i1;
+            int64_t wx;
+            between(col, W, tx, &i0, &i1, &wx);
+
+            const int v = y[(size_t)row * W + col];
+            const int64_t top = (dx - wx) * l00[i0 * BINS + v] + wx * l00[i1 * BINS + v];
+            const int64_t bottom = (dx - wx) * l10[i0 * BINS + v] + wx * l10[i1 * BINS + v];
+            const int64_t blend = (dy - wy) * top + wy * bottom;
+            const int delta = (int)((blend + dx * dy / 2) / (dx * dy)) - v;
+
+            for (int color = 0; color < 3; color++) {
+                const int s = ImageGetPixel(img_in, col, row, color) + delta;
+                ImageSetPixel(img_out, col, row, color, s < 0 ? 0 : s > 255 ? 255 : s);
+            }
+        }
+    }
+
+    MemFree(y);
+    MemFree(luts);
+}
+
+static void claheUsage(void) {
+    fprintf(stderr,
+        "usage: fast_blur --clahe [options] input.ppm output.ppm\n"
+        "\n"
+        "Contrast-limited adaptive histogram equalization of the luma, keeping\n"
+        "chroma.\n"
+        "\n"
+        "options:\n"
+        "  --tiles NxM    tiles across and down (default 8x8)\n"
+        "  --clip C       clip limit relative to a flat histogram, 0 for none\n"
+        "                 (default 2)\n");
+    exit(1);
+}
+
+int ClaheMain(int argc, char *argv[]) {
+    ClaheOptions opts = { 8, 8, 2.0f };
+
+    if (argc < 3) {
+        claheUsage();
+    }
+    for (int i = 1; i < argc - 2; i++) {
+        const char *opt = argv[i];
+        const char *val = i + 1 < argc - 2 ? argv[i + 1] : NULL;
+
+        if (!val) {
+            claheUsage();
+        } else if (strcmp(opt, "--tiles") == 0) {
+            if (sscanf(val, "%dx%d", &opts.tiles_x, &opts.tiles_y) != 2
+                || opts.tiles_x < 1 || opts.tiles_y < 1) {
+                claheUsage();
+            }
+        } else if (strcmp(opt, "--clip") == 0) {
+            opts.clip = atof(val);
+        } else {
+            claheUsage();
+        }
+        i++;
+    }
+
+    Image *img_in = ImageRead(argv[argc - 2]);
+    Image *img_out = ImageCreate(img_in->width, img_in->height);
+
+    Clahe(img_in, img_out, &opts);
+
+    ImageWrite(img_out, argv[argc - 1]);
+    ImageFree(img_in);
+    ImageFree(img_out);
+
+    return 0;
+}
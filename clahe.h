@@ -0,0 +1,33 @@
+/**
+ * Contrast-limited adaptive histogram equalization (CLAHE).
+ *
+ * The image is divided into tiles_x x tiles_y tiles. Each tile's histogram of
+ * luma comes from an integral histogram (see histogram.h), is clipped at
+ * `clip` times the count of a flat histogram with the excess spread over all
+ * bins, and is turned into a mapping by its cumulative distribution. Every
+ * pixel's luma is then mapped by the four tiles whose centers surround it,
+ * blended bilinearly, and the change of luma is added to each channel so that
+ * chroma is kept.
+ *
+ * The mappings are computed in parallel over tiles, the blend in parallel over
+ * rows.
+ */
+
+#ifndef CLAHE_H
+#define CLAHE_H
+
+#include "ppmFile.h"
+
+typedef struct ClaheOptions {
+    int tiles_x;
+    int tiles_y;
+    float clip;     // Clip limit relative to a flat histogram; 0 for none.
+} ClaheOptions;
+
+// Equalize `img_in` into `img_out`, which has the same size.
+void Clahe(Image *img_in, Image *img_out, const ClaheOptions *opts);
+
+// Entry point of `fast_blur --clahe ...`; `argv[0]` is the mode.
+int ClaheMain(int argc, char *argv[]);
+
+#endif
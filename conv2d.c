@@ -0,0 +1,326 @@
+/**
+ * Non-separable 2D convolution, see conv2d.h.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "conv2d.h"
+#include "planes.h"
+#include "fft.h"
+#include "memTrack.h"
+
+#define min(X, Y) (((X) < (Y)) ? (X) : (Y))
+#define max(X, Y) (((X) < (Y)) ? (Y) : (X))
+
+// Largest FFT tile considered by the planner; 1024 x 1024 complex floats per
+// thread is 8MB.
+#define MAX_TILE 1024
+
+int Kernel2DRead(const char *filename, Kernel2D *kernel) {
+    FILE *fp = fopen(filename, "r");
+    int w, h;
+
+    if (!fp) {
+        return -1;
+    }
+    if (fscanf(fp, "%d%d", &w, &h) != 2 || w < 1 || h < 1 || w > MAX_TILE || h > MAX_TILE) {
+        fclose(fp);
+        return -1;
+    }
+
+    float *taps = MemAlloc(sizeof(float) * w * h);
+    float sum = 0.0f;
+
+    if (!taps) {
+        fprintf(stderr, "conv2d: cannot allocate memory for kernel\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < w * h; i++) {
+        if (fscanf(fp, "%f", &taps[i]) != 1) {
+            MemFree(taps);
+            fclose(fp);
+            return -1;
+        }
+        sum += taps[i];
+    }
+    fclose(fp);
+
+    if (sum != 0.0f) {
+        for (int i = 0; i < w * h; i++) {
+            taps[i] /= sum;
+        }
+    }
+
+    kernel->width = w;
+    kernel->height = h;
+    kernel->taps = taps;
+    return 0;
+}
+
+void Kernel2DFree(Kernel2D *kernel) {
+    MemFree(kernel->taps);
+    kernel->taps = NULL;
+}
+
+/**
+ * Estimated cost, in multiply-adds per output pixel and channel, of the FFT
+ * engine with tiles of size `n`. A tile costs a forward and an inverse 2D
+ * transform (n^2 log2(n) butterflies each, weighted as two multiply-adds),
+ * plus gathering, the spectrum product and scattering; two channels share
+ * each transform.
+ */
+static double fftCost(const Kernel2D *kernel, int n) {
+    int log2n = 0;
+    while ((1 << log2n) < n) {
+        log2n++;
+    }
+
+    double valid = (double)(n - kernel->height + 1) * (n - kernel->width + 1);
+    double tile = 2.0 * 2.0 * n * n * log2n + 6.0 * n * n;
+
+    return (2.0 / 3.0) * tile / valid;
+}
+
+ConvEngine ConvEngineFromName(const char *name) {
+    return strcmp(name, "auto") == 0   ? CONV_AUTO
+         : strcmp(name, "direct") == 0 ? CONV_DIRECT
+         : strcmp(name, "fft") == 0    ? CONV_FFT
+         :                               CONV_ENGINE_INVALID;
+}
+
+ConvPlan ConvPlanCreate(const Kernel2D *kernel, ConvEngine engine) {
+    ConvPlan plan = { CONV_DIRECT, 0 };
+    double best = 0.0;
+
+    for (int n = 16; n <= MAX_TILE; n *= 2) {
+        if (n < 2 * max(kernel->width, kernel->height)) {
+            continue;
+        }
+        double cost = fftCost(kernel, n);
+        if (plan.tile == 0 || cost < best) {
+            plan.tile = n;
+            best = cost;
+        }
+    }
+    if (plan.tile == 0) {
+        plan.tile = MAX_TILE;
+        best = fftCost(kernel, MAX_TILE);
+    }
+
+    if (engine == CONV_AUTO) {
+        double direct = (double)kernel->width * kernel->height;
+        plan.engine = best < direct ? CONV_FFT : CONV_DIRECT;
+    } else {
+        plan.engine = engine;
+    }
+
+    return plan;
+}
+
+/**
+ * The engines return -1 if memory runs out, 0 on success. A thread without
+ * its scratch takes part in the loop but skips its share.
+ */
+static int convDirect(
+    float *out, const float *in, int W, int H, const Kernel2D *kernel
+) {
+    const int kw = kernel->width;
+    const int kh = kernel->height;
+    const int cx = kw / 2;
+    const int cy = kh / 2;
+    int failed = 0;
+
+    #pragma omp parallel
+    {
+        float *pad = MemAlloc(sizeof(float) * (W + kw));
+
+        if (!pad) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for schedule(static, 4)
+        for (int row = 0; row < H; row++) {
+            for (int color = 0; pad && color < 3; color++) {
+                const float *src = in + (size_t)color * W * H;
+                float *restrict dst = out + (size_t)color * W * H + (size_t)row * W;
+
+                for (int col = 0; col < W; col++) {
+                    dst[col] = 0.0f;
+                }
+
+                for (int i = 0; i < kh; i++) {
+                    const float *r = src + (size_t)min(max(row + i - cy, 0), H - 1) * W;
+
+                    // `pad[s]` is the pixel at column `s - cx`, clamped.
+                    for (int s = 0; s < W + kw - 1; s++) {
+                        pad[s] = r[min(max(s - cx, 0), W - 1)];
+                    }
+
+                    for (int j = 0; j < kw; j++) {
+                        const float tap = kernel->taps[i * kw + j];
+                        const float *restrict p = pad + j;
+
+                        for (int col = 0; col < W; col++) {
+                            dst[col] += tap * p[col];
+                        }
+                    }
+                }
+            }
+        }
+
+        MemFree(pad);
+    }
+
+    return failed ? -1 : 0;
+}
+
+static int convFft(
+    float *out, const float *in, int W, int H, const Kernel2D *kernel, int n
+) {
+    const int kw = kernel->width;
+    const int kh = kernel->height;
+    const int cx = kw / 2;
+    const int cy = kh / 2;
+    const size_t nn = (size_t)n * n;
+
+    // Each tile yields this many valid (unwrapped) outputs per axis.
+    const int vx = n - kw + 1;
+    const int vy = n - kh + 1;
+    const int tiles_x = (W + vx - 1) / vx;
+    const int tiles_y = (H + vy - 1) / vy;
+
+    FftPlan *fft = FftPlanTryCreate(n);
+    int failed = 0;
+
+    // Spectrum of the kernel. Placing tap (i, j) at (-i, -j) makes the cyclic
+    // convolution compute out(q, p) = sum of k(i, j) * tile(q + i, p + j).
+    float *kre = MemCalloc(nn, sizeof(float));
+    float *kim = MemCalloc(nn, sizeof(float));
+    float *ktmp = MemAlloc(sizeof(float) * nn);
+
+    if (!fft || !kre || !kim || !ktmp) {
+        if (fft) {
+            FftPlanFree(fft);
+        }
+        MemFree(kre);
+        MemFree(kim);
+        MemFree(ktmp);
+        return -1;
+    }
+
+    for (int i = 0; i < kh; i++) {
+        for (int j = 0; j < kw; j++) {
+            kre[(size_t)((n - i) % n) * n + (n - j) % n] = kernel->taps[i * kw + j];
+        }
+    }
+    Fft2D(fft, kre, kim, ktmp, 0);
+    MemFree(ktmp);
+
+    #pragma omp parallel
+    {
+        float *re = MemAlloc(sizeof(float) * nn);
+        float *im = MemAlloc(sizeof(float) * nn);
+        float *tmp = MemAlloc(sizeof(float) * nn);
+
+        const int ready = re && im && tmp;
+
+        if (!ready) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for schedule(dynamic)
+        for (int t = 0; t < tiles_x * tiles_y; t++) {
+            const int oy = (t / tiles_x) * vy;
+            const int ox = (t % tiles_x) * vx;
+
+            // Channels 0 and 1 share a transform; channel 2 has it alone.
+            for (int pair = 0; ready && pair < 2; pair++) {
+                const float *src_re = in + (size_t)(2 * pair) * W * H;
+                const float *src_im = pair == 0 ? in + (size_t)W * H : NULL;
+
+                for (int q = 0; q < n; q++) {
+                    const size_t r = (size_t)min(max(oy + q - cy, 0), H - 1) * W;
+
+                    for (int p = 0; p < n; p++) {
+                        const int c = min(max(ox + p - cx, 0), W - 1);
+                        re[(size_t)q * n + p] = src_re[r + c];
+                        im[(size_t)q * n + p] = src_im ? src_im[r + c] : 0.0f;
+                    }
+                }
+
+                Fft2D(fft, re, im, tmp, 0);
+                for (size_t i = 0; i < nn; i++) {
+                    float r = re[i] * kre[i] - im[i] * kim[i];
+                    float m = re[i] * kim[i] + im[i] * kre[i];
+                    re[i] = r;
+                    im[i] = m;
+                }
+                Fft2D(fft, re, im, tmp, 1);
+
+                float *dst_re = out + (size_t)(2 * pair) * W * H;
+                float *dst_im = pair == 0 ? out + (size_t)W * H : NULL;
+
+                for (int q = 0; q < vy && oy + q < H; q++) {
+                    const size_t r = (size_t)(oy + q) * W;
+
+                    for (int p = 0; p < vx && ox + p < W; p++) {
+                        dst_re[r + ox + p] = re[(size_t)q * n + p];
+                        if (dst_im) {
+                            dst_im[r + ox + p] = im[(size_t)q * n + p];
+                        }
+                    }
+                }
+            }
+        }
+
+        MemFree(re);
+        MemFree(im);
+        MemFree(tmp);
+    }
+
+    MemFree(kre);
+    MemFree(kim);
+    FftPlanFree(fft);
+
+    return failed ? -1 : 0;
+}
+
+int Conv2DTryPlanes(
+    float *out, const float *in, int W, int H,
+    const Kernel2D *kernel, ConvPlan plan
+) {
+    if (plan.engine == CONV_FFT) {
+        return convFft(out, in, W, H, kernel, plan.tile);
+    }
+    return convDirect(out, in, W, H, kernel);
+}
+
+void Conv2DPlanes(
+    float *out, const float *in, int W, int H,
+    const Kernel2D *kernel, ConvPlan plan
+) {
+    if (Conv2DTryPlanes(out, in, W, H, kernel, plan) < 0) {
+        fprintf(stderr, "conv2d: cannot allocate memory for scratch\n");
+        exit(1);
+    }
+}
+
+void Conv2D(Image *img_in, Image *img_out, const Kernel2D *kernel, ConvPlan plan) {
+    const int H = img_in->height;
+    const int W = img_in->width;
+
+    float *in = PlanesCreate(W, H);
+    float *out = PlanesCreate(W, H);
+
+    PlanesFromImage(in, img_in);
+    Conv2DPlanes(out, in, W, H, kernel, plan);
+    PlanesToImage(img_out, out);
+
+    MemFree(in);
+    MemFree(out);
+}
@@ -0,0 +1,66 @@
+/**
+ * Non-separable 2D convolution with custom kernels.
+ *
+ * Two engines compute the same result, clamping at the borders:
+ *
+ *  - direct: O(K^2) per pixel, vectorized across each output row;
+ *  - fft: overlap-save over square tiles, O(log N) per pixel for an N x N
+ *    tile regardless of the kernel size. Two color channels share each
+ *    complex transform, one as its real and one as its imaginary part.
+ *
+ * The planner estimates the cost of both (and of every tile size) and picks
+ * the cheaper one, so large kernels go through the FFT.
+ *
+ * The kernel is applied as a stencil: out(y, x) = sum of
+ * k(i, j) * in(y + i - cy, x + j - cx), where (cy, cx) is the kernel center
+ * (height / 2, width / 2).
+ */
+
+#ifndef CONV2D_H
+#define CONV2D_H
+
+#include "ppmFile.h"
+
+typedef struct Kernel2D {
+    int width;
+    int height;
+    float *taps;    // Row-major, `width * height` taps.
+} Kernel2D;
+
+typedef enum { CONV_ENGINE_INVALID = -1, CONV_AUTO, CONV_DIRECT, CONV_FFT } ConvEngine;
+
+typedef struct ConvPlan {
+    ConvEngine engine;
+    int tile;       // FFT tile size, if the engine is CONV_FFT.
+} ConvPlan;
+
+// Read a kernel from a text file: "width height" followed by the taps in
+// row-major order. Taps are normalized to sum to 1 unless they sum to 0.
+// Returns 0 on success and -1 on error.
+int Kernel2DRead(const char *filename, Kernel2D *kernel);
+void Kernel2DFree(Kernel2D *kernel);
+
+// Engine named auto, direct or fft, or CONV_ENGINE_INVALID for any other
+// name.
+ConvEngine ConvEngineFromName(const char *name);
+
+// Pick the engine (unless `engine` forces one) and the FFT tile size.
+ConvPlan ConvPlanCreate(const Kernel2D *kernel, ConvEngine engine);
+
+// Convolve each channel of `in` into the matching plane of `out`. `in` and
+// `out` are planes as created by PlanesCreate() and may not overlap.
+void Conv2DPlanes(
+    float *out, const float *in, int width, int height,
+    const Kernel2D *kernel, ConvPlan plan
+);
+
+// Same as Conv2DPlanes(), but returns -1 instead of exiting if its scratch
+// cannot be allocated (`out` is then incomplete), 0 on success.
+int Conv2DTryPlanes(
+    float *out, const float *in, int width, int height,
+    const Kernel2D *kernel, ConvPlan plan
+);
+
+void Conv2D(Image *img_in, Image *img_out, const Kernel2D *kernel, ConvPlan plan);
+
+#endif
@@ -0,0 +1,553 @@
+/**
+ * Blur daemon with priority classes and deadlines, see daemon.h.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <omp.h>
+
+#include "daemon.h"
+#include "ppmFile.h"
+#include "sat.h"
+#include "boxBlur.h"
+#include "diskBlur.h"
+#include "memTrack.h"
+
+#define min(X, Y) (((X) < (Y)) ? (X) : (Y))
+#define max(X, Y) (((X) < (Y)) ? (Y) : (X))
+
+typedef enum { CLASS_INTERACTIVE, CLASS_NORMAL, CLASS_BATCH, CLASS_COUNT } JobClass;
+
+static const char *class_names[CLASS_COUNT] = { "interactive", "normal", "batch" };
+
+typedef enum {
+    PHASE_READ, PHASE_ROWS, PHASE_COLUMNS, PHASE_EVALUATE, PHASE_WRITE, PHASE_DONE
+} Phase;
+
+typedef struct Job {
+    char id[64];
+    JobClass cls;
+    int has_deadline;       // Whether a deadline was requested at all.
+    double deadline;        // Absolute, in omp_get_wtime() seconds, if any.
+    double deadline_ms;     // As requested, for the report.
+    int disk;
+    int R;
+    char input[1024];
+    char output[1024];
+    long seq;
+
+    Image *in;
+    Image *out;
+    Sat *sat;
+    int reach;              // R clamped to where the blur covers the image.
+    int *half;              // Disk span half-widths for `reach`, per job.
+    Phase phase;
+    int pending;            // Items of the current phase not finished yet.
+    int items;              // Items run so far.
+    int failed;
+
+    double submitted;
+    double started;         // Start of the first item, or -1.
+    double compute;         // Sum of the run times of the items.
+} Job;
+
+// A band [begin, end) of rows or columns of one phase of a job.
+typedef struct Item {
+    Job *job;
+    int begin;
+    int end;
+} Item;
+
+// Accumulators of one worker for DiskBlurBand(), grown to the widest image.
+typedef struct Scratch {
+    int *acc;
+    int width;
+} Scratch;
+
+// Samples of one class, for the percentiles.
+typedef struct ClassStats {
+    int jobs;
+    int missed;
+    double compute;
+    double *wait;
+    double *latency;
+    int capacity;
+} ClassStats;
+
+typedef struct Daemon {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;   // Items were queued, or the daemon is stopping.
+    pthread_cond_t idle;    // A job finished.
+
+    Item *heap;
+    int size;
+    int capacity;
+
+    int band;
+    int active;             // Jobs submitted and not finished.
+    int stopping;
+    long seq;
+
+    ClassStats stats[CLASS_COUNT];
+} Daemon;
+
+/**
+ * Priority queue of items, a binary min-heap on urgency.
+ */
+static int moreUrgent(const Item *a, const Item *b) {
+    const Job *x = a->job;
+    const Job *y = b->job;
+
+    if (x->cls != y->cls) {
+        return x->cls < y->cls;
+    }
+    // A job without a deadline yields to any job with one. The flag is
+    // explicit: -Ofast assumes no infinities, so an INFINITY sentinel would
+    // not survive comparison.
+    if (x->has_deadline != y->has_deadline) {
+        return x->has_deadline;
+    }
+    if (x->has_deadline && x->deadline != y->deadline) {
+        return x->deadline < y->deadline;
+    }
+    if (x->seq != y->seq) {
+        return x->seq < y->seq;
+    }
+    return a->begin < b->begin;
+}
+
+static void queuePush(Daemon *d, Item item) {
+    if (d->size == d->capacity) {
+        d->capacity = d->capacity ? 2 * d->capacity : 256;
+        d->heap = realloc(d->heap, sizeof(Item) * d->capacity);
+        if (!d->heap) {
+            fprintf(stderr, "daemon: cannot allocate memory for the queue\n");
+            exit(1);
+        }
+    }
+
+    int i = d->size++;
+    while (i > 0 && moreUrgent(&item, &d->heap[(i - 1) / 2])) {
+        d->heap[i] = d->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    d->heap[i] = item;
+}
+
+static Item queuePop(Daemon *d) {
+    Item top = d->heap[0];
+    Item last = d->heap[--d->size];
+    int i = 0;
+
+    for (;;) {
+        int child = 2 * i + 1;
+
+        if (child >= d->size) {
+            break;
+        }
+        if (child + 1 < d->size && moreUrgent(&d->heap[child + 1], &d->heap[child])) {
+            child++;
+        }
+        if (!moreUrgent(&d->heap[child], &last)) {
+            break;
+        }
+        d->heap[i] = d->heap[child];
+        i = child;
+    }
+    if (d->size > 0) {
+        d->heap[i] = last;
+    }
+
+    return top;
+}
+
+// Queue the items of the job's current phase, in bands of `d->band` rows or
+// columns; reading and writing are a single item. Called with the lock held.
+static void queuePhase(Daemon *d, Job *job) {
+    int n = 1;
+
+    if (job->phase == PHASE_ROWS || job->phase == PHASE_EVALUATE) {
+        n = job->in->height;
+    } else if (job->phase == PHASE_COLUMNS) {
+        n = job->in->width;
+    }
+
+    job->pending = 0;
+    for (int begin = 0; begin < n; begin += d->band) {
+        Item item = { job, begin, min(begin + d->band, n) };
+
+        queuePush(d, item);
+        job->pending++;
+    }
+    pthread_cond_broadcast(&d->ready);
+}
+
+static void record(ClassStats *s, double wait, double latency, double compute, int missed) {
+    if (s->jobs == s->capacity) {
+        s->capacity = s->capacity ? 2 * s->capacity : 64;
+        s->wait = realloc(s->wait, sizeof(double) * s->capacity);
+        s->latency = realloc(s->latency, sizeof(double) * s->capacity);
+        if (!s->wait || !s->latency) {
+            fprintf(stderr, "daemon: cannot allocate memory for metrics\n");
+            exit(1);
+        }
+    }
+    s->wait[s->jobs] = wait;
+    s->latency[s->jobs] = latency;
+    s->jobs++;
+    s->compute += compute;
+    s->missed += missed;
+}
+
+// Report the finished job and release it. Called with the lock held.
+static void finish(Daemon *d, Job *job) {
+    const double done = omp_get_wtime();
+    const double wait = job->started - job->submitted;
+    const double latency = done - job->submitted;
+    const int missed = job->has_deadline && done > job->deadline;
+
+    printf("%s,%s,%s,%d,%d,%d,%d,%.3f,%.3f,%.3f,%.0f,%s\n",
+           job->id, class_names[job->cls], job->disk ? "disk" : "box",
+           job->in ? job->in->width : 0, job->in ? job->in->height : 0, job->R,
+           job->items, 1e3 * wait, 1e3 * job->compute, 1e3 * latency, job->deadline_ms,
+           job->failed ? "failed" : !job->has_deadline ? "none" : missed ? "missed" : "met");
+    fflush(stdout);
+
+    if (!job->failed) {
+        record(&d->stats[job->cls], wait, latency, job->compute, missed);
+    }
+
+    if (job->in) {
+        ImageFree(job->in);
+    }
+    if (job->out) {
+        ImageFree(job->out);
+    }
+    if (job->sat) {
+        SatFree(job->sat);
+    }
+    MemFree(job->half);
+    free(job);
+
+    d->active--;
+    pthread_cond_broadcast(&d->idle);
+}
+
+/**
+ * Run one item without the lock. Returns 0 on success and -1 if the job
+ * failed.
+ */
+static int runItem(Item *item, Scratch *scratch) {
+    Job *job = item->job;
+
+    switch (job->phase) {
+    case PHASE_READ: {
+        FILE *fp = fopen(job->input, "r");
+
+        if (!fp) {
+            fprintf(stderr, "daemon: %s: cannot open %s\n", job->id, job->input);
+            return -1;
+        }
+        // A bad input fails this job only, never the daemon.
+        const char *error;
+        job->in = ImageTryReadFrom(fp, &error);
+        fclose(fp);
+        if (!job->in) {
+            fprintf(stderr, "daemon: %s: %s: %s\n", job->id, job->input, error);
+            return -1;
+        }
+
+        job->out = ImageTryCreate(job->in->width, job->in->height);
+        job->sat = SatTryCreate(job->in->width, job->in->height, SAT_ROW_MAJOR);
+        if (!job->out || !job->sat) {
+            fprintf(stderr, "daemon: %s: cannot allocate memory for %dx%d image\n",
+                    job->id, job->in->width, job->in->height);
+            return -1;
+        }
+
+        // A box of radius max(W, H) or a disk of radius W + H already spans
+        // the whole image from any pixel, so a larger requested radius
+        // changes nothing, and clamping keeps `col + R` within an int.
+        job->reach = min(job->R, job->disk ? job->in->width + job->in->height
+                                           : max(job->in->width, job->in->height));
+        if (job->disk) {
+            job->half = DiskHalfWidths(job->reach);
+            if (!job->half) {
+                fprintf(stderr, "daemon: %s: cannot allocate memory for radius %d\n",
+                        job->id, job->R);
+                return -1;
+            }
+        }
+        break;
+    }
+    case PHASE_ROWS:
+        SatRowPassBand(job->sat, job->in, item->begin, item->end);
+        break;
+    case PHASE_COLUMNS:
+        SatColumnPassBand(job->sat, item->begin, item->end);
+        break;
+    case PHASE_EVALUATE:
+        if (job->disk) {
+            if (scratch->width < job->in->width) {
+                MemFree(scratch->acc);
+                scratch->acc = MemAlloc(sizeof(int) * 4 * (size_t)job->in->width);
+                scratch->width = scratch->acc ? job->in->width : 0;
+                if (!scratch->acc) {
+                    fprintf(stderr, "daemon: %s: cannot allocate memory for accumulators\n",
+                            job->id);
+                    return -1;
+                }
+            }
+            DiskBlurBand(job->out, job->sat, job->reach, job->half, scratch->acc,
+                         item->begin, item->end);
+        } else {
+            BoxBlurBand(job->out, job->sat, job->reach, item->begin, item->end);
+        }
+        break;
+    case PHASE_WRITE: {
+        FILE *fp = fopen(job->output, "w");
+
+        if (!fp) {
+            fprintf(stderr, "daemon: %s: cannot open %s\n", job->id, job->output);
+            return -1;
+        }
+        // A full disk fails this job only, whether the write or the final
+        // flush reports it.
+        int written = ImageTryWriteTo(job->out, fp);
+        if (fclose(fp) != 0 || written < 0) {
+            fprintf(stderr, "daemon: %s: cannot write %s\n", job->id, job->output);
+            return -1;
+        }
+        break;
+    }
+    case PHASE_DONE:
+        break;
+    }
+
+    return 0;
+}
+
+static void *worker(void *arg) {
+    Daemon *d = arg;
+    Scratch scratch = { NULL, 0 };
+
+    pthread_mutex_lock(&d->lock);
+    for (;;) {
+        while (d->size == 0 && !d->stopping) {
+            pthread_cond_wait(&d->ready, &d->lock);
+        }
+        if (d->size == 0) {
+            break;
+        }
+
+        Item item = queuePop(d);
+        Job *job = item.job;
+        double t0 = omp_get_wtime();
+
+        if (job->started < 0) {
+            job->started = t0;
+        }
+        pthread_mutex_unlock(&d->lock);
+
+        int status = runItem(&item, &scratch);
+        double t1 = omp_get_wtime();
+
+        pthread_mutex_lock(&d->lock);
+        job->compute += t1 - t0;
+        job->items++;
+        job->failed |= status < 0;
+
+        if (--job->pending == 0) {
+            // The disk blur needs the row pass only.
+            job->phase = job->failed ? PHASE_DONE : job->phase + 1;
+            if (job->phase == PHASE_COLUMNS && job->disk) {
+                job->phase = PHASE_EVALUATE;
+            }
+
+            if (job->phase == PHASE_DONE) {
+                finish(d, job);
+            } else {
+                queuePhase(d, job);
+            }
+        }
+    }
+    pthread_mutex_unlock(&d->lock);
+    MemFree(scratch.acc);
+
+    return NULL;
+}
+
+/**
+ * Parse a request line into a new job. Returns NULL if it is malformed.
+ */
+static Job *parseJob(const char *line) {
+    Job *job = calloc(1, sizeof(Job));
+    char cls[16], engine[16];
+
+    if (!job) {
+        fprintf(stderr, "daemon: cannot allocate memory for job\n");
+        exit(1);
+    }
+
+    if (sscanf(line, "%63s %15s %lf %15s %d %1023s %1023s",
+               job->id, cls, &job->deadline_ms, engine, &job->R,
+               job->input, job->output) != 7
+        || job->R < 0 || job->deadline_ms < 0.0) {
+        free(job);
+        return NULL;
+    }
+
+    job->cls = CLASS_COUNT;
+    for (int c = 0; c < CLASS_COUNT; c++) {
+        if (strcmp(cls, class_names[c]) == 0) {
+            job->cls = c;
+        }
+    }
+    job->disk = strcmp(engine, "disk") == 0;
+    if (job->cls == CLASS_COUNT || (!job->disk && strcmp(engine, "box") != 0)) {
+        free(job);
+        return NULL;
+    }
+
+    job->submitted = omp_get_wtime();
+    job->has_deadline = job->deadline_ms > 0.0;
+    job->deadline = job->submitted + job->deadline_ms / 1e3;
+    job->started = -1.0;
+    job->phase = PHASE_READ;
+
+    return job;
+}
+
+static int compareDouble(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of `n` sorted samples.
+static double percentile(const double *sorted, int n, double p) {
+    int rank = (int)ceil(p / 100.0 * n);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void summary(Daemon *d) {
+    for (int c = 0; c < CLASS_COUNT; c++) {
+        ClassStats *s = &d->stats[c];
+
+        if (s->jobs == 0) {
+            continue;
+        }
+        qsort(s->wait, s->jobs, sizeof(double), compareDouble);
+        qsort(s->latency, s->jobs, sizeof(double), compareDouble);
+        fprintf(stderr,
+                "daemon: %s: %d jobs, wait p50 %.3f ms p99 %.3f ms, "
+                "latency p50 %.3f ms p99 %.3f ms, compute %.3f s, %d deadlines missed\n",
+                class_names[c], s->jobs,
+                1e3 * percentile(s->wait, s->jobs, 50), 1e3 * percentile(s->wait, s->jobs, 99),
+                1e3 * percentile(s->latency, s->jobs, 50),
+                1e3 * percentile(s->latency, s->jobs, 99),
+                s->compute, s->missed);
+        free(s->wait);
+        free(s->latency);
+    }
+}
+
+static void daemonUsage(void) {
+    fprintf(stderr,
+        "usage: fast_blur --daemon [options] < requests\n"
+        "\n"
+        "Reads jobs from standard input, one per line:\n"
+        "\n"
+        "    ID CLASS DEADLINE_MS ENGINE R INPUT OUTPUT\n"
+        "\n"
+        "CLASS is interactive, normal or batch, DEADLINE_MS is relative to the\n"
+        "moment the line is read (0 for none) and ENGINE is box or disk. Prints\n"
+        "a CSV row per finished job and per-class percentiles to stderr at the\n"
+        "end of the input.\n"
+        "\n"
+        "options:\n"
+        "  --workers N    worker threads (default all CPUs)\n"
+        "  --band N       rows or columns per work item (default 64)\n");
+    exit(1);
+}
+
+int DaemonMain(int argc, char *argv[]) {
+    Daemon d;
+    int workers = omp_get_num_procs();
+    char line[4096];
+
+    memset(&d, 0, sizeof(d));
+    d.band = 64;
+
+    for (int i = 1; i < argc; i++) {
+        const char *opt = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (!val) {
+            daemonUsage();
+        } else if (strcmp(opt, "--workers") == 0) {
+            workers = atoi(val) > 0 ? atoi(val) : 1;
+        } else if (strcmp(opt, "--band") == 0) {
+            d.band = atoi(val) > 0 ? atoi(val) : 1;
+        } else {
+            daemonUsage();
+        }
+        i++;
+    }
+
+    pthread_mutex_init(&d.lock, NULL);
+    pthread_cond_init(&d.ready, NULL);
+    pthread_cond_init(&d.idle, NULL);
+
+    pthread_t *threads = malloc(sizeof(pthread_t) * workers);
+    for (int i = 0; i < workers; i++) {
+        pthread_create(&threads[i], NULL, worker, &d);
+    }
+
+    printf("job,class,engine,width,height,radius,items,"
+           "wait_ms,compute_ms,latency_ms,deadline_ms,deadline\n");
+    fflush(stdout);
+
+    while (fgets(line, sizeof(line), stdin)) {
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') {
+            continue;
+        }
+
+        Job *job = parseJob(line);
+        if (!job) {
+            fprintf(stderr, "daemon: malformed request: %s", line);
+            continue;
+        }
+
+        pthread_mutex_lock(&d.lock);
+        job->seq = d.seq++;
+        d.active++;
+        queuePhase(&d, job);
+        pthread_mutex_unlock(&d.lock);
+    }
+
+    pthread_mutex_lock(&d.lock);
+    while (d.active > 0) {
+        pthread_cond_wait(&d.idle, &d.lock);
+    }
+    d.stopping = 1;
+    pthread_cond_broadcast(&d.ready);
+    pthread_mutex_unlock(&d.lock);
+
+    for (int i = 0; i < workers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    free(d.heap);
+
+    summary(&d);
+
+    pthread_mutex_destroy(&d.lock);
+    pthread_cond_destroy(&d.ready);
+    pthread_cond_destroy(&d.idle);
+
+    return 0;
+}
@@ -0,0 +1,31 @@
+/**
+ * Blur daemon with priority classes and deadlines.
+ *
+ * `fast_blur --daemon` reads jobs from standard input, one per line:
+ *
+ *     ID CLASS DEADLINE_MS ENGINE R INPUT OUTPUT
+ *
+ * where CLASS is interactive, normal or batch, DEADLINE_MS is relative to the
+ * moment the line is read (0 for none) and ENGINE is box or disk.
+ *
+ * Every job is split into work items: reading the input, bands of rows of the
+ * row pass, strips of columns of the column pass, bands of rows of the blur
+ * itself and writing the output. A pool of worker threads always runs the
+ * most urgent queued item: lowest class first, then earliest deadline, then
+ * oldest job. A job queues the items of a phase only when the previous phase
+ * is done, so a small interactive job arriving behind a large batch job waits
+ * for the items in flight, one band each, not for the batch job. Batch items
+ * run whenever nothing more urgent is queued and keep idle workers busy.
+ *
+ * A CSV row is printed for every finished job, with the time it waited before
+ * its first item started, the time its items spent computing and its latency.
+ * Per-class percentiles are printed to stderr at the end of the input.
+ */
+
+#ifndef DAEMON_H
+#define DAEMON_H
+
+// Entry point of `fast_blur --daemon ...`; `argv[0]` is the mode.
+int DaemonMain(int argc, char *argv[]);
+
+#endif
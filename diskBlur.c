@@ -0,0 +1,238 @@
+/**
+ * Disk (bokeh) blur, see diskBlur.h.
+ *
+ * Each output row is built in a per-thread accumulator: for every span of the
+ * disk the span sums of a whole source row are added at once. The columns are
+ * split into a left edge, an interior and a right edge so that the interior
+ * loop has no clamping and is vectorized across pixels by the compiler.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "diskBlur.h"
+#include "memTrack.h"
+
+#define min(X, Y) (((X) < (Y)) ? (X) : (Y))
+#define max(X, Y) (((X) < (Y)) ? (Y) : (X))
+
+int DiskHalfWidth(int R, int dy) {
+    const long long r2 = (long long)R * R - (long long)dy * dy;
+
+    if (r2 < 0) {
+        return -1;
+    }
+
+    // The square root in double is within one of the exact integer root.
+    long long w = (long long)sqrt((double)r2);
+    while (w * w > r2) {
+        w--;
+    }
+    while ((w + 1) * (w + 1) <= r2) {
+        w++;
+    }
+    return (int)w;
+}
+
+/**
+ * Add, for every column, the sum of the span [col - w, col + w] of one row of
+ * prefix sums to `acc`.
+ */
+static void addSpans(int *restrict acc, const int *restrict pre, int W, int w) {
+    // Columns below `c0` have their span clamped on the left, columns at or
+    // above `c1` on the right.
+    int c0 = min(w + 1, W);
+    int c1 = max(c0, W - w);
+
+    for (int col = 0; col < c0; col++) {
+        acc[col] += pre[min(col + w, W - 1)];
+    }
+    for (int col = c0; col < c1; col++) {
+        acc[col] += pre[col + w] - pre[col - w - 1];
+    }
+    for (int col = c1; col < W; col++) {
+        acc[col] += pre[W - 1] - (col - w - 1 < 0 ? 0 : pre[col - w - 1]);
+    }
+}
+
+/**
+ * Same as addSpans() but for the number of pixels in each span.
+ */
+static void addCounts(int *restrict cnt, int W, int w) {
+    for (int col = 0; col < W; col++) {
+        cnt[col] += min(col + w, W - 1) - max(col - w, 0) + 1;
+    }
+}
+
+/**
+ * Blur rows [row0, row1) with the half-widths `half` of the spans and
+ * accumulators for 4 * W ints.
+ */
+static void diskRows(
+    Image *img_out, const Sat *sat, int R, const int *half, int *acc, int row0, int row1
+) {
+    const int H = sat->height;
+    const int W = sat->width;
+
+    for (int row = row0; row < row1; row++) {
+        for (int i = 0; i < 4 * W; i++) {
+            acc[i] = 0;
+        }
+
+        for (int dy = max(-R, -row); dy <= min(R, H - 1 - row); dy++) {
+            int w = half[dy + R];
+
+            for (int color = 0; color < 3; color++) {
+                const int *pre = SatPlane(sat, color) + SatIndex(sat, row + dy, 0);
+                addSpans(acc + color * W, pre, W, w);
+            }
+            addCounts(acc + 3 * W, W, w);
+        }
+
+        for (int col = 0; col < W; col++) {
+            for (int color = 0; color < 3; color++) {
+                unsigned char s = SatMean(acc[color * W + col], acc[3 * W + col]);
+                ImageSetPixel(img_out, col, row, color, s);
+            }
+        }
+    }
+}
+
+int *DiskHalfWidths(int R) {
+    int *half = MemAlloc(sizeof(int) * (2 * (size_t)R + 1));
+
+    if (half) {
+        for (int dy = -R; dy <= R; dy++) {
+            half[dy + R] = DiskHalfWidth(R, dy);
+        }
+    }
+    return half;
+}
+
+int DiskTryBlur(Image *img_out, const Sat *sat, int R) {
+    const int H = sat->height;
+    int *half = DiskHalfWidths(R);
+    int failed = 0;
+
+    if (!half) {
+        return -1;
+    }
+
+    #pragma omp parallel
+    {
+        // Accumulators for red, green, blue and the pixel count. A thread
+        // without them still takes part in the loop but skips its rows.
+        int *acc = MemAlloc(sizeof(int) * 4 * (size_t)sat->width);
+
+        if (!acc) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for schedule(static, 4)
+        for (int row = 0; row < H; row++) {
+            if (acc) {
+                diskRows(img_out, sat, R, half, acc, row, row + 1);
+            }
+        }
+
+        MemFree(acc);
+    }
+
+    MemFree(half);
+    return failed ? -1 : 0;
+}
+
+void DiskBlur(Image *img_out, const Sat *sat, int R) {
+    if (DiskTryBlur(img_out, sat, R) < 0) {
+        fprintf(stderr, "disk: cannot allocate memory for accumulators\n");
+        exit(1);
+    }
+}
+
+void DiskBlurBand(
+    Image *img_out, const Sat *sat, int R, const int *half, int *acc, int row0, int row1
+) {
+    diskRows(img_out, sat, R, half, acc, row0, row1);
+}
+
+int PolygonTryBlur(Image *img_out, const Sat *sat, int R, int n) {
+    const int H = sat->height;
+    const int W = sat->width;
+
+    n = max(1, min(n, R + 1));
+
+    // Band `i` covers vertical offsets [lo[i], hi[i]] of the upper half of the
+    // disk and is mirrored to the lower half. Band 0 contains the center row
+    // and is a single rectangle spanning both halves.
+    int *lo = MemAlloc(sizeof(int) * n);
+    int *hi = MemAlloc(sizeof(int) * n);
+    int *half = MemAlloc(sizeof(int) * n);
+
+    if (!lo || !hi || !half) {
+        MemFree(lo);
+        MemFree(hi);
+        MemFree(half);
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        lo[i] = i * (R + 1) / n;
+        hi[i] = (i + 1) * (R + 1) / n - 1;
+        half[i] = DiskHalfWidth(R, (lo[i] + hi[i] + 1) / 2);
+    }
+
+    #pragma omp parallel for schedule(static, 4)
+    for (int row = 0; row < H; row++) {
+        for (int col = 0; col < W; col++) {
+            int sums[3] = {0, 0, 0};
+            int pixels = 0;
+
+            for (int i = 0; i < n; i++) {
+                int x_min = max(col - half[i], 0);
+                int x_max = min(col + half[i], W - 1);
+
+                // Upper rectangle (or the whole center band), then its mirror.
+                for (int side = 0; side < (i == 0 ? 1 : 2); side++) {
+                    int y0 = i == 0 ? row - hi[0]
+                           : side == 0 ? row - hi[i]
+                           :             row + lo[i];
+                    int y1 = i == 0 ? row + hi[0]
+                           : side == 0 ? row - lo[i]
+                           :             row + hi[i];
+                    int y_min = max(y0, 0);
+                    int y_max = min(y1, H - 1);
+
+                    if (y_min > y_max) {
+                        continue;
+                    }
+
+                    pixels += (x_max - (x_min - 1)) * (y_max - (y_min - 1));
+                    for (int color = 0; color < 3; color++) {
+                        sums[color] += SatRectSum(
+                            sat, SatPlane(sat, color), x_min, y_min, x_max, y_max
+                        );
+                    }
+                }
+            }
+
+            for (int color = 0; color < 3; color++) {
+                unsigned char s = SatMean(sums[color], pixels);
+                ImageSetPixel(img_out, col, row, color, s);
+            }
+        }
+    }
+
+    MemFree(lo);
+    MemFree(hi);
+    MemFree(half);
+    return 0;
+}
+
+void PolygonBlur(Image *img_out, const Sat *sat, int R, int n) {
+    if (PolygonTryBlur(img_out, sat, R, n) < 0) {
+        fprintf(stderr, "polygon: cannot allocate memory for bands\n");
+        exit(1);
+    }
+}
@@ -0,0 +1,47 @@
+/**
+ * Disk (bokeh) blur.
+ *
+ * A disk of radius R is a stack of 2R + 1 horizontal spans. With the per-row
+ * prefix sums left by SatRowPass() every span is a single subtraction, so a
+ * pixel costs O(R) instead of O(R^2).
+ */
+
+#ifndef DISK_BLUR_H
+#define DISK_BLUR_H
+
+#include "ppmFile.h"
+#include "sat.h"
+
+// Half-width of the disk span at vertical offset `dy`: the largest `w` such
+// that w^2 + dy^2 <= R^2.
+int DiskHalfWidth(int R, int dy);
+
+// Blur with a disk of radius R. `sat` must be row-major and hold the row pass
+// only.
+void DiskBlur(Image *img_out, const Sat *sat, int R);
+
+// Same as DiskBlur(), but returns -1 instead of exiting if its scratch cannot
+// be allocated (the output is then incomplete), 0 on success.
+int DiskTryBlur(Image *img_out, const Sat *sat, int R);
+
+// Half-widths of the 2R + 1 spans, indexed by dy + R, for DiskBlurBand().
+// Returns NULL if out of memory; release with MemFree().
+int *DiskHalfWidths(int R);
+
+// Same as DiskBlur() for output rows [row0, row1) only, on the calling thread,
+// with the spans from DiskHalfWidths(R) and accumulators for 4 * width ints,
+// so that a caller running many bands allocates neither per band.
+void DiskBlurBand(
+    Image *img_out, const Sat *sat, int R, const int *half, int *acc, int row0, int row1
+);
+
+// Blur with a polygonal aperture: the disk approximated by `n` stacked bands,
+// i.e. 2n - 1 rectangles, each evaluated with one lookup of the full table.
+// `sat` must hold both passes.
+void PolygonBlur(Image *img_out, const Sat *sat, int R, int n);
+
+// Same as PolygonBlur(), but returns -1 instead of exiting when memory runs
+// out, 0 on success.
+int PolygonTryBlur(Image *img_out, const Sat *sat, int R, int n);
+
+#endif
@@ -13,19 +13,33 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <omp.h>
 
 #include "ppmFile.h"
+#include "sat.h"
+#include "boxBlur.h"
+#include "diskBlur.h"
+#include "sepConv.h"
+#include "conv2d.h"
+#include "fft.h"
+#include "bench.h"
+#include "roofline.h"
+#include "daemon.h"
+#include "ringServe.h"
+#include "tuning.h"
+#include "match.h"
+#include "clahe.h"
+#include "bilateral.h"
+#include "mosaic.h"
+#include "maskBlur.h"
+#include "atlas.h"
+#include "tiledFile.h"
+#include "memTrack.h"
 
 #define min(X, Y) (((X) < (Y)) ? (X) : (Y))
 #define max(X, Y) (((X) < (Y)) ? (Y) : (X))
 
-/**
- * Get linear index from a (row, col) for a linearly allocated 2D array.
- */
-int idx(int row, int col, int width, int g) {
-    return (row * width + col) * g;
-}
-
 /* Is provided for reference, but experiments show using a transpose leads to
  * slightly slower performance.
  */
@@ -50,128 +64,288 @@ int idx(int row, int col, int width, int g) {
 //     free(transposed_matrix);
 // }
 
+typedef enum { MODE_BOX, MODE_DISK, MODE_POLYGON, MODE_SEP, MODE_CONV } Mode;
+
+/**
+ * Bytes allocated at the peak of a run, which is while the blur runs: both
+ * images plus the engine's tables and per-thread scratch. This mirrors the
+ * allocations of the engines and has to be kept in sync with them.
+ */
+static size_t estimatePeak(
+    Mode mode, int W, int H, int R, SatLayout layout,
+    const Kernel1D *kx, const Kernel1D *ky, const Kernel2D *kernel, ConvEngine engine
+) {
+    const size_t T = omp_get_max_threads();
+    const size_t n = (size_t)W * H;
+    size_t bytes = 2 * (sizeof(Image) + 3 * n);
+
+    switch (mode) {
+    case MODE_BOX:
+    case MODE_POLYGON:
+    case MODE_DISK: {
+        size_t entries = 3 * n;
+        if (mode != MODE_DISK && layout == SAT_TILED) {
+            size_t tx = (W + SAT_TILE - 1) / SAT_TILE;
+            size_t ty = (H + SAT_TILE - 1) / SAT_TILE;
+            entries = 3 * tx * ty * SAT_TILE * SAT_TILE;
+        } else if (mode != MODE_DISK && layout == SAT_INTERLEAVED) {
+            entries = SAT_LANES * n;
+        }
+        bytes += sizeof(Sat) + sizeof(int) * entries;
+        if (mode == MODE_DISK) {
+            bytes += T * 4 * sizeof(int) * W + sizeof(int) * (2 * R + 1);
+        } else if (mode == MODE_POLYGON) {
+            bytes += 3 * sizeof(int) * (R + 1);
+        }
+        break;
+    }
+    case MODE_SEP:
+        bytes += 4 * sizeof(float) * n + T * sizeof(float) * (W + 2 * kx->radius)
+               + sizeof(float) * (2 * kx->radius + 2 * ky->radius + 2);
+        break;
+    case MODE_CONV: {
+        ConvPlan plan = ConvPlanCreate(kernel, engine);
+        size_t tile = (size_t)plan.tile * plan.tile;
+
+        bytes += 6 * sizeof(float) * n + sizeof(float) * kernel->width * kernel->height;
+        if (plan.engine == CONV_FFT) {
+            bytes += 2 * sizeof(float) * tile + T * 3 * sizeof(float) * tile
+                   + sizeof(FftPlan) + 2 * sizeof(float) * (plan.tile / 2 + 1)
+                   + sizeof(int) * plan.tile;
+        } else {
+            bytes += T * sizeof(float) * (W + kernel->width);
+        }
+        break;
+    }
+    }
+
+    return bytes;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "usage: %s [options] R input.ppm output.ppm\n"
+        "       %s --sep TAPS_X TAPS_Y input.ppm output.ppm\n"
+        "       %s --kernel FILE [--engine E] input.ppm output.ppm\n"
+        "       %s --bench [options]\n"
+        "       %s --bench-scaling [options]\n"
+        "       %s --profile [options]\n"
+        "       %s --daemon [options] < requests\n"
+        "       %s --ring NAME --size WxH [options] R\n"
+        "       %s --match [options] template.ppm input.ppm\n"
+        "       %s --clahe [options] input.ppm output.ppm\n"
+        "       %s --bilateral [options] input.ppm output.ppm\n"
+        "       %s --mosaic [options] input.ppm output.ppm\n"
+        "       %s --mask R input.pbm output.pgm\n"
+        "       %s --atlas RECTS [options] R input.ppm output.ppm\n"
+        "       %s --tiled pack|unpack|blur [options] ...\n"
+        "\n"
+        "options:\n"
+        "  --disk         blur with a disk of radius R instead of a square\n"
+        "  --polygon N    blur with the disk approximated by N stacked bands\n"
+        "  --sep X Y      convolve rows with taps X and columns with taps Y,\n"
+        "                 given as comma separated lists, e.g. 1,4,6,4,1\n"
+        "  --kernel FILE  convolve with the 2D kernel in FILE (\"width height\"\n"
+        "                 followed by the taps, row-major)\n"
+        "  --engine E     engine for --kernel: auto (default), direct or fft\n"
+        "  --layout L     summed-area table layout for the box and polygon\n"
+        "                 blurs: rows (default), tiled or interleaved\n"
+        "  --tuning FILE  run each pass of the summed-area table blurs with the\n"
+        "                 threads per core chosen by --profile --tuning FILE\n"
+        "  --mem-report   print the peak allocated bytes of each stage\n"
+        "  --estimate WxH print the expected peak allocated bytes of a run on a\n"
+        "                 WxH image with the other options, without running it;\n"
+        "                 the input and output files are then omitted\n",
+        prog, prog, prog, prog, prog, prog, prog, prog, prog, prog, prog, prog, prog,
+        prog, prog);
+    exit(1);
+}
+
 int main(int argc, char *argv[]) {
-    char *file_in_name = argv[2];
-    char *file_out_name = argv[3];
-    const int R = atoi(argv[1]);
+    Mode mode = MODE_BOX;
+    int bands = 0;
+    int mem_report = 0;
+    int estimate_w = 0, estimate_h = 0;
+    Kernel1D kx, ky;
+    Kernel2D kernel;
+    ConvEngine engine = CONV_AUTO;
+    SatLayout layout = SAT_ROW_MAJOR;
+    const char *tuning_path = NULL;
 
+    // Benchmark and daemon modes parse their own options.
+    if (argc > 1 && strcmp(argv[1], "--bench-scaling") == 0) {
+        return BenchScalingMain(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        return BenchMain(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "--profile") == 0) {
+        return ProfileMain(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "--daemon") == 0) {
+        return DaemonMain(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "--ring") == 0) {
+        return RingMain(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "--match") == 0) {
+        return MatchMain(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "--clahe") == 0) {
+        return ClaheMain(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bilateral") == 0) {
+        return BilateralMain(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "--mosaic") == 0) {
+        return MosaicMain(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "--mask") == 0) {
+        return MaskMain(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "--atlas") == 0) {
+        return AtlasMain(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "--tiled") == 0) {
+        return TiledMain(argc - 1, argv + 1);
+    }
+
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; arg++) {
+        if (strcmp(argv[arg], "--disk") == 0) {
+            mode = MODE_DISK;
+        } else if (strcmp(argv[arg], "--polygon") == 0 && arg + 1 < argc) {
+            mode = MODE_POLYGON;
+            bands = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "--sep") == 0 && arg + 2 < argc) {
+            mode = MODE_SEP;
+            if (KernelParse(argv[arg + 1], &kx) || KernelParse(argv[arg + 2], &ky)) {
+                fprintf(stderr, "kernels must have an odd number of taps\n");
+                usage(argv[0]);
+            }
+            arg += 2;
+        } else if (strcmp(argv[arg], "--kernel") == 0 && arg + 1 < argc) {
+            mode = MODE_CONV;
+            if (Kernel2DRead(argv[++arg], &kernel)) {
+                fprintf(stderr, "cannot read kernel from %s\n", argv[arg]);
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[arg], "--engine") == 0 && arg + 1 < argc) {
+            engine = ConvEngineFromName(argv[++arg]);
+            if (engine == CONV_ENGINE_INVALID) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[arg], "--layout") == 0 && arg + 1 < argc) {
+            layout = SatLayoutFromName(argv[++arg]);
+            if (layout == SAT_LAYOUT_INVALID) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[arg], "--tuning") == 0 && arg + 1 < argc) {
+            tuning_path = argv[++arg];
+        } else if (strcmp(argv[arg], "--mem-report") == 0) {
+            mem_report = 1;
+        } else if (strcmp(argv[arg], "--estimate") == 0 && arg + 1 < argc) {
+            if (sscanf(argv[++arg], "%dx%d", &estimate_w, &estimate_h) != 2) {
+                usage(argv[0]);
+            }
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    // Only the summed-area table modes take a radius.
+    const int has_radius = mode != MODE_SEP && mode != MODE_CONV;
+    const int has_files = estimate_w == 0;
+    if (argc - arg != 2 * has_files + has_radius) {
+        usage(argv[0]);
+    }
+
+    const int R = has_radius ? atoi(argv[arg]) : 0;
+
+    if (!has_files) {
+        printf("%zu\n", estimatePeak(
+            mode, estimate_w, estimate_h, R, layout, &kx, &ky, &kernel, engine
+        ));
+        return 0;
+    }
+
+    char *file_in_name = argv[arg + has_radius];
+    char *file_out_name = argv[arg + has_radius + 1];
+
+    MemStage("read");
     Image *img_in = ImageRead(file_in_name);
     const int H = img_in->height;
     const int W = img_in->width;
 
     Image *img_out = ImageCreate(W, H);
 
-    // Sums of all rectangles, for each pixel, from (0, 0) to the pixel; one per
-    // color channel.
-    int *sums_r = malloc(sizeof(int) * H * W);
-    int *sums_g = malloc(sizeof(int) * H * W);
-    int *sums_b = malloc(sizeof(int) * H * W);
-
-    // The work of computing the rectangular sums is divided into two parts to
-    // enabled parallelization.
-
-    // First part will compute, for each row, the sums of all pixels left of
-    // each pixel.  The image pixel is accessed here to avoid performing an
-    // additional pixel traversal in a separate double-for-loop structure to
-    // initialize the sums_* matrices with image pixels.
-    #pragma omp parallel for schedule(static, 4)
-    for (int row = 0; row < H; row++) {
-        for (int col = 1; col < W; col++) {
-            sums_r[idx(row, col, W, 1)]
-                = ImageGetPixel(img_in, col, row, 0) + sums_r[idx(row, col - 1, W, 1)];
-            sums_g[idx(row, col, W, 1)]
-                = ImageGetPixel(img_in, col, row, 1) + sums_g[idx(row, col - 1, W, 1)];
-            sums_b[idx(row, col, W, 1)]
-                = ImageGetPixel(img_in, col, row, 2) + sums_b[idx(row, col - 1, W, 1)];
-        }
-    }
+    MemStage("blur");
+    if (mode == MODE_SEP) {
+        SepConv(img_in, img_out, &kx, &ky);
+        KernelFree(&kx);
+        KernelFree(&ky);
+    } else if (mode == MODE_CONV) {
+        Conv2D(img_in, img_out, &kernel, ConvPlanCreate(&kernel, engine));
+        Kernel2DFree(&kernel);
+    } else {
+        // Sums of all rectangles, for each pixel, from (0, 0) to the pixel; one
+        // per color channel.
+        // The disk blur reads whole rows of prefix sums and needs them
+        // row-major.
+        Sat *sat = SatCreate(W, H, mode == MODE_DISK ? SAT_ROW_MAJOR : layout);
 
-    // The second part will compute, for each column, the sum of all pixels from
-    // (0, 0) to the pixel by adding the sum of the pixel above (which contains
-    // the sum of all pixels to its left) with the current pixel. This will
-    // results in computation of the sums of all pixels from (0, 0) to the
-    // current pixel.
-    // We can transpose the image pixels to avoid accessing in column-major
-    // direction, but experimentally, it was slower than performing this
-    // computation in column-major. If transposing is done, the data must be
-    // transposed again to get it back to the original layout after the
-    // computation on the columns is done.
-    #pragma omp parallel for schedule(static, 4)
-    for (int col = 0; col < W; col++) {
-        for (int row = 1; row < H; row++) {
-            sums_r[idx(row, col, W, 1)] += sums_r[idx(row - 1, col, W, 1)];
-            sums_g[idx(row, col, W, 1)] += sums_g[idx(row - 1, col, W, 1)];
-            sums_b[idx(row, col, W, 1)] += sums_b[idx(row - 1, col, W, 1)];
+        // Without a profile every pass keeps the default team.
+        Tuning tuning;
+        Topology *topo = NULL;
+        TuningDefault(&tuning);
+        if (tuning_path) {
+            if (TuningLoad(tuning_path, &tuning) < 0) {
+                fprintf(stderr, "cannot read tuning profile from %s\n", tuning_path);
+                exit(1);
+            }
+            topo = TopologyDetect();
+            TuningStart(&tuning, topo);
         }
-    }
 
-    // Perform the blur value of each pixel
-    #pragma omp parallel for schedule(static, 4)
-    for (int row = 0; row < H; row++) {
-        for (int col = 0; col < W; col++) {
-            // Coordinated of the corners of the square surrounding the pixel.
-            int x_min = max(col - R, 0);
-            int x_max = min(col + R, W - 1);
-            int y_min = max(row - R, 0);
-            int y_max = min(row + R, H - 1);
-
-            // Number of pixels in the square.
-            int pixels = (x_max - (x_min - 1)) * (y_max - (y_min - 1));
-
-            // Do for each color channel (red, green, blue).
-            for (int color = 0; color < 3; color++) {
-                int *sums_color
-                    = color == 0 ? sums_r
-                    : color == 1 ? sums_g
-                    :              sums_b;
-
-                // The computation occurring below can be visually described,
-                //      0      m        n
-                //    0 +------+--------+-> rows
-                //      |  a   |   b    |
-                //    p +------+--------+
-                //      |      |        |
-                //      |  c   |   d    |
-                //      |      |        |
-                //    q +------+--------+
-                //      |
-                //      v
-                //     columns
-                //
-                //  Where,
-                //     'a' is a rectangle from (0, 0) to (p, m)
-                //     'b' is a rectangle from (0, 0) to (p, n)
-                //     'c' is a rectangle from (0, 0) to (q, m)
-                //     'd' is a rectangle from (0, 0) to (q, n)
-                //
-                // The current pixel is in the middle of the box from (p, m) to
-                // (q, n). The sum of all the pixels in the box surrounding the
-                // pixel is then equal to `d - (c + b - a)`.
-                int a = y_min < 1 || x_min < 1
-                    ? 0
-                    : sums_color[idx(y_min - 1, x_min - 1, W, 1)];
-                int b = y_min < 1
-                    ? 0
-                    : sums_color[idx(y_min - 1, x_max, W, 1)];
-                int c = x_min < 1
-                    ? 0
-                    : sums_color[idx(y_max, x_min - 1, W, 1)];
-                int d = sums_color[idx(y_max, x_max, W, 1)];
-
-                // Pixel's blurred value
-                unsigned char s = (float)(d - (b + c - a)) / pixels;
-
-                ImageSetPixel(img_out, col, row, color, s);
+        // The work of computing the rectangular sums is divided into two parts
+        // to enabled parallelization. The first part computes, for each row,
+        // the sums of all pixels left of each pixel; the disk blur needs
+        // nothing more.
+        TuningPass(&tuning, TUNE_ROW);
+        SatRowPass(sat, img_in);
+
+        if (mode == MODE_DISK) {
+            TuningPass(&tuning, TUNE_EVALUATE);
+            DiskBlur(img_out, sat, R);
+        } else {
+            // The second part computes, for each column, the sum of all pixels
+            // from (0, 0) to the pixel.
+            TuningPass(&tuning, TUNE_COLUMN);
+            SatColumnPass(sat);
+
+            TuningPass(&tuning, TUNE_EVALUATE);
+            if (mode == MODE_POLYGON) {
+                PolygonBlur(img_out, sat, R, bands);
+            } else {
+                BoxBlur(img_out, sat, R);
             }
+        }
 
+        SatFree(sat);
+        if (topo) {
+            TuningStop(&tuning, topo);
+            TopologyFree(topo);
         }
     }
 
+    MemStage("write");
+    ImageFree(img_in);
     ImageWrite(img_out, file_out_name);
+    ImageFree(img_out);
 
-    free(sums_r);
-    free(sums_g);
-    free(sums_b);
+    if (mem_report) {
+        MemReport(stderr);
+    }
 
     return 0;
 }
@@ -0,0 +1,414 @@
+/**
+ * Header-only C++17 interface to the blur engines.
+ *
+ * The C engines work on packed 8-bit RGB images and allocate their own
+ * tables. This header has the same algorithms as templates over the pixel
+ * type and channel count. They operate on strided views into caller memory
+ * and never allocate: the summed-area table or intermediate plane lives in a
+ * scratch buffer the caller provides, sized with ScratchCount(). A service can
+ * inline them into its hot path on its own frames.
+ *
+ *  - Box: mean over the (2R + 1)^2 square, shrunk at the borders (boxBlur.c);
+ *  - Disk: mean over the pixels with dx^2 + dy^2 <= R^2, from row prefix sums
+ *    only (diskBlur.c);
+ *  - Sep: separable convolution with clamped borders (sepConv.c).
+ *
+ * Integer pixels are averaged with truncation and convolved with rounding and
+ * saturation, exactly like the C engines for uint8_t RGB; floating-point
+ * pixels are neither rounded nor clamped. Box and Disk also come with the
+ * radius as a template argument, Box<R>(...), which turns the division of
+ * interior pixels into a multiplication and lets Disk build its half-width
+ * table at compile time.
+ *
+ * Views may alias: the source is consumed into the scratch buffer before the
+ * destination is written, so blurring in place is allowed. Loops are
+ * parallelized with OpenMP when compiled with -fopenmp.
+ *
+ *     std::vector<fastblur::Sum<uint8_t>> scratch(fastblur::ScratchCount<3>(w, h));
+ *     fastblur::ImageView<uint8_t, 3> frame(pixels, w, h, row_stride);
+ *     fastblur::Box<8>(frame, frame, scratch.data());
+ */
+
+#ifndef FAST_BLUR_HPP
+#define FAST_BLUR_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+namespace fastblur {
+
+/**
+ * A width x height image of C interleaved channels of type T, whose rows are
+ * `stride` elements apart (width * C when packed). T may be const.
+ */
+template <typename T, int C>
+struct ImageView {
+    static_assert(C >= 1, "an image has at least one channel");
+
+    T *data;
+    int width;
+    int height;
+    std::ptrdiff_t stride;
+
+    constexpr ImageView(T *data, int width, int height, std::ptrdiff_t stride = 0)
+        : data(data), width(width), height(height),
+          stride(stride ? stride : static_cast<std::ptrdiff_t>(width) * C) {}
+
+    T *Row(int y) const { return data + y * stride; }
+};
+
+/**
+ * Type of the sums of T. Unsigned sums wrap, but the sum over a window is
+ * still exact as long as it fits: up to 2^32 / 255 pixels for uint8_t.
+ */
+template <typename T>
+struct SumOf {
+    static_assert(std::is_floating_point_v<T> || std::is_unsigned_v<T>,
+                  "pixels are unsigned integers or floating point");
+
+    using type = std::conditional_t<
+        std::is_floating_point_v<T>, double,
+        std::conditional_t<(sizeof(T) == 1), std::uint32_t, std::uint64_t>>;
+};
+
+template <typename T>
+using Sum = typename SumOf<T>::type;
+
+// Number of elements of scratch for a width x height image of C channels:
+// Sum<T> for Box and Disk, float for Sep.
+template <int C>
+constexpr std::size_t ScratchCount(int width, int height) {
+    return static_cast<std::size_t>(width) * height * C;
+}
+
+// Largest w such that w^2 + dy^2 <= R^2, or -1 if |dy| > R (DiskHalfWidth()).
+constexpr int HalfWidth(int R, int dy) {
+    int r2 = R * R - dy * dy;
+    int w = 0;
+
+    if (r2 < 0) {
+        return -1;
+    }
+    while ((w + 1) * (w + 1) <= r2) {
+        w++;
+    }
+    return w;
+}
+
+namespace detail {
+
+// Radius known only at run time; the compile-time one is integral_constant.
+struct Radius {
+    int value;
+    constexpr operator int() const { return value; }
+};
+
+template <typename T, typename S>
+inline T Mean(S sum, S count) {
+    return static_cast<T>(sum / count);
+}
+
+template <typename T>
+inline T Saturate(float v) {
+    if constexpr (std::is_floating_point_v<T>) {
+        return static_cast<T>(v);
+    } else {
+        v += 0.5f;
+        return v < 0.0f ? T(0)
+             : v > static_cast<float>(std::numeric_limits<T>::max()) ? std::numeric_limits<T>::max()
+             : static_cast<T>(v);
+    }
+}
+
+/**
+ * Leave in every entry the sum of its row up to and including it.
+ */
+template <typename T, int C>
+void RowPass(ImageView<const T, C> src, Sum<T> *sums) {
+    const int W = src.width;
+
+    #pragma omp parallel for schedule(static, 4)
+    for (int row = 0; row < src.height; row++) {
+        const T *in = src.Row(row);
+        Sum<T> *out = sums + static_cast<std::size_t>(row) * W * C;
+        Sum<T> acc[C] = {};
+
+        for (int col = 0; col < W; col++) {
+            for (int c = 0; c < C; c++) {
+                out[col * C + c] = acc[c] += in[col * C + c];
+            }
+        }
+    }
+}
+
+/**
+ * Accumulate the row sums downwards. Threads take strips of columns and walk
+ * them top to bottom; within a row the strip is contiguous and vectorizes.
+ */
+template <typename S>
+void ColumnPass(S *sums, int W, int H, int C) {
+    const std::ptrdiff_t n = static_cast<std::ptrdiff_t>(W) * C;
+    const std::ptrdiff_t strip = 512;
+
+    #pragma omp parallel for schedule(static, 1)
+    for (std::ptrdiff_t i0 = 0; i0 < n; i0 += strip) {
+        const std::ptrdiff_t i1 = std::min(i0 + strip, n);
+
+        for (int row = 1; row < H; row++) {
+            S *cur = sums + row * n;
+            const S *up = cur - n;
+
+            for (std::ptrdiff_t i = i0; i < i1; i++) {
+                cur[i] += up[i];
+            }
+        }
+    }
+}
+
+template <typename R, typename T, int C>
+void BoxEvaluate(const Sum<T> *sums, ImageView<T, C> dst, R radius) {
+    using S = Sum<T>;
+    const int W = dst.width;
+    const int H = dst.height;
+    const int r = radius;
+
+    // Columns below `c0` have their window clamped on the left, columns at or
+    // above `c1` on the right.
+    const int c0 = std::min(r, W);
+    const int c1 = std::max(c0, W - r);
+
+    #pragma omp parallel for schedule(static, 4)
+    for (int row = 0; row < H; row++) {
+        const int y_min = std::max(row - r, 0);
+        const int y_max = std::min(row + r, H - 1);
+        const S *up = y_min > 0 ? sums + static_cast<std::size_t>(y_min - 1) * W * C : nullptr;
+        const S *down = sums + static_cast<std::size_t>(y_max) * W * C;
+        T *out = dst.Row(row);
+
+        // Same corners as BoxBlur(): d - (b + c - a), with a and b on the row
+        // above the window, which is all zeros at the top.
+        auto rect = [&](int x_min, int x_max, int ch) {
+            S a = up && x_min > 0 ? up[(x_min - 1) * C + ch] : S(0);
+            S b = up ? up[x_max * C + ch] : S(0);
+            S c = x_min > 0 ? down[(x_min - 1) * C + ch] : S(0);
+            return down[x_max * C + ch] - (b + c - a);
+        };
+
+        for (int col = 0; col < c0; col++) {
+            const int x_max = std::min(col + r, W - 1);
+            const S pixels = static_cast<S>(x_max + 1) * (y_max - y_min + 1);
+
+            for (int ch = 0; ch < C; ch++) {
+                out[col * C + ch] = Mean<T>(rect(0, x_max, ch), pixels);
+            }
+        }
+
+        // The interior window is never clamped horizontally. With full rows
+        // its area is a constant, which a compile-time radius divides by
+        // with a multiplication.
+        if (row - r >= 0 && row + r < H) {
+            const S area = static_cast<S>(2 * r + 1) * (2 * r + 1);
+
+            for (int col = c0; col < c1; col++) {
+                for (int ch = 0; ch < C; ch++) {
+                    out[col * C + ch] = Mean<T>(rect(col - r, col + r, ch), area);
+                }
+            }
+        } else {
+            const S pixels = static_cast<S>(2 * r + 1) * (y_max - y_min + 1);
+
+            for (int col = c0; col < c1; col++) {
+                for (int ch = 0; ch < C; ch++) {
+                    out[col * C + ch] = Mean<T>(rect(col - r, col + r, ch), pixels);
+                }
+            }
+        }
+
+        for (int col = c1; col < W; col++) {
+            const int x_min = std::max(col - r, 0);
+            const S pixels = static_cast<S>(W - x_min) * (y_max - y_min + 1);
+
+            for (int ch = 0; ch < C; ch++) {
+                out[col * C + ch] = Mean<T>(rect(x_min, W - 1, ch), pixels);
+            }
+        }
+    }
+}
+
+template <typename R, typename T, int C>
+void DiskEvaluate(const Sum<T> *pre, ImageView<T, C> dst, R radius) {
+    using S = Sum<T>;
+    const int W = dst.width;
+    const int H = dst.height;
+    const int r = radius;
+
+    // Columns are processed in chunks so the accumulators fit on the stack.
+    constexpr int chunk = 256;
+
+    #pragma omp parallel for schedule(static, 4)
+    for (int row = 0; row < H; row++) {
+        T *out = dst.Row(row);
+
+        for (int c0 = 0; c0 < W; c0 += chunk) {
+            const int c1 = std::min(c0 + chunk, W);
+            S acc[chunk * C] = {};
+            S cnt[chunk] = {};
+
+            for (int dy = std::max(-r, -row); dy <= std::min(r, H - 1 - row); dy++) {
+                const S *line = pre + static_cast<std::size_t>(row + dy) * W * C;
+                int w;
+
+                if constexpr (std::is_same_v<R, Radius>) {
+                    // Integer square root, corrected for rounding of the float one.
+                    w = static_cast<int>(std::sqrt(static_cast<double>(r * r - dy * dy)));
+                    w += (w + 1) * (w + 1) + dy * dy <= r * r;
+                    w -= w * w + dy * dy > r * r;
+                } else {
+                    static constexpr auto half = [] {
+                        std::array<int, 2 * R::value + 1> h{};
+                        for (int i = 0; i <= 2 * R::value; i++) {
+                            h[i] = HalfWidth(R::value, i - R::value);
+                        }
+                        return h;
+                    }();
+                    w = half[dy + r];
+                }
+
+                for (int col = c0; col < c1; col++) {
+                    const int x_min = std::max(col - w, 0);
+                    const int x_max = std::min(col + w, W - 1);
+
+                    for (int ch = 0; ch < C; ch++) {
+                        acc[(col - c0) * C + ch] += line[x_max * C + ch]
+                            - (x_min > 0 ? line[(x_min - 1) * C + ch] : S(0));
+                    }
+                    cnt[col - c0] += x_max - x_min + 1;
+                }
+            }
+
+            for (int col = c0; col < c1; col++) {
+                for (int ch = 0; ch < C; ch++) {
+                    out[col * C + ch] = Mean<T>(acc[(col - c0) * C + ch], cnt[col - c0]);
+                }
+            }
+        }
+    }
+}
+
+template <typename Src, typename T, int C>
+void CheckViews(const ImageView<Src, C> &src, const ImageView<T, C> &dst) {
+    static_assert(std::is_same_v<std::remove_const_t<Src>, T>,
+                  "source and destination have the same pixel type");
+    static_assert(!std::is_const_v<T>, "the destination is writable");
+    (void)src;
+    (void)dst;
+}
+
+}  // namespace detail
+
+/**
+ * Box blur of radius R. `scratch` holds ScratchCount<C>(width, height) sums.
+ */
+template <typename Src, typename T, int C>
+void Box(ImageView<Src, C> src, ImageView<T, C> dst, int R, Sum<T> *scratch) {
+    detail::CheckViews(src, dst);
+    detail::RowPass<T, C>({src.data, src.width, src.height, src.stride}, scratch);
+    detail::ColumnPass(scratch, src.width, src.height, C);
+    detail::BoxEvaluate(scratch, dst, detail::Radius{R});
+}
+
+template <int R, typename Src, typename T, int C>
+void Box(ImageView<Src, C> src, ImageView<T, C> dst, Sum<T> *scratch) {
+    static_assert(R >= 0, "the radius is non-negative");
+    detail::CheckViews(src, dst);
+    detail::RowPass<T, C>({src.data, src.width, src.height, src.stride}, scratch);
+    detail::ColumnPass(scratch, src.width, src.height, C);
+    detail::BoxEvaluate(scratch, dst, std::integral_constant<int, R>{});
+}
+
+/**
+ * Disk blur of radius R. `scratch` holds ScratchCount<C>(width, height) sums.
+ */
+template <typename Src, typename T, int C>
+void Disk(ImageView<Src, C> src, ImageView<T, C> dst, int R, Sum<T> *scratch) {
+    detail::CheckViews(src, dst);
+    detail::RowPass<T, C>({src.data, src.width, src.height, src.stride}, scratch);
+    detail::DiskEvaluate(scratch, dst, detail::Radius{R});
+}
+
+template <int R, typename Src, typename T, int C>
+void Disk(ImageView<Src, C> src, ImageView<T, C> dst, Sum<T> *scratch) {
+    static_assert(R >= 0, "the radius is non-negative");
+    detail::CheckViews(src, dst);
+    detail::RowPass<T, C>({src.data, src.width, src.height, src.stride}, scratch);
+    detail::DiskEvaluate(scratch, dst, std::integral_constant<int, R>{});
+}
+
+/**
+ * Convolve rows with the 2 * rx + 1 taps `kx` and columns with the 2 * ry + 1
+ * taps `ky`, as given (not normalized). `scratch` holds
+ * ScratchCount<C>(width, height) floats.
+ */
+template <typename Src, typename T, int C>
+void Sep(ImageView<Src, C> src, ImageView<T, C> dst,
+         const float *kx, int rx, const float *ky, int ry, float *scratch) {
+    detail::CheckViews(src, dst);
+    const int W = src.width;
+    const int H = src.height;
+    const std::ptrdiff_t n = static_cast<std::ptrdiff_t>(W) * C;
+
+    #pragma omp parallel for schedule(static, 4)
+    for (int row = 0; row < H; row++) {
+        const Src *in = src.Row(row);
+        float *tmp = scratch + row * n;
+
+        for (int col = 0; col < W; col++) {
+            float acc[C] = {};
+
+            for (int t = -rx; t <= rx; t++) {
+                const int x = std::min(std::max(col + t, 0), W - 1);
+
+                for (int ch = 0; ch < C; ch++) {
+                    acc[ch] += kx[t + rx] * static_cast<float>(in[x * C + ch]);
+                }
+            }
+            for (int ch = 0; ch < C; ch++) {
+                tmp[col * C + ch] = acc[ch];
+            }
+        }
+    }
+
+    // Tap loop outside, contiguous row loop inside, as in SepConvPlane().
+    #pragma omp parallel for schedule(static, 4)
+    for (int row = 0; row < H; row++) {
+        T *out = dst.Row(row);
+        float acc[512];
+
+        for (std::ptrdiff_t i0 = 0; i0 < n; i0 += 512) {
+            const std::ptrdiff_t m = std::min<std::ptrdiff_t>(512, n - i0);
+
+            std::fill(acc, acc + m, 0.0f);
+            for (int t = -ry; t <= ry; t++) {
+                const int y = std::min(std::max(row + t, 0), H - 1);
+                const float *line = scratch + y * n + i0;
+                const float k = ky[t + ry];
+
+                for (std::ptrdiff_t i = 0; i < m; i++) {
+                    acc[i] += k * line[i];
+                }
+            }
+            for (std::ptrdiff_t i = 0; i < m; i++) {
+                out[i0 + i] = detail::Saturate<T>(acc[i]);
+            }
+        }
+    }
+}
+
+}  // namespace fastblur
+
+#endif
@@ -0,0 +1,624 @@
+/**
+ * Python bindings (the `fastblur` extension module).
+ *
+ * Every function takes an RGB image as any object exporting a (height, width,
+ * 3) uint8 buffer, such as a NumPy array, and works on its memory without
+ * copying when rows are packed pixels, whatever the gap between rows: slices
+ * and crops of larger arrays qualify. Other strides (channel subsets, reversed
+ * axes) are gathered into scratch memory first. The result is written into
+ * `out` if given, which may be the input itself, or into a new buffer returned
+ * as a memoryview of the same shape.
+ *
+ * The GIL is released while the engines run, so loader threads blur in
+ * parallel. Each thread keeps a context with its summed-area table, float
+ * planes and scratch images, reused by its next call of the same size; it is
+ * released when the thread exits.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <limits.h>
+#include <pthread.h>
+#include <omp.h>
+
+#include "ppmFile.h"
+#include "sat.h"
+#include "boxBlur.h"
+#include "diskBlur.h"
+#include "planes.h"
+#include "sepConv.h"
+#include "conv2d.h"
+#include "memTrack.h"
+
+typedef enum { JOB_BOX, JOB_DISK, JOB_POLYGON, JOB_SEP, JOB_CONV } JobKind;
+
+typedef struct Job {
+    JobKind kind;
+    int R;
+    int bands;              // JOB_POLYGON.
+    SatLayout layout;       // JOB_BOX and JOB_POLYGON.
+    Kernel1D kx;            // JOB_SEP.
+    Kernel1D ky;
+    Kernel2D kernel;        // JOB_CONV.
+    ConvPlan plan;
+    int threads;            // 0 for the OpenMP default.
+} Job;
+
+/**
+ * Per-thread scratch, kept between calls.
+ */
+typedef struct Context {
+    Sat *sat;
+    float *planes[2];       // Two blocks of three planes each.
+    size_t planes_pixels;   // Capacity of each block.
+    Image *scratch[2];      // Gathered input and output.
+} Context;
+
+static pthread_key_t context_key;
+
+static void contextFree(void *p) {
+    Context *ctx = p;
+
+    if (ctx->sat) {
+        SatFree(ctx->sat);
+    }
+    MemFree(ctx->planes[0]);
+    MemFree(ctx->planes[1]);
+    for (int i = 0; i < 2; i++) {
+        if (ctx->scratch[i]) {
+            ImageFree(ctx->scratch[i]);
+        }
+    }
+    MemFree(ctx);
+}
+
+static Context *contextGet(void) {
+    Context *ctx = pthread_getspecific(context_key);
+
+    if (!ctx) {
+        ctx = MemCalloc(1, sizeof(Context));
+        if (!ctx) {
+            fprintf(stderr, "fastblur: cannot allocate memory for thread context\n");
+            exit(1);
+        }
+        pthread_setspecific(context_key, ctx);
+    }
+
+    return ctx;
+}
+
+// The table of the last call is reused when the size and layout match, which
+// is the common case of a loader producing fixed-size samples. The buffers
+// sized by the image return NULL or -1 when memory runs out, which the caller
+// raises as MemoryError rather than exiting the interpreter.
+static Sat *contextSat(Context *ctx, int W, int H, SatLayout layout) {
+    Sat *sat = ctx->sat;
+
+    if (!sat || sat->width != W || sat->height != H || sat->layout != layout) {
+        if (sat) {
+            SatFree(sat);
+        }
+        sat = ctx->sat = SatTryCreate(W, H, layout);
+    }
+
+    return sat;
+}
+
+// Planes only grow, so mixed sizes settle on the largest.
+static int contextPlanes(Context *ctx, int W, int H) {
+    const size_t n = (size_t)W * H;
+
+    if (n > ctx->planes_pixels) {
+        MemFree(ctx->planes[0]);
+        MemFree(ctx->planes[1]);
+        ctx->planes[0] = MemAlloc(sizeof(float) * 3 * n);
+        ctx->planes[1] = MemAlloc(sizeof(float) * 3 * n);
+        ctx->planes_pixels = n;
+
+        if (!ctx->planes[0] || !ctx->planes[1]) {
+            MemFree(ctx->planes[0]);
+            MemFree(ctx->planes[1]);
+            ctx->planes[0] = ctx->planes[1] = NULL;
+            ctx->planes_pixels = 0;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static Image *contextScratch(Context *ctx, int i, int W, int H) {
+    Image *img = ctx->scratch[i];
+
+    if (!img || img->width != W || img->height != H) {
+        if (img) {
+            ImageFree(img);
+        }
+        img = ctx->scratch[i] = ImageTryCreate(W, H);
+    }
+
+    return img;
+}
+
+/**
+ * Run the job on `in`, writing `out`. Called without the GIL. Returns 0 on
+ * success and -1 if memory ran out, here or in an engine's own scratch.
+ */
+static int run(Context *ctx, const Job *job, Image *in, Image *out) {
+    const int W = in->width;
+    const int H = in->height;
+
+    switch (job->kind) {
+    case JOB_BOX:
+    case JOB_POLYGON: {
+        Sat *sat = contextSat(ctx, W, H, job->layout);
+        if (!sat) {
+            return -1;
+        }
+        SatRowPass(sat, in);
+        SatColumnPass(sat);
+        if (job->kind == JOB_BOX) {
+            BoxBlur(out, sat, job->R);
+        } else if (PolygonTryBlur(out, sat, job->R, job->bands) < 0) {
+            return -1;
+        }
+        break;
+    }
+    case JOB_DISK: {
+        Sat *sat = contextSat(ctx, W, H, SAT_ROW_MAJOR);
+        if (!sat) {
+            return -1;
+        }
+        SatRowPass(sat, in);
+        if (DiskTryBlur(out, sat, job->R) < 0) {
+            return -1;
+        }
+        break;
+    }
+    case JOB_SEP: {
+        if (contextPlanes(ctx, W, H) < 0) {
+            return -1;
+        }
+        PlanesFromImage(ctx->planes[0], in);
+        for (int color = 0; color < 3; color++) {
+            float *plane = PlanesChannel(ctx->planes[0], W, H, color);
+            if (SepConvTryPlane(plane, plane, ctx->planes[1], W, H, &job->kx, &job->ky) < 0) {
+                return -1;
+            }
+        }
+        PlanesToImage(out, ctx->planes[0]);
+        break;
+    }
+    case JOB_CONV:
+        if (contextPlanes(ctx, W, H) < 0) {
+            return -1;
+        }
+        PlanesFromImage(ctx->planes[0], in);
+        if (Conv2DTryPlanes(ctx->planes[1], ctx->planes[0], W, H, &job->kernel, job->plan) < 0) {
+            return -1;
+        }
+        PlanesToImage(out, ctx->planes[1]);
+        break;
+    }
+
+    return 0;
+}
+
+/**
+ * Copy between a buffer with arbitrary strides and a packed image.
+ */
+static void gather(Image *img, const Py_buffer *view) {
+    const char *base = view->buf;
+    const Py_ssize_t *s = view->strides;
+
+    for (int y = 0; y < img->height; y++) {
+        for (int x = 0; x < img->width; x++) {
+            for (int c = 0; c < 3; c++) {
+                ImageSetPixel(img, x, y, c, base[y * s[0] + x * s[1] + c * s[2]]);
+            }
+        }
+    }
+}
+
+static void scatter(const Py_buffer *view, Image *img) {
+    char *base = view->buf;
+    const Py_ssize_t *s = view->strides;
+
+    for (int y = 0; y < img->height; y++) {
+        for (int x = 0; x < img->width; x++) {
+            for (int c = 0; c < 3; c++) {
+                base[y * s[0] + x * s[1] + c * s[2]] = ImageGetPixel(img, x, y, c);
+            }
+        }
+    }
+}
+
+/**
+ * Export `obj` as an image buffer and check its shape. Returns 0 on success
+ * and -1 with an exception set.
+ */
+static int getBuffer(PyObject *obj, Py_buffer *view, int writable, const char *name) {
+    if (PyObject_GetBuffer(obj, view, writable ? PyBUF_RECORDS : PyBUF_RECORDS_RO) < 0) {
+        return -1;
+    }
+
+    if (view->ndim != 3 || view->shape[2] != 3 || view->itemsize != 1
+        || (view->format && strcmp(view->format, "B") != 0)) {
+        PyErr_Format(PyExc_ValueError, "%s must be a (height, width, 3) uint8 buffer", name);
+    } else if (view->shape[0] < 1 || view->shape[1] < 1) {
+        PyErr_Format(PyExc_ValueError, "%s is empty", name);
+    } else if (view->shape[0] * view->shape[1] > INT_MAX / 3
+               || view->shape[0] * llabs(view->strides[0]) > INT_MAX) {
+        PyErr_Format(PyExc_ValueError, "%s is too large", name);
+    } else {
+        return 0;
+    }
+
+    PyBuffer_Release(view);
+    return -1;
+}
+
+// Rows of packed pixels can be read and written in place.
+static int packed(const Py_buffer *view) {
+    return view->strides[2] == 1 && view->strides[1] == 3
+        && view->strides[0] >= 3 * view->shape[1];
+}
+
+/**
+ * Common part of every binding: export the buffers, run the job without the
+ * GIL and return the output object.
+ */
+static PyObject *blur(const Job *job, PyObject *src, PyObject *out) {
+    Py_buffer in_view, out_view;
+    PyObject *result;
+    int status = -1;
+
+    if (getBuffer(src, &in_view, 0, "src") < 0) {
+        return NULL;
+    }
+
+    const int H = in_view.shape[0];
+    const int W = in_view.shape[1];
+
+    // Past these radii the result no longer changes: the box covers the
+    // image from every pixel, and so do the disk and every band of the
+    // polygon (whose bands can be half as tall as the disk). Clamping keeps
+    // the radius-sized tables small and the arithmetic in range.
+    Job clamped = *job;
+    const int limit = job->kind == JOB_BOX  ? (W > H ? W : H)
+                    : job->kind == JOB_DISK ? W + H
+                    :                         2 * (W + H);
+    if (clamped.R > limit) {
+        clamped.R = limit;
+    }
+    job = &clamped;
+
+    if (out == NULL || out == Py_None) {
+        PyObject *bytes = PyByteArray_FromStringAndSize(NULL, (Py_ssize_t)W * H * 3);
+        PyObject *flat = bytes ? PyMemoryView_FromObject(bytes) : NULL;
+
+        result = flat ? PyObject_CallMethod(flat, "cast", "s(iii)", "B", H, W, 3) : NULL;
+        Py_XDECREF(flat);
+        Py_XDECREF(bytes);
+    } else {
+        result = out;
+        Py_INCREF(result);
+    }
+    if (!result) {
+        PyBuffer_Release(&in_view);
+        return NULL;
+    }
+
+    if (getBuffer(result, &out_view, 1, "out") < 0) {
+        PyBuffer_Release(&in_view);
+        Py_DECREF(result);
+        return NULL;
+    }
+    if (out_view.shape[0] != H || out_view.shape[1] != W) {
+        PyErr_SetString(PyExc_ValueError, "out must have the same shape as src");
+        PyBuffer_Release(&in_view);
+        PyBuffer_Release(&out_view);
+        Py_DECREF(result);
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    Context *ctx = contextGet();
+    const int in_packed = packed(&in_view);
+    const int out_packed = packed(&out_view);
+    const int saved_threads = omp_get_max_threads();
+    Image in_img, out_img;
+    Image *img_in = &in_img;
+    Image *img_out = &out_img;
+
+    if (in_packed) {
+        in_img = ImageView(in_view.buf, W, H, in_view.strides[0]);
+    } else if ((img_in = contextScratch(ctx, 0, W, H))) {
+        gather(img_in, &in_view);
+    }
+    if (out_packed) {
+        out_img = ImageView(out_view.buf, W, H, out_view.strides[0]);
+    } else {
+        img_out = contextScratch(ctx, 1, W, H);
+    }
+
+    if (img_in && img_out) {
+        if (job->threads > 0) {
+            omp_set_num_threads(job->threads);
+        }
+        status = run(ctx, job, img_in, img_out);
+        omp_set_num_threads(saved_threads);
+    }
+
+    if (status == 0 && !out_packed) {
+        scatter(&out_view, img_out);
+    }
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&in_view);
+    PyBuffer_Release(&out_view);
+
+    if (status < 0) {
+        Py_DECREF(result);
+        return PyErr_NoMemory();
+    }
+
+    return result;
+}
+
+static int parseLayout(const char *name, SatLayout *layout) {
+    *layout = SatLayoutFromName(name);
+    if (*layout == SAT_LAYOUT_INVALID) {
+        PyErr_SetString(PyExc_ValueError, "layout must be 'rows', 'tiled' or 'interleaved'");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Read a sequence of numbers into `n` taps normalized to sum to 1, unless
+ * they sum to 0. Returns the taps (MemFree them) or NULL with an exception set.
+ */
+static float *readTaps(PyObject *seq, Py_ssize_t *n) {
+    PyObject *fast = PySequence_Fast(seq, "taps must be a sequence of numbers");
+    float *taps;
+    double sum = 0.0;
+
+    if (!fast) {
+        return NULL;
+    }
+
+    *n = PySequence_Fast_GET_SIZE(fast);
+    taps = MemAlloc(sizeof(float) * (*n > 0 ? *n : 1));
+    if (!taps) {
+        Py_DECREF(fast);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    for (Py_ssize_t i = 0; i < *n; i++) {
+        double v = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(fast, i));
+
+        if (v == -1.0 && PyErr_Occurred()) {
+            MemFree(taps);
+            Py_DECREF(fast);
+            return NULL;
+        }
+        taps[i] = v;
+        sum += v;
+    }
+    Py_DECREF(fast);
+
+    if (sum != 0.0) {
+        for (Py_ssize_t i = 0; i < *n; i++) {
+            taps[i] /= sum;
+        }
+    }
+
+    return taps;
+}
+
+static int readKernel1D(PyObject *seq, Kernel1D *kernel) {
+    Py_ssize_t n;
+
+    kernel->taps = readTaps(seq, &n);
+    if (!kernel->taps) {
+        return -1;
+    }
+    if (n % 2 == 0) {
+        PyErr_SetString(PyExc_ValueError, "kernels must have an odd number of taps");
+        MemFree(kernel->taps);
+        return -1;
+    }
+    kernel->radius = n / 2;
+
+    return 0;
+}
+
+static PyObject *fastblur_box(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = { "src", "radius", "out", "layout", "threads", NULL };
+    PyObject *src, *out = NULL;
+    const char *layout = "rows";
+    Job job = { .kind = JOB_BOX };
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oi|O$si", keywords,
+                                     &src, &job.R, &out, &layout, &job.threads)
+        || parseLayout(layout, &job.layout) < 0) {
+        return NULL;
+    }
+    if (job.R < 0) {
+        PyErr_SetString(PyExc_ValueError, "radius must be non-negative");
+        return NULL;
+    }
+
+    return blur(&job, src, out);
+}
+
+static PyObject *fastblur_disk(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = { "src", "radius", "out", "threads", NULL };
+    PyObject *src, *out = NULL;
+    Job job = { .kind = JOB_DISK };
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oi|O$i", keywords,
+                                     &src, &job.R, &out, &job.threads)) {
+        return NULL;
+    }
+    if (job.R < 0) {
+        PyErr_SetString(PyExc_ValueError, "radius must be non-negative");
+        return NULL;
+    }
+
+    return blur(&job, src, out);
+}
+
+static PyObject *fastblur_polygon(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = { "src", "radius", "bands", "out", "layout", "threads", NULL };
+    PyObject *src, *out = NULL;
+    const char *layout = "rows";
+    Job job = { .kind = JOB_POLYGON };
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oii|O$si", keywords,
+                                     &src, &job.R, &job.bands, &out, &layout, &job.threads)
+        || parseLayout(layout, &job.layout) < 0) {
+        return NULL;
+    }
+    if (job.R < 0 || job.bands < 1) {
+        PyErr_SetString(PyExc_ValueError, "radius must be non-negative and bands positive");
+        return NULL;
+    }
+
+    return blur(&job, src, out);
+}
+
+static PyObject *fastblur_sep(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = { "src", "taps_x", "taps_y", "out", "threads", NULL };
+    PyObject *src, *taps_x, *taps_y, *out = NULL, *result;
+    Job job = { .kind = JOB_SEP };
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOO|O$i", keywords,
+                                     &src, &taps_x, &taps_y, &out, &job.threads)) {
+        return NULL;
+    }
+    if (readKernel1D(taps_x, &job.kx) < 0) {
+        return NULL;
+    }
+    if (readKernel1D(taps_y, &job.ky) < 0) {
+        KernelFree(&job.kx);
+        return NULL;
+    }
+
+    result = blur(&job, src, out);
+
+    KernelFree(&job.kx);
+    KernelFree(&job.ky);
+
+    return result;
+}
+
+static PyObject *fastblur_conv(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = { "src", "kernel", "out", "engine", "threads", NULL };
+    PyObject *src, *rows, *out = NULL, *result = NULL;
+    const char *engine = "auto";
+    Job job = { .kind = JOB_CONV };
+    ConvEngine forced;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|O$si", keywords,
+                                     &src, &rows, &out, &engine, &job.threads)) {
+        return NULL;
+    }
+    forced = ConvEngineFromName(engine);
+    if (forced == CONV_ENGINE_INVALID) {
+        PyErr_SetString(PyExc_ValueError, "engine must be 'auto', 'direct' or 'fft'");
+        return NULL;
+    }
+
+    // Flatten the rows, then normalize the whole kernel at once.
+    PyObject *flat = PyList_New(0);
+    Py_ssize_t height = PySequence_Size(rows);
+    Py_ssize_t width = -1, n;
+
+    for (Py_ssize_t i = 0; flat && i < height; i++) {
+        PyObject *row = PySequence_GetItem(rows, i);
+        Py_ssize_t len = row ? PySequence_Size(row) : -1;
+        PyObject *tail = len >= 0 ? PySequence_List(row) : NULL;
+
+        if (tail && (width < 0 || len == width)) {
+            width = len;
+            Py_SETREF(flat, PySequence_InPlaceConcat(flat, tail));
+        } else {
+            if (tail) {
+                PyErr_SetString(PyExc_ValueError, "kernel rows must have the same length");
+            }
+            Py_CLEAR(flat);
+        }
+        Py_XDECREF(tail);
+        Py_XDECREF(row);
+    }
+    if (!flat || height < 0) {
+        Py_XDECREF(flat);
+        if (!PyErr_Occurred()) {
+            PyErr_SetString(PyExc_TypeError, "kernel must be a sequence of rows");
+        }
+        return NULL;
+    }
+    if (height % 2 == 0 || width % 2 == 0 || width > 1024 || height > 1024) {
+        PyErr_SetString(PyExc_ValueError, "kernel sides must be odd and at most 1024");
+        Py_DECREF(flat);
+        return NULL;
+    }
+
+    job.kernel.width = width;
+    job.kernel.height = height;
+    job.kernel.taps = readTaps(flat, &n);
+    Py_DECREF(flat);
+    if (job.kernel.taps) {
+        job.plan = ConvPlanCreate(&job.kernel, forced);
+        result = blur(&job, src, out);
+        Kernel2DFree(&job.kernel);
+    }
+
+    return result;
+}
+
+static PyMethodDef fastblur_methods[] = {
+    { "box", (PyCFunction)(void (*)(void))fastblur_box, METH_VARARGS | METH_KEYWORDS,
+      "box(src, radius, out=None, *, layout='rows', threads=0)\n\n"
+      "Mean over the (2R + 1)^2 square around each pixel, shrunk at the borders." },
+    { "disk", (PyCFunction)(void (*)(void))fastblur_disk, METH_VARARGS | METH_KEYWORDS,
+      "disk(src, radius, out=None, *, threads=0)\n\n"
+      "Mean over the disk of the given radius around each pixel." },
+    { "polygon", (PyCFunction)(void (*)(void))fastblur_polygon, METH_VARARGS | METH_KEYWORDS,
+      "polygon(src, radius, bands, out=None, *, layout='rows', threads=0)\n\n"
+      "Mean over the disk approximated by `bands` stacked rectangles." },
+    { "sep", (PyCFunction)(void (*)(void))fastblur_sep, METH_VARARGS | METH_KEYWORDS,
+      "sep(src, taps_x, taps_y, out=None, *, threads=0)\n\n"
+      "Convolve rows with taps_x and columns with taps_y (odd lengths)." },
+    { "conv", (PyCFunction)(void (*)(void))fastblur_conv, METH_VARARGS | METH_KEYWORDS,
+      "conv(src, kernel, out=None, *, engine='auto', threads=0)\n\n"
+      "Convolve with a 2D kernel given as rows of taps (odd sides)." },
+    { NULL, NULL, 0, NULL }
+};
+
+static struct PyModuleDef fastblur_module = {
+    PyModuleDef_HEAD_INIT,
+    "fastblur",
+    "Blur engines over (height, width, 3) uint8 buffers, without copies.\n\n"
+    "Kernels are normalized to sum to 1 unless they sum to 0. `out` may be the\n"
+    "input. `threads` caps the OpenMP threads of one call; 0 keeps the default.",
+    -1,
+    fastblur_methods
+};
+
+PyMODINIT_FUNC PyInit_fastblur(void) {
+    static int key_created;
+
+    if (!key_created) {
+        if (pthread_key_create(&context_key, contextFree) != 0) {
+            PyErr_SetString(PyExc_RuntimeError, "cannot create thread context key");
+            return NULL;
+        }
+        key_created = 1;
+    }
+
+    return PyModule_Create(&fastblur_module);
+}
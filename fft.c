@@ -0,0 +1,223 @@
+/**
+ * Complex FFT, see fft.h.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "fft.h"
+#include "memTrack.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+FftPlan *FftPlanTryCreate(int n) {
+    int log2n = 0;
+
+    while ((1 << log2n) < n) {
+        log2n++;
+    }
+    if ((1 << log2n) != n) {
+        fprintf(stderr, "fft: size %d is not a power of two\n", n);
+        exit(1);
+    }
+
+    FftPlan *plan = MemCalloc(1, sizeof(FftPlan));
+
+    if (!plan) {
+        return NULL;
+    }
+
+    plan->n = n;
+    plan->log2n = log2n;
+    plan->cos_w = MemAlloc(sizeof(float) * n);
+    plan->sin_w = MemAlloc(sizeof(float) * n);
+    plan->rev = MemAlloc(sizeof(int) * n);
+
+    if (!plan->cos_w || !plan->sin_w || !plan->rev) {
+        FftPlanFree(plan);
+        return NULL;
+    }
+
+    for (int k = 0; k < n; k++) {
+        double a = 2.0 * M_PI * k / n;
+        plan->cos_w[k] = cos(a);
+        plan->sin_w[k] = sin(a);
+    }
+    for (int i = 0; i < n; i++) {
+        int r = 0;
+        for (int b = 0; b < plan->log2n; b++) {
+            r |= ((i >> b) & 1) << (plan->log2n - 1 - b);
+        }
+        plan->rev[i] = r;
+    }
+
+    return plan;
+}
+
+FftPlan *FftPlanCreate(int n) {
+    FftPlan *plan = FftPlanTryCreate(n);
+
+    if (!plan) {
+        fprintf(stderr, "fft: cannot allocate memory for a plan of size %d\n", n);
+        exit(1);
+    }
+
+    return plan;
+}
+
+void FftPlanFree(FftPlan *plan) {
+    MemFree(plan->cos_w);
+    MemFree(plan->sin_w);
+    MemFree(plan->rev);
+    MemFree(plan);
+}
+
+static void swapRows(float *x, int i, int j, int m) {
+    float *a = x + (size_t)i * m;
+    float *b = x + (size_t)j * m;
+
+    for (int k = 0; k < m; k++) {
+        float t = a[k];
+        a[k] = b[k];
+        b[k] = t;
+    }
+}
+
+// One radix-4 butterfly on m interleaved transforms; the inputs a0..a3
+// come from rows 0..3, w1..w3 are the twiddles with the sign applied.
+static void butterfly4(float *restrict r0, float *restrict i0,
+                       float *restrict r1, float *restrict i1,
+                       float *restrict r2, float *restrict i2,
+                       float *restrict r3, float *restrict i3, int m,
+                       float w1r, float w1i, float w2r, float w2i,
+                       float w3r, float w3i, float sign) {
+    for (int k = 0; k < m; k++) {
+        float a0r = r0[k], a0i = i0[k];
+        float a1r = r1[k], a1i = i1[k];
+        float a2r = r2[k], a2i = i2[k];
+        float a3r = r3[k], a3i = i3[k];
+
+        float p1r = w2r * a1r - w2i * a1i;
+        float p1i = w2r * a1i + w2i * a1r;
+        float p2r = w1r * a2r - w1i * a2i;
+        float p2i = w1r * a2i + w1i * a2r;
+        float p3r = w3r * a3r - w3i * a3i;
+        float p3i = w3r * a3i + w3i * a3r;
+
+        float sr = a0r + p1r, si = a0i + p1i;
+        float dr = a0r - p1r, di = a0i - p1i;
+        float ur = p2r + p3r, ui = p2i + p3i;
+        float vr = sign * (p2r - p3r), vi = sign * (p2i - p3i);
+
+        r0[k] = sr + ur;
+        i0[k] = si + ui;
+        r2[k] = sr - ur;
+        i2[k] = si - ui;
+        r1[k] = dr - vi;
+        i1[k] = di + vr;
+        r3[k] = dr + vi;
+        i3[k] = di - vr;
+    }
+}
+
+void FftBatch(const FftPlan *plan, float *re, float *im, int m, int inverse) {
+    const int n = plan->n;
+    const float sign = inverse ? 1.0f : -1.0f;
+
+    for (int i = 0; i < n; i++) {
+        int j = plan->rev[i];
+        if (i < j) {
+            swapRows(re, i, j, m);
+            swapRows(im, i, j, m);
+        }
+    }
+
+    // With an odd number of stages the first is radix-2, whose twiddles
+    // are all 1.
+    int len = 1;
+    if (plan->log2n % 2) {
+        for (int i = 0; i < n; i += 2) {
+            float *restrict ar = re + (size_t)i * m;
+            float *restrict ai = im + (size_t)i * m;
+            float *restrict br = re + (size_t)(i + 1) * m;
+            float *restrict bi = im + (size_t)(i + 1) * m;
+
+            for (int k = 0; k < m; k++) {
+                float tr = br[k];
+                float ti = bi[k];
+                br[k] = ar[k] - tr;
+                bi[k] = ai[k] - ti;
+                ar[k] += tr;
+                ai[k] += ti;
+            }
+        }
+        len = 2;
+    }
+
+    // Each radix-4 pass merges the transforms of size `len` four at a time,
+    // doing the two radix-2 stages of sizes 2 len and 4 len at once. With w
+    // the twiddle of offset j, the inputs a0..a3 at j, j + len, j + 2 len
+    // and j + 3 len become
+    //
+    //     c0, c2 = (a0 + w^2 a1) +- (w a2 + w^3 a3)
+    //     c1, c3 = (a0 - w^2 a1) +- i sign (w a2 - w^3 a3)
+    //
+    // which is three complex multiplications instead of four, and one sweep
+    // over the data instead of two.
+    for (; 4 * len <= n; len *= 4) {
+        const int step = n / (4 * len);
+
+        for (int i = 0; i < n; i += 4 * len) {
+            for (int j = 0; j < len; j++) {
+                const float w1r = plan->cos_w[j * step];
+                const float w1i = sign * plan->sin_w[j * step];
+                const float w2r = plan->cos_w[2 * j * step];
+                const float w2i = sign * plan->sin_w[2 * j * step];
+                const float w3r = plan->cos_w[3 * j * step];
+                const float w3i = sign * plan->sin_w[3 * j * step];
+                butterfly4(re + (size_t)(i + j) * m, im + (size_t)(i + j) * m,
+                           re + (size_t)(i + j + len) * m, im + (size_t)(i + j + len) * m,
+                           re + (size_t)(i + j + 2 * len) * m, im + (size_t)(i + j + 2 * len) * m,
+                           re + (size_t)(i + j + 3 * len) * m, im + (size_t)(i + j + 3 * len) * m,
+                           m, w1r, w1i, w2r, w2i, w3r, w3i, sign);
+            }
+        }
+    }
+}
+
+// Blocked transpose of an n x n array through `tmp`.
+static void transpose(float *x, float *tmp, int n) {
+    const int B = 32;
+
+    for (int r0 = 0; r0 < n; r0 += B) {
+        for (int c0 = 0; c0 < n; c0 += B) {
+            for (int r = r0; r < r0 + B && r < n; r++) {
+                for (int c = c0; c < c0 + B && c < n; c++) {
+                    tmp[(size_t)c * n + r] = x[(size_t)r * n + c];
+                }
+            }
+        }
+    }
+    memcpy(x, tmp, sizeof(float) * n * n);
+}
+
+void Fft2D(const FftPlan *plan, float *re, float *im, float *tmp, int inverse) {
+    const int n = plan->n;
+
+    FftBatch(plan, re, im, n, inverse);
+    transpose(re, tmp, n);
+    transpose(im, tmp, n);
+    FftBatch(plan, re, im, n, inverse);
+
+    if (inverse) {
+        const float scale = 1.0f / ((float)n * n);
+        for (int i = 0; i < n * n; i++) {
+            re[i] *= scale;
+            im[i] *= scale;
+        }
+    }
+}
@@ -0,0 +1,40 @@
+/**
+ * Dependency-free complex FFT on split (real, imaginary) float arrays.
+ *
+ * Transforms are mixed radix-2/4 decimation-in-time: after bit reversal,
+ * pairs of radix-2 stages run as one radix-4 pass, preceded by a single
+ * radix-2 stage when log2(n) is odd. They operate on a batch of `m`
+ * interleaved signals at once: element `i` of signal `k` lives at
+ * `i * m + k`. Every butterfly is then a loop over `m` consecutive floats,
+ * which the compiler vectorizes. A 2D transform uses this for the columns of
+ * the array, transposes it and does it again, so no scalar row transforms are
+ * needed.
+ */
+
+#ifndef FFT_H
+#define FFT_H
+
+typedef struct FftPlan {
+    int n;          // Transform size, a power of two.
+    int log2n;
+    float *cos_w;   // Twiddles cos(2 pi k / n) and sin(2 pi k / n), k < n.
+    float *sin_w;
+    int *rev;       // Bit-reversal permutation.
+} FftPlan;
+
+FftPlan *FftPlanCreate(int n);
+// Same as FftPlanCreate(), but returns NULL if memory runs out.
+FftPlan *FftPlanTryCreate(int n);
+void FftPlanFree(FftPlan *plan);
+
+// In-place transform of `m` interleaved signals of length `plan->n`. The
+// inverse transform is not scaled.
+void FftBatch(const FftPlan *plan, float *re, float *im, int m, int inverse);
+
+// In-place transform of an n x n array. The forward transform leaves the
+// spectrum transposed; the inverse transform expects a transposed spectrum
+// and returns the array in its original orientation, scaled by 1 / n^2.
+// `tmp` must hold n * n floats.
+void Fft2D(const FftPlan *plan, float *re, float *im, float *tmp, int inverse);
+
+#endif
@@ -0,0 +1,159 @@
+/**
+ * Integral histograms, see histogram.h.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <omp.h>
+
+#include "histogram.h"
+#include "memTrack.h"
+
+#define min(X, Y) (((X) < (Y)) ? (X) : (Y))
+#define max(X, Y) (((X) < (Y)) ? (Y) : (X))
+
+static inline int binOf(const Hist *hist, int value) {
+    return value * hist->bins >> 8;
+}
+
+// Prefix counts at grid point (gy, gx).
+static inline uint32_t *entry(const Hist *hist, int gy, int gx) {
+    return hist->counts + ((size_t)gy * hist->points_x + gx) * hist->bins;
+}
+
+// Add the pixels of [x0, x1) x [y0, y1) to `counts`.
+static void countBlock(const Hist *hist, int x0, int y0, int x1, int y1, uint32_t *counts) {
+    for (int y = y0; y < y1; y++) {
+        const unsigned char *p = hist->values + (size_t)y * hist->stride;
+
+        for (int x = x0; x < x1; x++) {
+            counts[binOf(hist, p[x])]++;
+        }
+    }
+}
+
+Hist *HistCreate(const unsigned char *values, int width, int height, int stride,
+                 int bins, int cell) {
+    Hist *hist = MemAlloc(sizeof(Hist));
+
+    hist->width = width;
+    hist->height = height;
+    hist->bins = bins;
+    hist->cell = cell;
+    hist->points_x = (width + cell - 1) / cell + 1;
+    hist->points_y = (height + cell - 1) / cell + 1;
+    hist->stride = stride;
+    hist->values = values;
+    hist->counts = MemCalloc((size_t)hist->points_x * hist->points_y * bins, sizeof(uint32_t));
+
+    if (!hist->counts) {
+        fprintf(stderr, "histogram: cannot allocate memory for integral histogram\n");
+        exit(1);
+    }
+
+    // Row pass: each point holds the histogram of the blocks of its row of
+    // blocks left of it. The first row and column stay zero.
+    #pragma omp parallel for schedule(static, 1)
+    for (int gy = 1; gy < hist->points_y; gy++) {
+        const int y0 = (gy - 1) * cell;
+        const int y1 = min(gy * cell, height);
+
+        for (int gx = 1; gx < hist->points_x; gx++) {
+            uint32_t *dst = entry(hist, gy, gx);
+
+            memcpy(dst, dst - bins, sizeof(uint32_t) * bins);
+            countBlock(hist, (gx - 1) * cell, y0, min(gx * cell, width), y1, dst);
+        }
+    }
+
+    // Column pass: one strip of counts per thread, walked down the rows of
+    // points.
+    #pragma omp parallel
+    {
+        const size_t n = (size_t)hist->points_x * bins;
+        const int T = omp_get_num_threads();
+        const int t = omp_get_thread_num();
+        const size_t c0 = n * t / T;
+        const size_t c1 = n * (t + 1) / T;
+
+        for (int gy = 2; gy < hist->points_y; gy++) {
+            uint32_t *restrict dst = entry(hist, gy, 0);
+            const uint32_t *restrict src = dst - n;
+
+            for (size_t c = c0; c < c1; c++) {
+                dst[c] += src[c];
+            }
+        }
+    }
+
+    return hist;
+}
+
+void HistFree(Hist *hist) {
+    MemFree(hist->counts);
+    MemFree(hist);
+}
+
+int HistQuery(const Hist *hist, int x0, int y0, int x1, int y1, uint32_t *counts) {
+    const int W = hist->width;
+    const int H = hist->height;
+    const int cell = hist->cell;
+    const int bins = hist->bins;
+
+    x0 = max(x0, 0);
+    y0 = max(y0, 0);
+    x1 = min(x1, W - 1);
+    y1 = min(y1, H - 1);
+    memset(counts, 0, sizeof(uint32_t) * bins);
+    if (x0 > x1 || y0 > y1) {
+        return 0;
+    }
+
+    // Grid points inside the rectangle: the first at or after its start, the
+    // last at or before its end. The last point of a row or column is on the
+    // plane's edge, whatever the cell size.
+    const int gx0 = (x0 + cell - 1) / cell;
+    const int gy0 = (y0 + cell - 1) / cell;
+    const int gx1 = x1 + 1 == W ? hist->points_x - 1 : (x1 + 1) / cell;
+    const int gy1 = y1 + 1 == H ? hist->points_y - 1 : (y1 + 1) / cell;
+
+    if (gx0 >= gx1 || gy0 >= gy1) {
+        countBlock(hist, x0, y0, x1 + 1, y1 + 1, counts);
+        return (x1 - x0 + 1) * (y1 - y0 + 1);
+    }
+
+    const uint32_t *a = entry(hist, gy0, gx0);
+    const uint32_t *b = entry(hist, gy0, gx1);
+    const uint32_t *c = entry(hist, gy1, gx0);
+    const uint32_t *d = entry(hist, gy1, gx1);
+
+    for (int i = 0; i < bins; i++) {
+        counts[i] = d[i] - (b[i] + c[i] - a[i]);
+    }
+
+    // The border strips around the aligned part: above, below, left and right.
+    const int X0 = gx0 * cell;
+    const int Y0 = gy0 * cell;
+    const int X1 = min(gx1 * cell, W);
+    const int Y1 = min(gy1 * cell, H);
+
+    countBlock(hist, x0, y0, x1 + 1, Y0, counts);
+    countBlock(hist, x0, Y1, x1 + 1, y1 + 1, counts);
+    countBlock(hist, x0, Y0, X0, Y1, counts);
+    countBlock(hist, X1, Y0, x1 + 1, Y1, counts);
+
+    return (x1 - x0 + 1) * (y1 - y0 + 1);
+}
+
+int HistRank(const uint32_t *counts, int bins, int rank) {
+    uint32_t seen = 0;
+
+    for (int i = 0; i < bins; i++) {
+        seen += counts[i];
+        if (seen >= (uint32_t)rank) {
+            return i;
+        }
+    }
+    return bins - 1;
+}
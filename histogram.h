@@ -0,0 +1,49 @@
+/**
+ * Integral histograms of 8-bit planes.
+ *
+ * An integral histogram is a summed-area table of per-bin counts: entry
+ * (y, x) holds the histogram of the rectangle from (0, 0) to (y, x), and the
+ * histogram of any rectangle is d - (b + c - a) over its four corners, bin by
+ * bin. A table at every pixel would take bins x W x H counts, so the counts
+ * are kept only on a grid of `cell` x `cell` blocks. A query takes the part of
+ * its rectangle that is aligned to the grid from the table and counts the
+ * pixels of the remaining border strips, less than a cell wide, directly.
+ *
+ * The table is built like a summed-area table, in a row pass over the rows of
+ * blocks followed by a column pass, both in parallel. The bins of a grid point
+ * are contiguous, so the corner arithmetic runs over consecutive counts.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+typedef struct Hist {
+    int width;
+    int height;
+    int bins;           // Value v falls into bin v * bins / 256.
+    int cell;           // Spacing of the grid points in pixels.
+    int points_x;       // Grid points per row and column, including both edges.
+    int points_y;
+    int stride;         // Bytes between rows of `values`.
+    const unsigned char *values;
+    uint32_t *counts;   // points_y x points_x x bins prefix counts.
+} Hist;
+
+// Build the table of the width x height plane `values`, whose rows are
+// `stride` bytes apart. The plane is referenced, not copied, and must outlive
+// the table. `bins` is at most 256.
+Hist *HistCreate(const unsigned char *values, int width, int height, int stride,
+                 int bins, int cell);
+void HistFree(Hist *hist);
+
+// Histogram of the inclusive rectangle [x0, x1] x [y0, y1], clamped to the
+// plane, into `counts` (`hist->bins` entries). Returns the pixel count.
+int HistQuery(const Hist *hist, int x0, int y0, int x1, int y1, uint32_t *counts);
+
+// Smallest bin whose cumulative count reaches `rank` (1 for the minimum,
+// `pixels` for the maximum).
+int HistRank(const uint32_t *counts, int bins, int rank);
+
+#endif
@@ -0,0 +1,214 @@
+/**
+ * Completion journal, see journal.h.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "journal.h"
+#include "memTrack.h"
+
+#define JOURNAL_MAGIC 0x6a746266u   // "fbtj"
+#define JOURNAL_VERSION 1
+
+typedef struct JournalHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t tiles;
+    uint32_t key_bytes;     // The key follows the header.
+} JournalHeader;
+
+typedef struct JournalRecord {
+    uint32_t tile;
+    uint32_t check;
+} JournalRecord;
+
+struct Journal {
+    char *path;
+    int fd;
+    off_t end;              // Where the next record goes.
+};
+
+static uint32_t checkWord(uint32_t tile) {
+    return (tile * 0x9e3779b1u) ^ JOURNAL_MAGIC;
+}
+
+static void fail(const char *path, const char *message) {
+    fprintf(stderr, "journal: %s: %s\n", path, message);
+    exit(1);
+}
+
+static void writeAll(int fd, const void *data, size_t bytes, off_t offset, const char *path) {
+    for (size_t done = 0; done < bytes;) {
+        ssize_t n = pwrite(fd, (const char *)data + done, bytes - done, offset + done);
+
+        if (n <= 0) {
+            fail(path, "cannot write");
+        }
+        done += n;
+    }
+}
+
+// Sync the directory holding `path`, so that files created or removed in it
+// survive a crash.
+static void syncDirectory(const char *path) {
+    const char *slash = strrchr(path, '/');
+    char dir[4096];
+    int fd;
+
+    if (!slash) {
+        strcpy(dir, ".");
+    } else if (slash == path) {
+        strcpy(dir, "/");
+    } else if ((size_t)(slash - path) < sizeof(dir)) {
+        memcpy(dir, path, slash - path);
+        dir[slash - path] = '\0';
+    } else {
+        fail(path, "path too long");
+    }
+
+    fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd < 0 || fsync(fd) != 0) {
+        fail(dir, "cannot sync directory");
+    }
+    close(fd);
+}
+
+// The header of a job's journal: JournalHeader and the key.
+static unsigned char *header(const void *key, size_t key_bytes, int tiles, size_t *bytes) {
+    JournalHeader h = { JOURNAL_MAGIC, JOURNAL_VERSION, tiles, key_bytes };
+    unsigned char *p = MemAlloc(sizeof(h) + key_bytes);
+
+    if (!p) {
+        fprintf(stderr, "journal: cannot allocate memory\n");
+        exit(1);
+    }
+    memcpy(p, &h, sizeof(h));
+    memcpy(p + sizeof(h), key, key_bytes);
+    *bytes = sizeof(h) + key_bytes;
+    return p;
+}
+
+static Journal *journalAt(const char *path, int fd, off_t end) {
+    Journal *journal = MemAlloc(sizeof(Journal));
+
+    if (!journal || !(journal->path = strdup(path))) {
+        fail(path, "cannot allocate memory");
+    }
+    journal->fd = fd;
+    journal->end = end;
+    return journal;
+}
+
+Journal *JournalOpen(const char *path, const void *key, size_t key_bytes, int tiles,
+                     unsigned char *done, int *recorded) {
+    size_t bytes;
+    unsigned char *expected = header(key, key_bytes, tiles, &bytes);
+    unsigned char *found = MemAlloc(bytes);
+    int fd = open(path, O_RDWR);
+    JournalRecord record;
+    off_t end = bytes;
+
+    memset(done, 0, tiles);
+    *recorded = 0;
+
+    if (!found) {
+        fail(path, "cannot allocate memory");
+    }
+    if (fd < 0 || pread(fd, found, bytes, 0) != (ssize_t)bytes || memcmp(found, expected, bytes) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        MemFree(expected);
+        MemFree(found);
+        return NULL;
+    }
+    MemFree(expected);
+    MemFree(found);
+
+    while (pread(fd, &record, sizeof(record), end) == sizeof(record)
+           && record.tile < (uint32_t)tiles && record.check == checkWord(record.tile)) {
+        *recorded += !done[record.tile];
+        done[record.tile] = 1;
+        end += sizeof(record);
+    }
+
+    // Drop a torn record so that new records follow the valid ones.
+    if (ftruncate(fd, end) != 0) {
+        fail(path, "cannot truncate");
+    }
+
+    return journalAt(path, fd, end);
+}
+
+Journal *JournalCreate(const char *path, const void *key, size_t key_bytes, int tiles) {
+    size_t bytes;
+    unsigned char *h = header(key, key_bytes, tiles, &bytes);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0) {
+        fail(path, "cannot create");
+    }
+    writeAll(fd, h, bytes, 0, path);
+    if (fdatasync(fd) != 0) {
+        fail(path, "cannot sync");
+    }
+    syncDirectory(path);
+
+    MemFree(h);
+    return journalAt(path, fd, bytes);
+}
+
+void JournalCommit(Journal *journal, const int *tiles, int n) {
+    if (n == 0) {
+        return;
+    }
+
+    JournalRecord *records = MemAlloc(sizeof(JournalRecord) * n);
+
+    if (!records) {
+        fail(journal->path, "cannot allocate memory");
+    }
+
+    for (int i = 0; i < n; i++) {
+        records[i].tile = tiles[i];
+        records[i].check = checkWord(tiles[i]);
+    }
+    writeAll(journal->fd, records, sizeof(JournalRecord) * n, journal->end, journal->path);
+    if (fdatasync(journal->fd) != 0) {
+        fail(journal->path, "cannot sync");
+    }
+    journal->end += sizeof(JournalRecord) * n;
+
+    MemFree(records);
+}
+
+void JournalClose(Journal *journal) {
+    close(journal->fd);
+    free(journal->path);
+    MemFree(journal);
+}
+
+void JournalFinish(Journal *journal) {
+    close(journal->fd);
+    if (unlink(journal->path) != 0) {
+        fail(journal->path, "cannot remove");
+    }
+    syncDirectory(journal->path);
+
+    free(journal->path);
+    MemFree(journal);
+}
+
+void JournalRemove(const char *path) {
+    if (unlink(path) == 0) {
+        syncDirectory(path);
+    }
+}
@@ -0,0 +1,55 @@
+/**
+ * Crash-safe completion journal for restartable tiled jobs.
+ *
+ * A long job writing an output tile by tile records each finished tile in a
+ * small journal file next to the output. After a crash or preemption a rerun
+ * reads the journal, skips the recorded tiles and redoes the rest; once every
+ * tile is done the journal is removed, which marks the output complete.
+ *
+ * The journal starts with a header identifying the job: the caller's key, e.g.
+ * the input's identity, the parameters and an id of the output file itself.
+ * A journal whose header does not match is discarded and the job starts
+ * over. After the header come 8-byte records, a tile number and a check word,
+ * appended only. A record torn by a crash fails its check and ends the journal
+ * there.
+ *
+ * Ordering makes it crash-safe. The caller makes a batch of tiles durable in
+ * the output (fdatasync) before JournalCommit() appends their records and
+ * syncs the journal, so a recorded tile is always in the output. Tiles done
+ * but not yet recorded are simply redone. Committing in batches keeps the cost
+ * to two syncs per batch.
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+
+typedef struct Journal Journal;
+
+// Open an existing journal at `path` for a job of `tiles` tiles identified by
+// `key`, mark its recorded tiles in `done` and set `*recorded` to their count.
+// Returns NULL, with `done` cleared, if there is no journal or it belongs to
+// another job.
+Journal *JournalOpen(const char *path, const void *key, size_t key_bytes, int tiles,
+                     unsigned char *done, int *recorded);
+
+// Start a new journal at `path`, replacing any other. Syncs the directory
+// too, which makes an output just created in the same directory durable
+// along with it. Exits if the journal cannot be created.
+Journal *JournalCreate(const char *path, const void *key, size_t key_bytes, int tiles);
+
+// Durably record `n` tiles as done; the tiles must already be durable in the
+// output.
+void JournalCommit(Journal *journal, const int *tiles, int n);
+
+// Close the journal and leave it for a later run.
+void JournalClose(Journal *journal);
+
+// Remove the journal once the output is complete, and close it.
+void JournalFinish(Journal *journal);
+
+// Remove the journal at `path`, if any, durably.
+void JournalRemove(const char *path);
+
+#endif
@@ -0,0 +1,172 @@
+/**
+ * Box blur of 1-bit masks, see maskBlur.h.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <omp.h>
+
+#include "maskBlur.h"
+#include "memTrack.h"
+
+#define min(X, Y) (((X) < (Y)) ? (X) : (Y))
+#define max(X, Y) (((X) < (Y)) ? (Y) : (X))
+
+typedef struct Scratch {
+    uint64_t *words;    // A row's bits, pixel x at bit 63 - x % 64 of word x / 64.
+    uint32_t *prefix;   // Set bits before each word.
+    uint16_t *counts;   // Horizontal window sums of a row.
+} Scratch;
+
+// Word `w` of a row with the first pixel in its most significant bit.
+static inline uint64_t loadWord(const unsigned char *bits, int w) {
+    uint64_t v;
+
+    memcpy(&v, bits + 8 * (size_t)w, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+// Set bits in columns [0, x] of the row; 0 for x < 0.
+static inline int countTo(const Scratch *s, int x) {
+    if (x < 0) {
+        return 0;
+    }
+    return s->prefix[x >> 6] + __builtin_popcountll(s->words[x >> 6] >> (63 - (x & 63)));
+}
+
+/**
+ * Horizontal window sums of row `row` into s->counts.
+ */
+static void rowCounts(const Bitmap *mask, int row, int R, Scratch *s) {
+    const int W = mask->width;
+    const int words = mask->stride / 8;
+    const unsigned char *bits = mask->bits + (size_t)row * mask->stride;
+    uint32_t seen = 0;
+
+    for (int w = 0; w < words; w++) {
+        s->words[w] = loadWord(bits, w);
+        s->prefix[w] = seen;
+        seen += __builtin_popcountll(s->words[w]);
+    }
+
+    for (int x = 0; x < W; x++) {
+        s->counts[x] = countTo(s, min(x + R, W - 1)) - countTo(s, x - R - 1);
+    }
+}
+
+// round(255 count / pixels): a float estimate within one of the quotient, then
+// an exact integer fixup.
+static inline unsigned char alphaOf(uint32_t count, uint32_t pixels) {
+    const int64_t n = 255 * (int64_t)count + pixels / 2;
+    int64_t q = (float)n / pixels;
+
+    q += (q + 1) * pixels <= n;
+    q -= q * pixels > n;
+    return q;
+}
+
+void MaskBlur(const Bitmap *mask, unsigned char *alpha, int R) {
+    const int W = mask->width;
+    const int H = mask->height;
+
+    #pragma omp parallel
+    {
+        const int T = omp_get_num_threads();
+        const int t = omp_get_thread_num();
+        const int y0 = (int64_t)H * t / T;
+        const int y1 = (int64_t)H * (t + 1) / T;
+        Scratch s;
+        uint32_t *column = MemCalloc(W, sizeof(uint32_t));
+
+        s.words = MemAlloc(mask->stride);
+        s.prefix = MemAlloc(sizeof(uint32_t) * mask->stride / 8);
+        s.counts = MemAlloc(sizeof(uint16_t) * W);
+
+        if (!column || !s.words || !s.prefix || !s.counts) {
+            fprintf(stderr, "maskBlur: cannot allocate memory for row sums\n");
+            exit(1);
+        }
+
+        if (y0 < y1) {
+            for (int y = max(y0 - R, 0); y < min(y0 + R, H); y++) {
+                rowCounts(mask, y, R, &s);
+                for (int x = 0; x < W; x++) {
+                    column[x] += s.counts[x];
+                }
+            }
+        }
+
+        // The window of row y covers rows [y - R, y + R]; row y + R enters
+        // before the output and row y - R leaves after it.
+        for (int y = y0; y < y1; y++) {
+            const int rows = min(y + R, H - 1) - max(y - R, 0) + 1;
+            unsigned char *out = alpha + (size_t)y * W;
+
+            if (y + R < H) {
+                rowCounts(mask, y + R, R, &s);
+                for (int x = 0; x < W; x++) {
+                    column[x] += s.counts[x];
+                }
+            }
+
+            for (int x = 0; x < W; x++) {
+                const int cols = min(x + R, W - 1) - max(x - R, 0) + 1;
+                out[x] = alphaOf(column[x], rows * cols);
+            }
+
+            if (y - R >= 0) {
+                rowCounts(mask, y - R, R, &s);
+                for (int x = 0; x < W; x++) {
+                    column[x] -= s.counts[x];
+                }
+            }
+        }
+
+        MemFree(column);
+        MemFree(s.words);
+        MemFree(s.prefix);
+        MemFree(s.counts);
+    }
+}
+
+static void maskUsage(void) {
+    fprintf(stderr,
+        "usage: fast_blur --mask R input.pbm output.pgm\n"
+        "\n"
+        "Feather a raw PBM mask into an 8-bit soft mask with a box of radius R;\n"
+        "set (black) pixels count as 255.\n");
+    exit(1);
+}
+
+int MaskMain(int argc, char *argv[]) {
+    if (argc != 4) {
+        maskUsage();
+    }
+
+    char *end;
+    const long R = strtol(argv[1], &end, 10);
+    if (*end != '\0' || R < 0 || R > 32767) {
+        maskUsage();
+    }
+
+    Bitmap *mask = BitmapRead(argv[2]);
+    unsigned char *alpha = MemAlloc((size_t)mask->width * mask->height);
+
+    if (!alpha) {
+        fprintf(stderr, "maskBlur: cannot allocate memory for soft mask\n");
+        exit(1);
+    }
+
+    MaskBlur(mask, alpha, R);
+    GrayWrite(alpha, mask->width, mask->height, argv[3]);
+
+    MemFree(alpha);
+    BitmapFree(mask);
+
+    return 0;
+}
@@ -0,0 +1,29 @@
+/**
+ * Box blur of 1-bit masks into 8-bit soft masks.
+ *
+ * Feathering a binary mask into alpha with the RGB engines means expanding
+ * every bit to three bytes and building three int tables. This engine works on
+ * the packed bits instead. The horizontal window sum of a row is the
+ * difference of two prefix counts, each a word-level running count plus the
+ * popcount of the leading bits of one 64-bit word. The vertical window is a
+ * running sum of those counts, which never exceed 2R + 1, slid down each band
+ * of rows; the row leaving the window is recounted rather than kept. Output is
+ * the rounded fraction of set pixels scaled to [0, 255], over the square
+ * window clipped to the image as in the box blur.
+ *
+ * Memory beyond the mask and the output is a few rows per thread.
+ */
+
+#ifndef MASK_BLUR_H
+#define MASK_BLUR_H
+
+#include "ppmFile.h"
+
+// Blur `mask` with a (2R + 1) x (2R + 1) box into `alpha`, width * height
+// bytes row-major.
+void MaskBlur(const Bitmap *mask, unsigned char *alpha, int R);
+
+// Entry point of `fast_blur --mask ...`; `argv[0]` is the mode.
+int MaskMain(int argc, char *argv[]);
+
+#endif
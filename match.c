@@ -0,0 +1,341 @@
+/**
+ * Template matching by normalized cross-correlation, see match.h.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <omp.h>
+
+#include "match.h"
+#include "sat.h"
+#include "planes.h"
+#include "memTrack.h"
+
+#define min(X, Y) (((X) < (Y)) ? (X) : (Y))
+#define max(X, Y) (((X) < (Y)) ? (Y) : (X))
+
+// Subtracted from the r + g + b signal so that the correlation sums stay
+// small in float. The template is zero-mean, so a constant offset of the
+// image does not change the numerator.
+#define SIGNAL_OFFSET (3 * 127.5f)
+
+static inline int signal(Image *img, int x, int y) {
+    return ImageGetPixel(img, x, y, 0) + ImageGetPixel(img, x, y, 1)
+         + ImageGetPixel(img, x, y, 2);
+}
+
+/**
+ * Summed-area table of the squared signal, (W + 1) x (H + 1) entries with a
+ * zero first row and column. Squares of r + g + b overflow an int after a few
+ * thousand pixels, so the sums are 64-bit.
+ */
+static int64_t *squaresTable(Image *img) {
+    const int W = img->width;
+    const int H = img->height;
+    const size_t stride = W + 1;
+    int64_t *sq = MemCalloc(stride * (H + 1), sizeof(int64_t));
+
+    if (!sq) {
+        fprintf(stderr, "match: cannot allocate memory for squares table\n");
+        exit(1);
+    }
+
+    #pragma omp parallel for schedule(static, 4)
+    for (int row = 0; row < H; row++) {
+        int64_t *dst = sq + (row + 1) * stride + 1;
+        int64_t sum = 0;
+
+        for (int col = 0; col < W; col++) {
+            const int64_t v = signal(img, col, row);
+            dst[col] = sum += v * v;
+        }
+    }
+
+    // One strip of columns per thread, walked row by row.
+    #pragma omp parallel
+    {
+        const int T = omp_get_num_threads();
+        const int t = omp_get_thread_num();
+        const size_t c0 = stride * t / T;
+        const size_t c1 = stride * (t + 1) / T;
+
+        for (int row = 2; row <= H; row++) {
+            int64_t *restrict dst = sq + row * stride;
+            const int64_t *restrict src = dst - stride;
+
+            for (size_t c = c0; c < c1; c++) {
+                dst[c] += src[c];
+            }
+        }
+    }
+
+    return sq;
+}
+
+// Sum of squares of the window [x, x + w) x [y, y + h).
+static inline int64_t squaresRect(const int64_t *sq, int W, int x, int y, int w, int h) {
+    const size_t stride = W + 1;
+    const int64_t *top = sq + (size_t)y * stride + x;
+    const int64_t *bottom = sq + (size_t)(y + h) * stride + x;
+
+    return bottom[w] - top[w] - bottom[0] + top[0];
+}
+
+/**
+ * Insert `p` into `best`, which holds `*n` of at most `k` peaks, best first.
+ * Of equal scores the earlier one stays first.
+ */
+static void keep(MatchPeak *best, int *n, int k, MatchPeak p) {
+    if (*n == k && p.score <= best[k - 1].score) {
+        return;
+    }
+
+    int i = *n < k ? (*n)++ : k - 1;
+    while (i > 0 && best[i - 1].score < p.score) {
+        best[i] = best[i - 1];
+        i--;
+    }
+    best[i] = p;
+}
+
+/**
+ * Whether (x, y) holds the best score within `d` pixels. Of equal scores the
+ * first in raster order is the peak.
+ */
+static int isPeak(const float *score, int MW, int MH, int x, int y, int d) {
+    const float s = score[(size_t)y * MW + x];
+
+    for (int yy = max(y - d, 0); yy <= min(y + d, MH - 1); yy++) {
+        for (int xx = max(x - d, 0); xx <= min(x + d, MW - 1); xx++) {
+            const float o = score[(size_t)yy * MW + xx];
+            const int before = yy < y || (yy == y && xx < x);
+
+            if (o > s || (before && o == s)) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+int MatchTemplate(Image *img, Image *tpl, const MatchOptions *opts, MatchPeak *peaks) {
+    const int W = img->width;
+    const int H = img->height;
+    const int tw = tpl->width;
+    const int th = tpl->height;
+    const int MW = W - tw + 1;      // Window positions.
+    const int MH = H - th + 1;
+    const int N = tw * th;
+    const int k = opts->top;
+
+    if (MW < 1 || MH < 1 || k < 1) {
+        return 0;
+    }
+
+    // Zero-mean template, as correlation taps, and its energy.
+    Kernel2D kernel = { tw, th, MemAlloc(sizeof(float) * N) };
+    double mean = 0.0, energy = 0.0;
+
+    for (int y = 0; y < th; y++) {
+        for (int x = 0; x < tw; x++) {
+            mean += signal(tpl, x, y);
+        }
+    }
+    mean /= N;
+    for (int y = 0; y < th; y++) {
+        for (int x = 0; x < tw; x++) {
+            const double t = signal(tpl, x, y) - mean;
+            kernel.taps[y * tw + x] = t;
+            energy += t * t;
+        }
+    }
+
+    // Numerator. The window rows are split into three slabs of `rows` rows;
+    // plane p holds the image rows its slab's windows cover, th - 1 more than
+    // `rows`. Rows past the image only feed windows past the last one.
+    const int rows = (MH + 2) / 3;
+    const int HS = rows + th - 1;
+    float *in = PlanesCreate(W, HS);
+    float *out = PlanesCreate(W, HS);
+
+    #pragma omp parallel for schedule(static, 4)
+    for (int r = 0; r < 3 * HS; r++) {
+        const int y = r / HS * rows + r % HS;
+        float *dst = in + (size_t)r * W;
+
+        for (int x = 0; x < W; x++) {
+            dst[x] = y < H ? signal(img, x, y) - SIGNAL_OFFSET : 0.0f;
+        }
+    }
+    Conv2DPlanes(out, in, W, HS, &kernel, ConvPlanCreate(&kernel, opts->engine));
+    MemFree(in);
+
+    // Denominators: window sums per channel from the summed-area table, sums
+    // of squares from the 64-bit table.
+    Sat *sat = SatCreate(W, H, SAT_ROW_MAJOR);
+    SatRowPass(sat, img);
+    SatColumnPass(sat);
+    int64_t *sq = squaresTable(img);
+    float *score = MemAlloc(sizeof(float) * MW * MH);
+
+    if (!score) {
+        fprintf(stderr, "match: cannot allocate memory for scores\n");
+        exit(1);
+    }
+
+    // The convolution is a stencil centered on the template: the window at
+    // (x, y) is its output at (x + tw / 2, y + th / 2).
+    #pragma omp parallel for schedule(static, 4)
+    for (int y = 0; y < MH; y++) {
+        const int slab = y / rows;
+        const float *num = out + ((size_t)slab * HS + y - slab * rows + th / 2) * W + tw / 2;
+        float *dst = score + (size_t)y * MW;
+
+        for (int x = 0; x < MW; x++) {
+            int64_t s = 0;
+            for (int color = 0; color < 3; color++) {
+                s += SatRectSum(sat, SatPlane(sat, color), x, y, x + tw - 1, y + th - 1);
+            }
+            const double var = squaresRect(sq, W, x, y, tw, th) - (double)s * s / N;
+
+            // A flat window or template has no defined correlation. Any
+            // other window of integers has a variance of at least 1/2.
+            if (var < 0.5 || energy < 0.5) {
+                dst[x] = 0.0f;
+            } else {
+                const double v = num[x] / sqrt(var * energy);
+                dst[x] = v > 1.0 ? 1.0f : v < -1.0 ? -1.0f : v;
+            }
+        }
+    }
+
+    SatFree(sat);
+    MemFree(sq);
+    MemFree(out);
+    Kernel2DFree(&kernel);
+
+    // Peaks: each thread keeps the best k of its rows, checking the
+    // neighbourhood only of scores that would make its list.
+    const int T = omp_get_max_threads();
+    MatchPeak *candidates = MemAlloc(sizeof(MatchPeak) * T * k);
+    int *found = MemCalloc(T, sizeof(int));
+    const int d = max(opts->min_distance, 1);
+
+    #pragma omp parallel
+    {
+        const int t = omp_get_thread_num();
+        MatchPeak *best = candidates + (size_t)t * k;
+        int n = 0;
+
+        #pragma omp for schedule(static, 4)
+        for (int y = 0; y < MH; y++) {
+            for (int x = 0; x < MW; x++) {
+                const float s = score[(size_t)y * MW + x];
+
+                if ((n == k && s <= best[k - 1].score) || !isPeak(score, MW, MH, x, y, d)) {
+                    continue;
+                }
+                keep(best, &n, k, (MatchPeak){ x, y, s });
+            }
+        }
+        found[t] = n;
+    }
+
+    int total = 0;
+    for (int t = 0; t < T; t++) {
+        for (int i = 0; i < found[t]; i++) {
+            keep(peaks, &total, k, candidates[(size_t)t * k + i]);
+        }
+    }
+
+    MemFree(candidates);
+    MemFree(found);
+    MemFree(score);
+
+    return total;
+}
+
+static void matchUsage(void) {
+    fprintf(stderr,
+        "usage: fast_blur --match [options] template.ppm input.ppm\n"
+        "\n"
+        "Finds the template in the image by normalized cross-correlation and\n"
+        "prints the best peaks as CSV: rank, top-left corner and score in\n"
+        "[-1, 1]. No score map is written.\n"
+        "\n"
+        "options:\n"
+        "  --top K            peaks to report (default 5)\n"
+        "  --min-distance D   a peak is the best score within D pixels\n"
+        "                     (default half the smaller template side)\n"
+        "  --engine E         correlation engine: auto (default), direct or fft\n");
+    exit(1);
+}
+
+int MatchMain(int argc, char *argv[]) {
+    MatchOptions opts = { CONV_AUTO, 5, -1 };
+
+    if (argc < 3) {
+        matchUsage();
+    }
+    for (int i = 1; i < argc - 2; i++) {
+        const char *opt = argv[i];
+        const char *val = i + 1 < argc - 2 ? argv[i + 1] : NULL;
+
+        if (!val) {
+            matchUsage();
+        } else if (strcmp(opt, "--top") == 0) {
+            opts.top = atoi(val);
+        } else if (strcmp(opt, "--min-distance") == 0) {
+            opts.min_distance = atoi(val);
+        } else if (strcmp(opt, "--engine") == 0) {
+            opts.engine = ConvEngineFromName(val);
+            if (opts.engine == CONV_ENGINE_INVALID) {
+                matchUsage();
+            }
+        } else {
+            matchUsage();
+        }
+        i++;
+    }
+    if (opts.top < 1) {
+        matchUsage();
+    }
+
+    Image *tpl = ImageRead(argv[argc - 2]);
+    Image *img = ImageRead(argv[argc - 1]);
+
+    if (tpl->width > img->width || tpl->height > img->height) {
+        fprintf(stderr, "match: template is larger than the image\n");
+        exit(1);
+    }
+    if (opts.min_distance < 0) {
+        opts.min_distance = min(tpl->width, tpl->height) / 2;
+    }
+
+    // The planner only looks at the template's size.
+    Kernel2D shape = { tpl->width, tpl->height, NULL };
+    ConvPlan plan = ConvPlanCreate(&shape, opts.engine);
+    MatchPeak *peaks = malloc(sizeof(MatchPeak) * opts.top);
+
+    double t0 = omp_get_wtime();
+    int n = MatchTemplate(img, tpl, &opts, peaks);
+    double t1 = omp_get_wtime();
+
+    fprintf(stderr, "match: %dx%d template in %dx%d image, %s correlation, %.1f ms\n",
+            tpl->width, tpl->height, img->width, img->height,
+            plan.engine == CONV_FFT ? "fft" : "direct", 1e3 * (t1 - t0));
+
+    printf("rank,x,y,score\n");
+    for (int i = 0; i < n; i++) {
+        printf("%d,%d,%d,%.6f\n", i + 1, peaks[i].x, peaks[i].y, peaks[i].score);
+    }
+
+    free(peaks);
+    ImageFree(tpl);
+    ImageFree(img);
+
+    return 0;
+}
@@ -0,0 +1,47 @@
+/**
+ * Template matching by normalized cross-correlation (NCC).
+ *
+ * The score of the template t at window position (x, y) of image f is
+ *
+ *     sum (f - mean f) (t - mean t) / sqrt(sum (f - mean f)^2 sum (t - mean t)^2)
+ *
+ * over the window, with the channels summed into one signal (r + g + b). As in
+ * Lewis' fast NCC only the numerator is a correlation: since the template is
+ * made zero-mean, the image's mean drops out of it. The denominator needs the
+ * sum and the sum of squares of the image under every window, which come from
+ * summed-area tables in four lookups each.
+ *
+ * The numerator goes through the 2D convolution engines: the image rows are
+ * cut into three overlapping slabs, one per plane, and correlated with the
+ * zero-mean template by the direct engine for small templates or the
+ * overlap-save FFT for large ones, as the convolution planner decides.
+ * Scores are then computed in parallel over row bands and the best peaks
+ * kept per thread, so only the top k are returned.
+ */
+
+#ifndef MATCH_H
+#define MATCH_H
+
+#include "ppmFile.h"
+#include "conv2d.h"
+
+typedef struct MatchPeak {
+    int x;          // Top-left corner of the window.
+    int y;
+    float score;    // In [-1, 1].
+} MatchPeak;
+
+typedef struct MatchOptions {
+    ConvEngine engine;  // Numerator engine; CONV_AUTO lets the planner pick.
+    int top;            // Peaks to return.
+    int min_distance;   // A peak is the best score within this many pixels.
+} MatchOptions;
+
+// Find up to `opts->top` peaks of template `tpl` in `img`, best first, and
+// return how many were found. The template must fit in the image.
+int MatchTemplate(Image *img, Image *tpl, const MatchOptions *opts, MatchPeak *peaks);
+
+// Entry point of `fast_blur --match ...`; `argv[0]` is the mode.
+int MatchMain(int argc, char *argv[]);
+
+#endif
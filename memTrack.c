@@ -0,0 +1,114 @@
+/**
+ * Allocation accounting, see memTrack.h.
+ *
+ * Every block is prefixed with a header holding its size so that MemFree() can
+ * subtract it. The header is 16 bytes to keep the alignment malloc() gives.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "memTrack.h"
+
+#define HEADER 16
+#define MAX_STAGES 32
+
+static size_t current;
+static size_t peak;
+
+static const char *stage_names[MAX_STAGES];
+static size_t stage_peaks[MAX_STAGES];
+static int stage = -1;
+
+static void raiseTo(size_t *p, size_t value) {
+    size_t old = __atomic_load_n(p, __ATOMIC_RELAXED);
+    while (value > old
+           && !__atomic_compare_exchange_n(p, &old, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static void *account(unsigned char *block, size_t size) {
+    if (!block) {
+        return NULL;
+    }
+    memcpy(block, &size, sizeof(size));
+
+    size_t now = __atomic_add_fetch(&current, size, __ATOMIC_RELAXED);
+    raiseTo(&peak, now);
+
+    int s = __atomic_load_n(&stage, __ATOMIC_RELAXED);
+    if (s >= 0) {
+        raiseTo(&stage_peaks[s], now);
+    }
+
+    return block + HEADER;
+}
+
+void *MemAlloc(size_t size) {
+    return account(malloc(size + HEADER), size);
+}
+
+void *MemCalloc(size_t count, size_t size) {
+    return account(calloc(count * size + HEADER, 1), count * size);
+}
+
+void MemFree(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+
+    unsigned char *block = (unsigned char *)ptr - HEADER;
+    size_t size;
+    memcpy(&size, block, sizeof(size));
+    __atomic_sub_fetch(&current, size, __ATOMIC_RELAXED);
+
+    free(block);
+}
+
+size_t MemCurrent(void) {
+    return __atomic_load_n(&current, __ATOMIC_RELAXED);
+}
+
+size_t MemPeak(void) {
+    return __atomic_load_n(&peak, __ATOMIC_RELAXED);
+}
+
+void MemStage(const char *name) {
+    if (stage + 1 >= MAX_STAGES) {
+        return;
+    }
+    stage_names[stage + 1] = name;
+    stage_peaks[stage + 1] = MemCurrent();
+    __atomic_store_n(&stage, stage + 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * The "VmHWM" line of /proc/self/status, in bytes, or 0 if unavailable.
+ */
+static size_t residentHighWater(void) {
+    FILE *fp = fopen("/proc/self/status", "r");
+    char line[256];
+    size_t kb = 0;
+
+    if (!fp) {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "VmHWM:", 6) == 0) {
+            kb = strtoull(line + 6, NULL, 10);
+            break;
+        }
+    }
+    fclose(fp);
+
+    return kb * 1024;
+}
+
+void MemReport(FILE *fp) {
+    fprintf(fp, "stage,peak_bytes\n");
+    for (int s = 0; s <= stage; s++) {
+        fprintf(fp, "%s,%zu\n", stage_names[s], stage_peaks[s]);
+    }
+    fprintf(fp, "total,%zu\n", MemPeak());
+    fprintf(fp, "resident_hwm,%zu\n", residentHighWater());
+}
@@ -0,0 +1,32 @@
+/**
+ * Allocation accounting.
+ *
+ * The image I/O and the engines allocate through these wrappers, which keep
+ * count of the bytes currently allocated and of their peak, overall and per
+ * stage of a run. Counting is a couple of atomic operations per allocation, so
+ * it is always on; MemReport() prints it when asked for.
+ */
+
+#ifndef MEM_TRACK_H
+#define MEM_TRACK_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+void *MemAlloc(size_t size);
+void *MemCalloc(size_t count, size_t size);
+void  MemFree(void *ptr);
+
+// Bytes currently allocated and their peak since the start of the run.
+size_t MemCurrent(void);
+size_t MemPeak(void);
+
+// Start a new stage; later allocations count towards its peak. Stage names
+// must outlive the run (string literals).
+void MemStage(const char *name);
+
+// Print the peak of every stage, the overall peak and the process' resident
+// high-water mark as reported by the kernel.
+void MemReport(FILE *fp);
+
+#endif
@@ -0,0 +1,309 @@
+/**
+ * Kernel microbenchmarks (fast_blur_micro)
+ *
+ * Runs each loop of the blur in isolation on a cache-resident and a DRAM-sized
+ * buffer and reports cycles per pixel, so that a change to one pass can be
+ * checked against that pass alone instead of the end-to-end time:
+ *
+ *  - row-pass, column-pass, evaluate: the three passes of the box blur;
+ *  - rect-query: a batch of one (2R + 1)-square rectangle sum per pixel;
+ *  - deinterleave, interleave: RGB to float planes and back;
+ *  - ppm-parse, ppm-serialise: the PPM reader and writer on memory streams.
+ *    The parsed file is at most IMAGE_READ_MAX per side, the reader's limit,
+ *    so its size can be smaller than the others.
+ *
+ * Cycles are read with the time-stamp counter on x86, which counts at the
+ * nominal frequency, and derived from a nanosecond clock elsewhere.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <omp.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "ppmFile.h"
+#include "sat.h"
+#include "satQuery.h"
+#include "boxBlur.h"
+#include "planes.h"
+#include "bench.h"
+#include "memTrack.h"
+
+typedef enum {
+    K_ROW_PASS, K_COLUMN_PASS, K_EVALUATE, K_RECT_QUERY,
+    K_DEINTERLEAVE, K_INTERLEAVE, K_PPM_PARSE, K_PPM_SERIALISE,
+    K_COUNT
+} KernelId;
+
+static const char *kernel_names[K_COUNT] = {
+    "row-pass", "column-pass", "evaluate", "rect-query",
+    "deinterleave", "interleave", "ppm-parse", "ppm-serialise"
+};
+
+static inline uint64_t cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_lfence();
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+/**
+ * Buffers for one image size, shared by all kernels.
+ */
+typedef struct Buffers {
+    Image *in;
+    Image *out;
+    Sat *sat;
+    SatRect *rects;     // One square per pixel, for rect-query.
+    int *sums;
+    float *planes;
+    char *ppm;          // A PPM file of at most IMAGE_READ_MAX per side.
+    size_t ppm_size;
+    int ppm_width;
+    int ppm_height;
+} Buffers;
+
+static Buffers buffersCreate(int W, int H, int R) {
+    Buffers b;
+
+    b.in = BenchImage(W, H, 1);
+    b.out = ImageCreate(W, H);
+    b.sat = SatCreate(W, H, SAT_ROW_MAJOR);
+    b.planes = PlanesCreate(W, H);
+    b.rects = malloc(sizeof(SatRect) * W * H);
+    b.sums = malloc(sizeof(int) * 3 * W * H);
+    b.ppm_width = W < IMAGE_READ_MAX ? W : IMAGE_READ_MAX;
+    b.ppm_height = H < IMAGE_READ_MAX ? H : IMAGE_READ_MAX;
+    b.ppm_size = (size_t)W * H * 3 + 64;
+    b.ppm = malloc(b.ppm_size);
+
+    Image *crop = b.in;
+    if (b.ppm_width < W || b.ppm_height < H) {
+        crop = BenchImage(b.ppm_width, b.ppm_height, 1);
+    }
+    FILE *fp = fmemopen(b.ppm, b.ppm_size, "w");
+    ImageWriteTo(crop, fp);
+    fclose(fp);
+    if (crop != b.in) {
+        ImageFree(crop);
+    }
+
+    // Every kernel reads valid data, whatever runs first.
+    SatRowPass(b.sat, b.in);
+    SatColumnPass(b.sat);
+    PlanesFromImage(b.planes, b.in);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            b.rects[(size_t)y * W + x] = (SatRect){ x - R, y - R, x + R, y + R };
+        }
+    }
+
+    return b;
+}
+
+static void buffersFree(Buffers *b) {
+    ImageFree(b->in);
+    ImageFree(b->out);
+    SatFree(b->sat);
+    MemFree(b->planes);
+    free(b->rects);
+    free(b->sums);
+    free(b->ppm);
+}
+
+/**
+ * Run a kernel once and return the cycles it took. Setup it needs, such as
+ * restoring the row sums before a column pass, is not timed.
+ */
+static uint64_t runKernel(KernelId k, Buffers *b, int R) {
+    uint64_t t0, t1;
+    FILE *fp;
+
+    switch (k) {
+    case K_ROW_PASS:
+        t0 = cycles();
+        SatRowPass(b->sat, b->in);
+        t1 = cycles();
+        break;
+    case K_COLUMN_PASS:
+        SatRowPass(b->sat, b->in);
+        t0 = cycles();
+        SatColumnPass(b->sat);
+        t1 = cycles();
+        break;
+    case K_EVALUATE:
+        t0 = cycles();
+        BoxBlur(b->out, b->sat, R);
+        t1 = cycles();
+        break;
+    case K_RECT_QUERY:
+        t0 = cycles();
+        SatQuery(b->sat, b->rects, (size_t)b->in->width * b->in->height, b->sums);
+        t1 = cycles();
+        break;
+    case K_DEINTERLEAVE:
+        t0 = cycles();
+        PlanesFromImage(b->planes, b->in);
+        t1 = cycles();
+        break;
+    case K_INTERLEAVE:
+        t0 = cycles();
+        PlanesToImage(b->out, b->planes);
+        t1 = cycles();
+        break;
+    case K_PPM_PARSE: {
+        fp = fmemopen(b->ppm, b->ppm_size, "r");
+        t0 = cycles();
+        Image *img = ImageReadFrom(fp);
+        t1 = cycles();
+        fclose(fp);
+        ImageFree(img);
+        break;
+    }
+    case K_PPM_SERIALISE:
+    default:
+        fp = fmemopen(b->ppm, b->ppm_size, "w");
+        t0 = cycles();
+        ImageWriteTo(b->out, fp);
+        fflush(fp);
+        t1 = cycles();
+        fclose(fp);
+        break;
+    }
+
+    return t1 - t0;
+}
+
+/**
+ * Counter ticks per second, measured against the wall clock.
+ */
+static double cycleRate(void) {
+    double w0 = omp_get_wtime();
+    uint64_t c0 = cycles();
+    while (omp_get_wtime() - w0 < 0.05) {
+    }
+    return (cycles() - c0) / (omp_get_wtime() - w0);
+}
+
+static int compareU64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void usage(void) {
+    fprintf(stderr,
+        "usage: fast_blur_micro [options]\n"
+        "\n"
+        "options:\n"
+        "  --kernel NAME   run only this kernel (row-pass, column-pass, evaluate,\n"
+        "                  rect-query, deinterleave, interleave, ppm-parse,\n"
+        "                  ppm-serialise)\n"
+        "  --cache WxH     cache-resident size (default 128x128)\n"
+        "  --dram WxH      DRAM-sized size (default 4096x4096); ppm-parse reads\n"
+        "                  at most %dx%d of it\n"
+        "  --radius R      radius for the evaluate and rect-query kernels (default 8)\n"
+        "  --reps N        minimum repetitions (default 20)\n"
+        "  --threads N     OpenMP threads (default 1)\n",
+        IMAGE_READ_MAX, IMAGE_READ_MAX);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    int sizes[2][2] = { { 128, 128 }, { 4096, 4096 } };
+    const char *size_names[2] = { "cache", "dram" };
+    int only = -1, R = 8, reps = 20, threads = 1;
+
+    for (int i = 1; i < argc; i++) {
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (!val) {
+            usage();
+        } else if (strcmp(argv[i], "--kernel") == 0) {
+            for (int k = 0; k < K_COUNT; k++) {
+                if (strcmp(val, kernel_names[k]) == 0) {
+                    only = k;
+                }
+            }
+            if (only < 0) {
+                usage();
+            }
+        } else if (strcmp(argv[i], "--cache") == 0 || strcmp(argv[i], "--dram") == 0) {
+            int *s = sizes[argv[i][2] == 'd'];
+            if (sscanf(val, "%dx%d", &s[0], &s[1]) != 2 || s[0] < 1 || s[1] < 1) {
+                usage();
+            }
+        } else if (strcmp(argv[i], "--radius") == 0) {
+            R = atoi(val);
+        } else if (strcmp(argv[i], "--reps") == 0) {
+            reps = atoi(val) > 0 ? atoi(val) : 1;
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            threads = atoi(val) > 0 ? atoi(val) : 1;
+        } else {
+            usage();
+        }
+        i++;
+    }
+
+    omp_set_num_threads(threads);
+    const double rate = cycleRate();
+
+    uint64_t *samples = NULL;
+    int capacity = 0;
+
+    printf("kernel,size,width,height,threads,reps,"
+           "cycles_per_px_min,cycles_per_px_median,ns_per_px_median\n");
+
+    for (int s = 0; s < 2; s++) {
+        Buffers b = buffersCreate(sizes[s][0], sizes[s][1], R);
+
+        for (int k = 0; k < K_COUNT; k++) {
+            const int W = k == K_PPM_PARSE ? b.ppm_width : sizes[s][0];
+            const int H = k == K_PPM_PARSE ? b.ppm_height : sizes[s][1];
+            const double pixels = (double)W * H;
+
+            if (only >= 0 && k != only) {
+                continue;
+            }
+
+            // Warm up, then repeat at least `reps` times and for at least a
+            // tenth of a second so that small buffers get enough samples.
+            runKernel(k, &b, R);
+
+            int n = 0;
+            double start = omp_get_wtime();
+            while (n < reps || omp_get_wtime() - start < 0.1) {
+                if (n == capacity) {
+                    capacity = capacity ? 2 * capacity : 64;
+                    samples = realloc(samples, sizeof(uint64_t) * capacity);
+                }
+                samples[n++] = runKernel(k, &b, R);
+            }
+            qsort(samples, n, sizeof(uint64_t), compareU64);
+
+            printf("%s,%s,%d,%d,%d,%d,%.3f,%.3f,%.3f\n",
+                   kernel_names[k], size_names[s], W, H, threads, n,
+                   samples[0] / pixels, samples[n / 2] / pixels,
+                   1e9 * samples[n / 2] / rate / pixels);
+            fflush(stdout);
+        }
+
+        buffersFree(&b);
+    }
+
+    free(samples);
+
+    return 0;
+}
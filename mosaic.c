@@ -0,0 +1,185 @@
+/**
+ * Mosaic (pixelation), see mosaic.h.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "mosaic.h"
+#include "memTrack.h"
+
+#define min(X, Y) (((X) < (Y)) ? (X) : (Y))
+#define max(X, Y) (((X) < (Y)) ? (Y) : (X))
+
+// Index of the grid square holding `pos`, for a grid starting at `origin`.
+static inline int blockOf(int pos, int origin, int block) {
+    const int d = pos - origin;
+    return d >= 0 ? d / block : -((-d + block - 1) / block);
+}
+
+/**
+ * Pixelate the region [x0, x1] x [y0, y1], already clipped to the image.
+ */
+static void mosaicRegion(
+    const Sat *sat, Image *img_out, const MosaicOptions *opts,
+    int x0, int y0, int x1, int y1
+) {
+    const int b = opts->block;
+    const int ox = opts->align_roi ? x0 : opts->align_x;
+    const int oy = opts->align_roi ? y0 : opts->align_y;
+    const int i0 = blockOf(x0, ox, b);
+    const int j0 = blockOf(y0, oy, b);
+    const int nx = blockOf(x1, ox, b) - i0 + 1;
+    const int ny = blockOf(y1, oy, b) - j0 + 1;
+    const size_t n = (size_t)nx * ny;
+    SatRect *rects = MemAlloc(sizeof(SatRect) * n);
+    int *sums = MemAlloc(sizeof(int) * 3 * n);
+
+    if (!rects || !sums) {
+        fprintf(stderr, "mosaic: cannot allocate memory for %zu blocks\n", n);
+        exit(1);
+    }
+
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            SatRect *r = rects + (size_t)j * nx + i;
+
+            r->x0 = max(ox + (i0 + i) * b, x0);
+            r->y0 = max(oy + (j0 + j) * b, y0);
+            r->x1 = min(ox + (i0 + i + 1) * b - 1, x1);
+            r->y1 = min(oy + (j0 + j + 1) * b - 1, y1);
+        }
+    }
+
+    SatQuery(sat, rects, n, sums);
+
+    #pragma omp parallel for schedule(static, 1)
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            const SatRect *r = rects + (size_t)j * nx + i;
+            const int *s = sums + 3 * ((size_t)j * nx + i);
+            const int pixels = (r->x1 - r->x0 + 1) * (r->y1 - r->y0 + 1);
+            const unsigned char mean[3] = {
+                SatMean(s[0], pixels), SatMean(s[1], pixels), SatMean(s[2], pixels)
+            };
+
+            for (int y = r->y0; y <= r->y1; y++) {
+                unsigned char *out = img_out->data + (size_t)y * img_out->stride;
+
+                for (int x = r->x0; x <= r->x1; x++) {
+                    out[3 * x] = mean[0];
+                    out[3 * x + 1] = mean[1];
+                    out[3 * x + 2] = mean[2];
+                }
+            }
+        }
+    }
+
+    MemFree(rects);
+    MemFree(sums);
+}
+
+void Mosaic(Image *img_in, Image *img_out, const MosaicOptions *opts) {
+    const int W = img_in->width;
+    const int H = img_in->height;
+    Sat *sat = SatCreate(W, H, opts->layout);
+
+    SatRowPass(sat, img_in);
+    SatColumnPass(sat);
+
+    for (int y = 0; y < H; y++) {
+        memcpy(img_out->data + (size_t)y * img_out->stride,
+               img_in->data + (size_t)y * img_in->stride, (size_t)W * 3);
+    }
+
+    if (opts->nrois == 0) {
+        mosaicRegion(sat, img_out, opts, 0, 0, W - 1, H - 1);
+    }
+    for (int k = 0; k < opts->nrois; k++) {
+        const SatRect *r = opts->rois + k;
+        const int x0 = max(r->x0, 0);
+        const int y0 = max(r->y0, 0);
+        const int x1 = min(r->x1, W - 1);
+        const int y1 = min(r->y1, H - 1);
+
+        if (x0 <= x1 && y0 <= y1) {
+            mosaicRegion(sat, img_out, opts, x0, y0, x1, y1);
+        }
+    }
+
+    SatFree(sat);
+}
+
+static void mosaicUsage(void) {
+    fprintf(stderr,
+        "usage: fast_blur --mosaic [options] input.ppm output.ppm\n"
+        "\n"
+        "Pixelate the image, or the given regions, into squares of their mean.\n"
+        "\n"
+        "options:\n"
+        "  --block N        side of a square in pixels (default 16)\n"
+        "  --align X,Y      put a corner of the grid at (X, Y) (default 0,0)\n"
+        "  --align roi      start the grid at each region's top-left corner\n"
+        "  --roi X,Y,WxH    pixelate only this region; may be repeated\n"
+        "  --layout L       summed-area table layout: rows (default), tiled or\n"
+        "                   interleaved\n");
+    exit(1);
+}
+
+int MosaicMain(int argc, char *argv[]) {
+    MosaicOptions opts = { 16, 0, 0, 0, NULL, 0, SAT_ROW_MAJOR };
+    SatRect *rois = NULL;
+
+    if (argc < 3) {
+        mosaicUsage();
+    }
+    for (int i = 1; i < argc - 2; i++) {
+        const char *opt = argv[i];
+        const char *val = i + 1 < argc - 2 ? argv[i + 1] : NULL;
+
+        if (!val) {
+            mosaicUsage();
+        } else if (strcmp(opt, "--block") == 0) {
+            opts.block = atoi(val);
+        } else if (strcmp(opt, "--align") == 0) {
+            if (strcmp(val, "roi") == 0) {
+                opts.align_roi = 1;
+            } else if (sscanf(val, "%d,%d", &opts.align_x, &opts.align_y) != 2) {
+                mosaicUsage();
+            }
+        } else if (strcmp(opt, "--roi") == 0) {
+            int x, y, w, h;
+
+            if (sscanf(val, "%d,%d,%dx%d", &x, &y, &w, &h) != 4 || w < 1 || h < 1) {
+                mosaicUsage();
+            }
+            rois = realloc(rois, sizeof(SatRect) * (opts.nrois + 1));
+            rois[opts.nrois++] = (SatRect){ x, y, x + w - 1, y + h - 1 };
+        } else if (strcmp(opt, "--layout") == 0) {
+            opts.layout = SatLayoutFromName(val);
+            if (opts.layout == SAT_LAYOUT_INVALID) {
+                mosaicUsage();
+            }
+        } else {
+            mosaicUsage();
+        }
+        i++;
+    }
+    if (opts.block < 1) {
+        mosaicUsage();
+    }
+    opts.rois = rois;
+
+    Image *img_in = ImageRead(argv[argc - 2]);
+    Image *img_out = ImageCreate(img_in->width, img_in->height);
+
+    Mosaic(img_in, img_out, &opts);
+
+    ImageWrite(img_out, argv[argc - 1]);
+    ImageFree(img_in);
+    ImageFree(img_out);
+    free(rois);
+
+    return 0;
+}
@@ -0,0 +1,41 @@
+/**
+ * Mosaic (pixelation) for redaction.
+ *
+ * The image, or each of a list of regions of interest, is cut into
+ * block x block squares on a grid, and every pixel of a square is replaced by
+ * the square's mean. Squares are clipped to the region and to the image, so
+ * nothing outside a region contributes to its means. The grid starts at
+ * (align_x, align_y), or at each region's top-left corner with `align_roi`.
+ *
+ * Each mean is a single summed-area table query (see satQuery.h): the table is
+ * built once and one rectangle per square is looked up, so the cost beyond the
+ * build is one query per square plus writing the pixels. Later regions
+ * overwrite earlier ones where they overlap; all means are taken from the
+ * input.
+ */
+
+#ifndef MOSAIC_H
+#define MOSAIC_H
+
+#include "ppmFile.h"
+#include "sat.h"
+#include "satQuery.h"
+
+typedef struct MosaicOptions {
+    int block;              // Side of a square in pixels.
+    int align_x;            // A corner of the grid, when not aligned to the
+    int align_y;            // regions.
+    int align_roi;          // Start the grid at each region's top-left corner.
+    const SatRect *rois;    // Regions, inclusive; the whole image if none.
+    int nrois;
+    SatLayout layout;       // Layout of the summed-area table.
+} MosaicOptions;
+
+// Pixelate `img_in` into `img_out`, which has the same size. Pixels outside
+// the regions are copied.
+void Mosaic(Image *img_in, Image *img_out, const MosaicOptions *opts);
+
+// Entry point of `fast_blur --mosaic ...`; `argv[0]` is the mode.
+int MosaicMain(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,65 @@
+/**
+ * Deinterleaved float planes, see planes.h.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "planes.h"
+#include "memTrack.h"
+
+float *PlanesCreate(int width, int height) {
+    float *planes = MemAlloc(sizeof(float) * 3 * (size_t)width * height);
+
+    if (!planes) {
+        fprintf(stderr, "planes: cannot allocate memory for planes\n");
+        exit(1);
+    }
+
+    return planes;
+}
+
+void PlanesFromImage(float *planes, Image *img) {
+    const int H = img->height;
+    const int W = img->width;
+    const size_t n = (size_t)W * H;
+
+    #pragma omp parallel for schedule(static, 4)
+    for (int row = 0; row < H; row++) {
+        const unsigned char *src = img->data + (size_t)row * img->stride;
+        float *r = planes + (size_t)row * W;
+        float *g = r + n;
+        float *b = g + n;
+
+        for (int col = 0; col < W; col++) {
+            r[col] = src[3 * col + 0];
+            g[col] = src[3 * col + 1];
+            b[col] = src[3 * col + 2];
+        }
+    }
+}
+
+static inline unsigned char toPixel(float v) {
+    v += 0.5f;
+    return v < 0.0f ? 0 : v > 255.0f ? 255 : (unsigned char)v;
+}
+
+void PlanesToImage(Image *img, const float *planes) {
+    const int H = img->height;
+    const int W = img->width;
+    const size_t n = (size_t)W * H;
+
+    #pragma omp parallel for schedule(static, 4)
+    for (int row = 0; row < H; row++) {
+        unsigned char *dst = img->data + (size_t)row * img->stride;
+        const float *r = planes + (size_t)row * W;
+        const float *g = r + n;
+        const float *b = g + n;
+
+        for (int col = 0; col < W; col++) {
+            dst[3 * col + 0] = toPixel(r[col]);
+            dst[3 * col + 1] = toPixel(g[col]);
+            dst[3 * col + 2] = toPixel(b[col]);
+        }
+    }
+}
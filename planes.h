@@ -0,0 +1,30 @@
+/**
+ * Deinterleaved float planes of an RGB image.
+ *
+ * Engines that do floating-point arithmetic work on one contiguous plane per
+ * color channel so that their inner loops run over consecutive pixels of a
+ * single channel. The three planes are allocated as one block, red first.
+ */
+
+#ifndef PLANES_H
+#define PLANES_H
+
+#include <stddef.h>
+
+#include "ppmFile.h"
+
+// Allocate three planes of `width * height` floats.
+float *PlanesCreate(int width, int height);
+
+// Pointer to the plane of the given color channel.
+static inline float *PlanesChannel(float *planes, int width, int height, int color) {
+    return planes + (size_t)color * width * height;
+}
+
+// Split the interleaved pixels of `img` into the planes.
+void PlanesFromImage(float *planes, Image *img);
+
+// Round, clamp to [0, 255] and interleave the planes back into `img`.
+void PlanesToImage(Image *img, const float *planes);
+
+#endif
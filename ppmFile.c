@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <ctype.h>
 #include "ppmFile.h"
+#include "memTrack.h"
 
 /************************ private functions ****************************/
 
@@ -33,21 +34,22 @@
 	static void
 	checkDimension(int dim)
 	{
-	  if (dim < 1 || dim > 6000) 
+	  if (dim < 1 || dim > IMAGE_READ_MAX) 
 		die("file contained unreasonable width or height");
 	}
 
 
-	/* read a header: verify format and get width and height */
+	/* read a P6 header: verify format and get width and height, at most
+	   limit each; returns an error message, or NULL */
 
-	static void
-	readPPMHeader(FILE *fp, int *width, int *height)
+	static char const *
+	parsePPMHeader(FILE *fp, int *width, int *height, int limit)
 	{
 	  char ch;
 	  int  maxval;
 
 	  if (fscanf(fp, "P%c\n", &ch) != 1 || ch != '6') 
-		die("file is not in ppm raw format; cannot read");
+		return "file is not in ppm raw format; cannot read";
 
 	  /* skip comments */
 	  ch = getc(fp);
@@ -55,19 +57,64 @@
 		{
 		  do {
 		ch = getc(fp);
-		  } while (ch != '\n');	/* read to the end of the line */
+		  } while (ch != '\n' && ch != EOF);	/* read to the end of the line */
 		  ch = getc(fp);            
 		}
 
-	  if (!isdigit(ch)) die("cannot read header information from ppm file");
+	  if (!isdigit(ch)) return "cannot read header information from ppm file";
 
 	  ungetc(ch, fp);		/* put that digit back */
 
-	  /* read the width, height, and maximum value for a pixel */
-	  fscanf(fp, "%d%d%d\n", width, height, &maxval);
+	  /* read the width, height, and maximum value for a pixel, then the
+	     single whitespace character before the data, which may itself
+	     start with bytes that look like whitespace */
+	  if (fscanf(fp, "%d%d%d", width, height, &maxval) != 3 || !isspace(getc(fp)))
+		return "cannot read header information from ppm file";
 
-	  if (maxval != 255) die("image is not true-color (24 bit); read failed");
+	  if (maxval != 255) return "image is not true-color (24 bit); read failed";
 	  
+	  if (*width < 1 || *width > limit || *height < 1 || *height > limit)
+		return "file contained unreasonable width or height";
+
+	  return NULL;
+	}
+
+	static void
+	readPPMHeaderUpTo(FILE *fp, int *width, int *height, int limit)
+	{
+	  char const *error = parsePPMHeader(fp, width, height, limit);
+
+	  if (error) die(error);
+	}
+
+	/* read a P4 header: verify format and get width and height */
+
+	static void
+	readPBMHeader(FILE *fp, int *width, int *height)
+	{
+	  char ch;
+
+	  if (fscanf(fp, "P%c\n", &ch) != 1 || ch != '4') 
+		die("file is not in pbm raw format; cannot read");
+
+	  /* skip comments */
+	  ch = getc(fp);
+	  while (ch == '#')
+		{
+		  do {
+		ch = getc(fp);
+		  } while (ch != '\n' && ch != EOF);	/* read to the end of the line */
+		  ch = getc(fp);            
+		}
+
+	  if (!isdigit(ch)) die("cannot read header information from pbm file");
+
+	  ungetc(ch, fp);
+
+	  /* the width and height, then a single whitespace character */
+	  if (fscanf(fp, "%d%d", width, height) != 2 || !isspace(getc(fp)))
+		die("cannot read header information from pbm file");
+
 	  checkDimension(*width);
 	  checkDimension(*height);
 	}
@@ -75,45 +122,109 @@
 	/************************ exported functions ****************************/
 
 	Image *
-	ImageCreate(int width, int height)
+	ImageTryCreate(int width, int height)
 	{
-	  Image *image = (Image *) malloc(sizeof(Image));
+	  Image *image = (Image *) MemAlloc(sizeof(Image));
 
-	  if (!image) die("cannot allocate memory for new image");
+	  if (!image) return NULL;
 
 	  image->width  = width;
 	  image->height = height;
-	  image->data   = (unsigned char *) malloc(width * height * 3);
+	  image->stride = width * 3;
+	  image->data   = (unsigned char *) MemAlloc((size_t) width * height * 3);
 
-	  if (!image->data) die("cannot allocate memory for new image");
+	  if (!image->data)
+		{
+		  MemFree(image);
+		  return NULL;
+		}
+
+	  return image;
+	}
+
+
+	Image *
+	ImageCreate(int width, int height)
+	{
+	  Image *image = ImageTryCreate(width, height);
+
+	  if (!image) die("cannot allocate memory for new image");
 
 	  return image;
 	}
 	  
 
+	void
+	ImageFree(Image *image)
+	{
+	  MemFree(image->data);
+	  MemFree(image);
+	}
+
+
+	Image
+	ImageView(unsigned char *data, int width, int height, int stride)
+	{
+	  Image image;
+
+	  image.width  = width;
+	  image.height = height;
+	  image.stride = stride;
+	  image.data   = data;
+
+	  return image;
+	}
+
+
 	Image *
-	ImageRead(char const *filename)
+	ImageTryReadFrom(FILE *fp, char const **error)
 	{
-	  int width, height, num, size;
+	  int width, height;
+	  size_t size;
+	  Image *image;
 
-	  Image *image = (Image *) malloc(sizeof(Image));
-	  FILE  *fp    = fopen(filename, "r");
+	  *error = parsePPMHeader(fp, &width, &height, IMAGE_READ_MAX);
+	  if (*error) return NULL;
 
-	  if (!image) die("cannot allocate memory for new image");
-	  if (!fp)    die("cannot open file for reading");
+	  image = ImageTryCreate(width, height);
+	  if (!image)
+		{
+		  *error = "cannot allocate memory for new image";
+		  return NULL;
+		}
 
-	  readPPMHeader(fp, &width, &height);
+	  size = (size_t) width * height * 3;
+	  if (fread((void *) image->data, 1, size, fp) != size)
+		{
+		  ImageFree(image);
+		  *error = "cannot read image data from file";
+		  return NULL;
+		}
+
+	  return image;
+	}
 
-	  size          = width * height * 3;
-	  image->data   = (unsigned  char*) malloc(size);
-	  image->width  = width;
-	  image->height = height;
 
-	  if (!image->data) die("cannot allocate memory for new image");
+	Image *
+	ImageReadFrom(FILE *fp)
+	{
+	  char const *error;
+	  Image *image = ImageTryReadFrom(fp, &error);
+
+	  if (!image) die(error);
 
-	  num = fread((void *) image->data, 1, (size_t) size, fp);
+	  return image;
+	}
 
-	  if (num != size) die("cannot read image data from file");
+
+	Image *
+	ImageRead(char const *filename)
+	{
+	  FILE  *fp    = fopen(filename, "r");
+
+	  if (!fp)    die("cannot open file for reading");
+
+	  Image *image = ImageReadFrom(fp);
 
 	  fclose(fp);
 
@@ -121,20 +232,39 @@
 	}
 
 
-	void ImageWrite(Image *image, char const *filename)
+	int
+	ImageTryWriteTo(Image *image, FILE *fp)
 	{
-	  int num;
-	  int size = image->width * image->height * 3;
+	  size_t num, size = (size_t) image->width * image->height * 3;
+	  int    y;
 
-	  FILE *fp = fopen(filename, "w");
+	  if (fprintf(fp, "P6\n%d %d\n%d\n", image->width, image->height, 255) < 0)
+		return -1;
 
-	  if (!fp) die("cannot open file for writing");
+	  if (image->stride == image->width * 3)
+		num = fwrite((void *) image->data, 1, size, fp);
+	  else
+		for (y = 0, num = 0; y < image->height; y++)
+		  num += fwrite((void *) (image->data + y * image->stride), 1,
+						(size_t) image->width * 3, fp);
+
+	  return num == size ? 0 : -1;
+	}
 
-	  fprintf(fp, "P6\n%d %d\n%d\n", image->width, image->height, 255);
 
-	  num = fwrite((void *) image->data, 1, (size_t) size, fp);
+	void ImageWriteTo(Image *image, FILE *fp)
+	{
+	  if (ImageTryWriteTo(image, fp) < 0) die("cannot write image data to file");
+	}
+
+
+	void ImageWrite(Image *image, char const *filename)
+	{
+	  FILE *fp = fopen(filename, "w");
+
+	  if (!fp) die("cannot open file for writing");
 
-	  if (num != size) die("cannot write image data to file");
+	  ImageWriteTo(image, fp);
 
 	  fclose(fp);
 	}  
@@ -157,23 +287,25 @@
 	void   
 	ImageClear(Image *image, unsigned char red, unsigned char green, unsigned char blue)
 	{
-	  int i;
-	  int pix = image->width * image->height;
+	  int x, y;
 
-	  unsigned char *data = image->data;
-
-	  for (i = 0; i < pix; i++)
+	  for (y = 0; y < image->height; y++)
 		{
-		  *data++ = red;
-		  *data++ = green;
-		  *data++ = blue;
+		  unsigned char *data = image->data + y * image->stride;
+
+		  for (x = 0; x < image->width; x++)
+			{
+			  *data++ = red;
+			  *data++ = green;
+			  *data++ = blue;
+			}
 		}
 	}
 
 	void
 	ImageSetPixel(Image *image, int x, int y, int chan, unsigned char val)
 	{
-	  int offset = (y * image->width + x) * 3 + chan;
+	  int offset = y * image->stride + x * 3 + chan;
 
 	  image->data[offset] = val;
 	}
@@ -182,7 +314,105 @@
 	unsigned  char
 	ImageGetPixel(Image *image, int x, int y, int chan)
 	{
-	  int offset = (y * image->width + x) * 3 + chan;
+	  int offset = y * image->stride + x * 3 + chan;
 
 	  return image->data[offset];
 	}
+
+
+	Bitmap *
+	BitmapCreate(int width, int height)
+	{
+	  Bitmap *bitmap = (Bitmap *) MemAlloc(sizeof(Bitmap));
+
+	  if (!bitmap) die("cannot allocate memory for new bitmap");
+
+	  bitmap->width  = width;
+	  bitmap->height = height;
+	  bitmap->stride = (width + 63) / 64 * 8;
+	  bitmap->bits   = (unsigned char *) MemCalloc((size_t) bitmap->stride * height, 1);
+
+	  if (!bitmap->bits) die("cannot allocate memory for new bitmap");
+
+	  return bitmap;
+	}
+
+
+	void
+	BitmapFree(Bitmap *bitmap)
+	{
+	  MemFree(bitmap->bits);
+	  MemFree(bitmap);
+	}
+
+
+	Bitmap *
+	BitmapReadFrom(FILE *fp)
+	{
+	  int width, height, y;
+
+	  readPBMHeader(fp, &width, &height);
+
+	  Bitmap *bitmap = BitmapCreate(width, height);
+	  size_t  row    = (width + 7) / 8;
+
+	  /* rows are packed to whole bytes in the file, to whole words here;
+	     the file's padding bits are undefined and get cleared */
+	  for (y = 0; y < height; y++)
+		{
+		  unsigned char *bits = bitmap->bits + (size_t) y * bitmap->stride;
+
+		  if (fread(bits, 1, row, fp) != row)
+			die("cannot read bitmap data from file");
+		  if (width % 8)
+			bits[row - 1] &= 0xff << (8 - width % 8);
+		}
+
+	  return bitmap;
+	}
+
+
+	Bitmap *
+	BitmapRead(char const *filename)
+	{
+	  FILE *fp = fopen(filename, "r");
+
+	  if (!fp) die("cannot open file for reading");
+
+	  Bitmap *bitmap = BitmapReadFrom(fp);
+
+	  fclose(fp);
+
+	  return bitmap;
+	}
+
+
+	void
+	GrayWrite(const unsigned char *data, int width, int height, char const *filename)
+	{
+	  FILE  *fp   = fopen(filename, "w");
+	  size_t size = (size_t) width * height;
+
+	  if (!fp) die("cannot open file for writing");
+
+	  fprintf(fp, "P5\n%d %d\n%d\n", width, height, 255);
+
+	  if (fwrite((void *) data, 1, size, fp) != size)
+		die("cannot write image data to file");
+
+	  fclose(fp);
+	}
+
+
+	void
+	ImageReadHeader(FILE *fp, int *width, int *height)
+	{
+	  readPPMHeaderUpTo(fp, width, height, IMAGE_STREAM_MAX);
+	}
+
+
+	void
+	ImageWriteHeader(FILE *fp, int width, int height)
+	{
+	  fprintf(fp, "P6\n%d %d\n%d\n", width, height, 255);
+	}
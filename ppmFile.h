@@ -10,22 +10,55 @@
 #define PPM_H
 
 #include <sys/types.h>
+#include <stdio.h>
 
 typedef struct Image
 {
 	  int width;
 	  int height;
+	  int stride;		/* bytes from one row to the next, at least width * 3 */
 	  unsigned char *data;
 } Image;
 
 // Create an image of the specified width/height.
 Image *ImageCreate(int width, int height);
+
+// Same as ImageCreate(), but returns NULL if memory runs out.
+Image *ImageTryCreate(int width, int height);
 	
+// Release the image and its pixels.
+void   ImageFree(Image *image);
+
+// Wrap pixels owned by the caller, rows `stride` bytes apart, without copying.
+// The view must not be passed to ImageFree().
+Image  ImageView(unsigned char *data, int width, int height, int stride);
+
 // Read the image from the specified file.
 Image *ImageRead(char const *filename);
 // Write the image to the specified file.
 void   ImageWrite(Image *image, char const *filename);
 
+// Same as ImageRead()/ImageWrite() on an open stream, which is left open.
+Image *ImageReadFrom(FILE *fp);
+void   ImageWriteTo(Image *image, FILE *fp);
+
+// Same as ImageReadFrom(), but instead of exiting on a malformed or oversized
+// file or when memory runs out, returns NULL and points *error at the reason.
+Image *ImageTryReadFrom(FILE *fp, char const **error);
+
+// Same as ImageWriteTo(), but returns -1 instead of exiting on a short write,
+// 0 on success. Errors the stream reports only on fclose() are the caller's.
+int    ImageTryWriteTo(Image *image, FILE *fp);
+
+// Largest side accepted by whole-image reads, and by ImageReadHeader().
+#define IMAGE_READ_MAX 6000
+#define IMAGE_STREAM_MAX 1000000
+
+// Read or write only the header of a raw PPM stream, for callers that stream
+// the rows themselves. The stream is left at the first pixel.
+void   ImageReadHeader(FILE *fp, int *width, int *height);
+void   ImageWriteHeader(FILE *fp, int width, int height);
+
 // Returns width/height of the image.
 int    ImageWidth(Image *image);
 int    ImageHeight(Image *image);
@@ -39,4 +72,27 @@ void   ImageSetPixel(Image *image, int x, int y, int chan, unsigned char val);
 // Returns the value of the color channel (chan) of the pixel at position (x,y).
 unsigned char ImageGetPixel(Image *image, int x, int y, int chan);
 
+// A 1-bit image as read from a raw PBM (P4) file: each row's pixels are packed
+// MSB first, 1 for black (set), and padded with zeros to whole 64-bit words.
+typedef struct Bitmap
+{
+	  int width;
+	  int height;
+	  int stride;		/* bytes from one row to the next, a multiple of 8 */
+	  unsigned char *bits;
+} Bitmap;
+
+// Create a bitmap of the specified width/height, all clear.
+Bitmap *BitmapCreate(int width, int height);
+
+// Release the bitmap and its bits.
+void    BitmapFree(Bitmap *bitmap);
+
+// Read a raw PBM (P4) bitmap from the specified file or open stream.
+Bitmap *BitmapRead(char const *filename);
+Bitmap *BitmapReadFrom(FILE *fp);
+
+// Write width * height 8-bit gray values as a raw PGM (P5) file.
+void    GrayWrite(const unsigned char *data, int width, int height, char const *filename);
+
 #endif 
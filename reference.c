@@ -0,0 +1,454 @@
+/**
+ * Golden reference implementations, see reference.h.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "reference.h"
+
+#define min(X, Y) (((X) < (Y)) ? (X) : (Y))
+#define max(X, Y) (((X) < (Y)) ? (Y) : (X))
+
+void RefBlur(
+    const unsigned char *in, unsigned char *out, int W, int H, int C,
+    int R, RefShape shape
+) {
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            for (int c = 0; c < C; c++) {
+                long long sum = 0;
+                int pixels = 0;
+
+                for (int dy = -R; dy <= R; dy++) {
+                    for (int dx = -R; dx <= R; dx++) {
+                        int yy = y + dy;
+                        int xx = x + dx;
+
+                        if (shape == REF_DISK && dx * dx + dy * dy > R * R) {
+                            continue;
+                        }
+                        if (yy < 0 || yy >= H || xx < 0 || xx >= W) {
+                            continue;
+                        }
+                        sum += in[((size_t)yy * W + xx) * C + c];
+                        pixels++;
+                    }
+                }
+
+                out[((size_t)y * W + x) * C + c] = (unsigned char)(sum / pixels);
+            }
+        }
+    }
+}
+
+void RefPolygon(
+    const unsigned char *in, unsigned char *out, int W, int H, int C, int R, int bands
+) {
+    const int n = bands < 1 ? 1 : bands > R + 1 ? R + 1 : bands;
+    int *span = malloc(sizeof(int) * (R + 1));
+
+    // Half-width of the window at each vertical offset |dy|: the largest w
+    // with w^2 + mid^2 <= R^2, mid being the middle offset of the band holding
+    // |dy|.
+    for (int i = 0; i < n; i++) {
+        const int lo = i * (R + 1) / n;
+        const int hi = (i + 1) * (R + 1) / n - 1;
+        const int mid = (lo + hi + 1) / 2;
+        int w = 0;
+
+        while ((w + 1) * (w + 1) + mid * mid <= R * R) {
+            w++;
+        }
+        for (int dy = lo; dy <= hi; dy++) {
+            span[dy] = w;
+        }
+    }
+
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            for (int c = 0; c < C; c++) {
+                long long sum = 0;
+                int pixels = 0;
+
+                for (int dy = -R; dy <= R; dy++) {
+                    const int w = span[abs(dy)];
+
+                    for (int dx = -w; dx <= w; dx++) {
+                        int yy = y + dy;
+                        int xx = x + dx;
+
+                        if (yy < 0 || yy >= H || xx < 0 || xx >= W) {
+                            continue;
+                        }
+                        sum += in[((size_t)yy * W + xx) * C + c];
+                        pixels++;
+                    }
+                }
+
+                out[((size_t)y * W + x) * C + c] = (unsigned char)(sum / pixels);
+            }
+        }
+    }
+
+    free(span);
+}
+
+void RefConvolve(
+    const unsigned char *in, unsigned char *out, int W, int H, int C,
+    const float *taps, int kw, int kh
+) {
+    const int cx = kw / 2;
+    const int cy = kh / 2;
+
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            for (int c = 0; c < C; c++) {
+                double sum = 0.0;
+
+                for (int i = 0; i < kh; i++) {
+                    for (int j = 0; j < kw; j++) {
+                        int yy = min(max(y + i - cy, 0), H - 1);
+                        int xx = min(max(x + j - cx, 0), W - 1);
+                        sum += (double)taps[i * kw + j] * in[((size_t)yy * W + xx) * C + c];
+                    }
+                }
+
+                sum += 0.5;
+                out[((size_t)y * W + x) * C + c]
+                    = sum < 0.0 ? 0 : sum > 255.0 ? 255 : (unsigned char)sum;
+            }
+        }
+    }
+}
+
+void RefMedian(
+    const unsigned char *in, unsigned char *out, int W, int H, int C, int R
+) {
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            for (int c = 0; c < C; c++) {
+                int counts[256] = { 0 };
+                int pixels = 0;
+
+                for (int yy = max(y - R, 0); yy <= min(y + R, H - 1); yy++) {
+                    for (int xx = max(x - R, 0); xx <= min(x + R, W - 1); xx++) {
+                        counts[in[((size_t)yy * W + xx) * C + c]]++;
+                        pixels++;
+                    }
+                }
+
+                int v = 0, seen = counts[0];
+                while (seen < (pixels + 1) / 2) {
+                    seen += counts[++v];
+                }
+                out[((size_t)y * W + x) * C + c] = v;
+            }
+        }
+    }
+}
+
+void RefClahe(
+    const unsigned char *in, unsigned char *out, int W, int H,
+    int tiles_x, int tiles_y, float clip
+) {
+    const int tx = max(min(tiles_x, W), 1);
+    const int ty = max(min(tiles_y, H), 1);
+    unsigned char *luma = malloc((size_t)W * H);
+    double *maps = malloc(sizeof(double) * tx * ty * 256);
+
+    for (size_t i = 0; i < (size_t)W * H; i++) {
+        luma[i] = (77 * in[3 * i] + 150 * in[3 * i + 1] + 29 * in[3 * i + 2] + 128) >> 8;
+    }
+
+    // Each tile's mapping: its histogram, clipped with the excess spread
+    // evenly over all bins, then the cumulative distribution scaled to 255.
+    for (int j = 0; j < ty; j++) {
+        for (int i = 0; i < tx; i++) {
+            double counts[256] = { 0.0 };
+            int pixels = 0;
+
+            for (int y = j * H / ty; y < (j + 1) * H / ty; y++) {
+                for (int x = i * W / tx; x < (i + 1) * W / tx; x++) {
+                    counts[luma[(size_t)y * W + x]] += 1.0;
+                    pixels++;
+                }
+            }
+
+            if (clip > 0.0f) {
+                const double limit = max(floor((double)clip * pixels / 256), 1.0);
+                double excess = 0.0;
+
+                for (int b = 0; b < 256; b++) {
+                    if (counts[b] > limit) {
+                        excess += counts[b] - limit;
+                        counts[b] = limit;
+                    }
+                }
+                for (int b = 0; b < 256; b++) {
+                    counts[b] += excess / 256;
+                }
+            }
+
+            double sum = 0.0;
+            for (int b = 0; b < 256; b++) {
+                sum += counts[b];
+                maps[(j * tx + i) * 256 + b] = 255.0 * sum / pixels;
+            }
+        }
+    }
+
+    // Each pixel blends the mappings of the four tiles whose centers surround
+    // it, weighted by its distance to them; past the outer centers the
+    // nearest tile counts alone.
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            const double fx = (x + 0.5) * tx / W - 0.5;
+            const double fy = (y + 0.5) * ty / H - 0.5;
+            const int i = (int)floor(fx);
+            const int j = (int)floor(fy);
+            const double ax = fx - i;
+            const double ay = fy - j;
+            const int i0 = max(i, 0), i1 = min(i + 1, tx - 1);
+            const int j0 = max(j, 0), j1 = min(j + 1, ty - 1);
+            const int v = luma[(size_t)y * W + x];
+
+            const double mapped = (1 - ax) * (1 - ay) * maps[(j0 * tx + i0) * 256 + v]
+                                + ax * (1 - ay) * maps[(j0 * tx + i1) * 256 + v]
+                                + (1 - ax) * ay * maps[(j1 * tx + i0) * 256 + v]
+                                + ax * ay * maps[(j1 * tx + i1) * 256 + v];
+            const int delta = (int)floor(mapped + 0.5) - v;
+
+            for (int c = 0; c < 3; c++) {
+                int s = in[((size_t)y * W + x) * 3 + c] + delta;
+                out[((size_t)y * W + x) * 3 + c] = s < 0 ? 0 : s > 255 ? 255 : s;
+            }
+        }
+    }
+
+    free(luma);
+    free(maps);
+}
+
+void RefBilateralGrid(
+    const unsigned char *in, unsigned char *out, int W, int H,
+    int spatial, int range, int radius
+) {
+    const int gw = (W - 1 + spatial / 2) / spatial + 2;
+    const int gh = (H - 1 + spatial / 2) / spatial + 2;
+    const int gd = (255 + range / 2) / range + 2;
+    const size_t cells = (size_t)gw * gh * gd;
+    double *grid = calloc(cells * 4, sizeof(double));
+    double *blur = calloc(cells * 4, sizeof(double));
+
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            const unsigned char *p = in + ((size_t)y * W + x) * 3;
+            int l = (77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8;
+            int gx = (x + spatial / 2) / spatial;
+            int gy = (y + spatial / 2) / spatial;
+            int gz = (l + range / 2) / range;
+            double *cell = grid + (((size_t)gz * gh + gy) * gw + gx) * 4;
+
+            cell[0] += p[0];
+            cell[1] += p[1];
+            cell[2] += p[2];
+            cell[3] += 1.0;
+        }
+    }
+
+    // Box sum of radius `radius` along x, y and z, with nothing outside the
+    // grid.
+    for (int z = 0; z < gd; z++) {
+        for (int y = 0; y < gh; y++) {
+            for (int x = 0; x < gw; x++) {
+                double *sum = blur + (((size_t)z * gh + y) * gw + x) * 4;
+
+                for (int dz = -radius; dz <= radius; dz++) {
+                    if (z + dz < 0 || z + dz >= gd) {
+                        continue;
+                    }
+                    for (int dy = -radius; dy <= radius; dy++) {
+                        for (int dx = -radius; dx <= radius; dx++) {
+                            int yy = y + dy;
+                            int xx = x + dx;
+
+                            if (yy < 0 || yy >= gh || xx < 0 || xx >= gw) {
+                                continue;
+                            }
+                            const double *cell =
+                                grid + (((size_t)(z + dz) * gh + yy) * gw + xx) * 4;
+
+                            for (int k = 0; k < 4; k++) {
+                                sum[k] += cell[k];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            const unsigned char *p = in + ((size_t)y * W + x) * 3;
+            int l = (77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8;
+            double fx = (double)x / spatial, fy = (double)y / spatial, fz = (double)l / range;
+            int x0 = (int)fx, y0 = (int)fy, z0 = (int)fz;
+            double v[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+            for (int corner = 0; corner < 8; corner++) {
+                int cx = corner & 1, cy = corner >> 1 & 1, cz = corner >> 2;
+                double w = (cx ? fx - x0 : 1.0 - (fx - x0))
+                         * (cy ? fy - y0 : 1.0 - (fy - y0))
+                         * (cz ? fz - z0 : 1.0 - (fz - z0));
+                const double *cell =
+                    blur + (((size_t)(z0 + cz) * gh + y0 + cy) * gw + x0 + cx) * 4;
+
+                for (int k = 0; k < 4; k++) {
+                    v[k] += w * cell[k];
+                }
+            }
+            for (int c = 0; c < 3; c++) {
+                int s = v[3] > 0.0 ? (int)(v[c] / v[3] + 0.5) : p[c];
+                out[((size_t)y * W + x) * 3 + c] = min(max(s, 0), 255);
+            }
+        }
+    }
+
+    free(grid);
+    free(blur);
+}
+
+void RefMosaic(
+    const unsigned char *in, unsigned char *out, int W, int H,
+    int block, int align_x, int align_y, int align_roi, const int *rois, int nrois
+) {
+    const int whole[4] = { 0, 0, W - 1, H - 1 };
+
+    for (size_t i = 0; i < (size_t)W * H * 3; i++) {
+        out[i] = in[i];
+    }
+
+    for (int k = 0; k < max(nrois, 1); k++) {
+        const int *roi = nrois ? rois + 4 * k : whole;
+        const int x0 = max(roi[0], 0), y0 = max(roi[1], 0);
+        const int x1 = min(roi[2], W - 1), y1 = min(roi[3], H - 1);
+        const int ox = align_roi ? x0 : align_x;
+        const int oy = align_roi ? y0 : align_y;
+
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                // The square holding (x, y), clipped to the region.
+                const int bx = ox + (int)floor((double)(x - ox) / block) * block;
+                const int by = oy + (int)floor((double)(y - oy) / block) * block;
+                long long sum[3] = { 0, 0, 0 };
+                int pixels = 0;
+
+                for (int yy = max(by, y0); yy <= min(by + block - 1, y1); yy++) {
+                    for (int xx = max(bx, x0); xx <= min(bx + block - 1, x1); xx++) {
+                        for (int c = 0; c < 3; c++) {
+                            sum[c] += in[((size_t)yy * W + xx) * 3 + c];
+                        }
+                        pixels++;
+                    }
+                }
+                for (int c = 0; c < 3; c++) {
+                    out[((size_t)y * W + x) * 3 + c] = sum[c] / pixels;
+                }
+            }
+        }
+    }
+}
+
+void RefMaskBlur(const unsigned char *mask, unsigned char *out, int W, int H, int R) {
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            long long count = 0, pixels = 0;
+
+            for (int yy = max(y - R, 0); yy <= min(y + R, H - 1); yy++) {
+                for (int xx = max(x - R, 0); xx <= min(x + R, W - 1); xx++) {
+                    count += mask[(size_t)yy * W + xx] != 0;
+                    pixels++;
+                }
+            }
+            out[(size_t)y * W + x] = (255 * count + pixels / 2) / pixels;
+        }
+    }
+}
+
+void RefAtlas(
+    const unsigned char *in, unsigned char *out, int W, int H,
+    const int *rects, int n, int R
+) {
+    for (size_t i = 0; i < (size_t)W * H * 3; i++) {
+        out[i] = in[i];
+    }
+
+    for (int k = 0; k < n; k++) {
+        const int x0 = max(rects[4 * k], 0), y0 = max(rects[4 * k + 1], 0);
+        const int x1 = min(rects[4 * k + 2], W - 1), y1 = min(rects[4 * k + 3], H - 1);
+
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                for (int c = 0; c < 3; c++) {
+                    long long sum = 0;
+                    int pixels = 0;
+
+                    for (int yy = max(y - R, y0); yy <= min(y + R, y1); yy++) {
+                        for (int xx = max(x - R, x0); xx <= min(x + R, x1); xx++) {
+                            sum += in[((size_t)yy * W + xx) * 3 + c];
+                            pixels++;
+                        }
+                    }
+                    out[((size_t)y * W + x) * 3 + c] = sum / pixels;
+                }
+            }
+        }
+    }
+}
+
+void RefNcc(
+    const unsigned char *img, int W, int H, const unsigned char *tpl, int tw, int th,
+    double *scores
+) {
+    const int MW = W - tw + 1;
+    const int MH = H - th + 1;
+    const int N = tw * th;
+    double tmean = 0.0;
+
+    for (int i = 0; i < N; i++) {
+        tmean += tpl[3 * i] + tpl[3 * i + 1] + tpl[3 * i + 2];
+    }
+    tmean /= N;
+
+    for (int y = 0; y < MH; y++) {
+        for (int x = 0; x < MW; x++) {
+            double fmean = 0.0, num = 0.0, fvar = 0.0, tvar = 0.0;
+
+            for (int j = 0; j < th; j++) {
+                for (int i = 0; i < tw; i++) {
+                    const unsigned char *p = img + ((size_t)(y + j) * W + x + i) * 3;
+                    fmean += p[0] + p[1] + p[2];
+                }
+            }
+            fmean /= N;
+
+            for (int j = 0; j < th; j++) {
+                for (int i = 0; i < tw; i++) {
+                    const unsigned char *p = img + ((size_t)(y + j) * W + x + i) * 3;
+                    const unsigned char *q = tpl + ((size_t)j * tw + i) * 3;
+                    const double f = p[0] + p[1] + p[2] - fmean;
+                    const double t = q[0] + q[1] + q[2] - tmean;
+
+                    num += f * t;
+                    fvar += f * f;
+                    tvar += t * t;
+                }
+            }
+
+            scores[(size_t)y * MW + x] = fvar > 0.0 && tvar > 0.0 ? num / sqrt(fvar * tvar) : 0.0;
+        }
+    }
+}
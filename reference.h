@@ -0,0 +1,105 @@
+/**
+ * Golden reference implementations.
+ *
+ * Straightforward O(R^2) and O(K^2) versions of what the engines compute,
+ * written for obviousness rather than speed, on interleaved 8-bit images with
+ * any number of channels. The differential checker compares every engine to
+ * them.
+ */
+
+#ifndef REFERENCE_H
+#define REFERENCE_H
+
+typedef enum {
+    REF_SQUARE,     // (2R + 1) x (2R + 1) square.
+    REF_DISK        // Pixels with dx^2 + dy^2 <= R^2.
+} RefShape;
+
+// Mean over the window, shrunk to the part inside the image, truncated in
+// integer arithmetic.
+void RefBlur(
+    const unsigned char *in, unsigned char *out, int width, int height, int channels,
+    int R, RefShape shape
+);
+
+// Mean over a polygonal aperture, shrunk to the part inside the image and
+// truncated: the offsets |dy| <= R are split into n = min(max(bands, 1), R + 1)
+// bands, band i holding [i (R + 1) / n, (i + 1) (R + 1) / n - 1], and every row
+// of a band spans the disk's half-width at the band's middle offset, rounded
+// up. With R + 1 bands this is the disk.
+void RefPolygon(
+    const unsigned char *in, unsigned char *out, int width, int height, int channels,
+    int R, int bands
+);
+
+// Stencil convolution with a kw x kh kernel centered at (kw / 2, kh / 2),
+// clamping coordinates at the borders, in double precision, rounded to
+// nearest and clamped to [0, 255].
+void RefConvolve(
+    const unsigned char *in, unsigned char *out, int width, int height, int channels,
+    const float *taps, int kw, int kh
+);
+
+// Lower median over the (2R + 1) x (2R + 1) square, shrunk to the part inside
+// the image.
+void RefMedian(
+    const unsigned char *in, unsigned char *out, int width, int height, int channels, int R
+);
+
+// CLAHE of the luma (77 R + 150 G + 29 B + 128) / 256 of a 3-channel image,
+// from the definition in double precision: tile histograms counted directly,
+// clipped at clip * pixels / 256 per bin (rounded down, at least 1) with the
+// excess spread evenly over all bins, mapped through their cumulative
+// distribution scaled to 255 and blended bilinearly between tile centers,
+// rounded once at the end. The change of luma is added to every channel.
+void RefClahe(
+    const unsigned char *in, unsigned char *out, int width, int height,
+    int tiles_x, int tiles_y, float clip
+);
+
+// Bilateral grid over (x, y, luma) of a 3-channel image, held whole in double
+// precision: every pixel adds (R, G, B, 1) to its nearest cell, the grid is
+// box-summed with radius `radius` (zero outside the grid along every axis)
+// and each pixel takes the trilinear sums at (x / spatial, y / spatial,
+// luma / range) divided by the count, or keeps its value if the count is
+// zero.
+void RefBilateralGrid(
+    const unsigned char *in, unsigned char *out, int width, int height,
+    int spatial, int range, int radius
+);
+
+// Mosaic of a 3-channel image: within each region (x0, y0, x1, y1), inclusive,
+// or the whole image if `nrois` is 0, every pixel takes the truncated mean of
+// its block x block grid square clipped to the region and the image. The grid
+// starts at (align_x, align_y), or at the region's clipped top-left corner
+// with `align_roi`. Later regions overwrite earlier ones; means come from
+// `in`.
+void RefMosaic(
+    const unsigned char *in, unsigned char *out, int width, int height,
+    int block, int align_x, int align_y, int align_roi, const int *rois, int nrois
+);
+
+// Box blur of each rectangle (x0, y0, x1, y1), inclusive and clipped to the
+// image, with the square clamped to the rectangle; other pixels are copied.
+void RefAtlas(
+    const unsigned char *in, unsigned char *out, int width, int height,
+    const int *rects, int n, int R
+);
+
+// Box blur of a mask, one byte per pixel with nonzero for set: the rounded
+// fraction of set pixels in the (2R + 1) x (2R + 1) square clipped to the
+// image, scaled to [0, 255].
+void RefMaskBlur(const unsigned char *mask, unsigned char *out, int width, int height, int R);
+
+// Normalized cross-correlation of a tw x th template with every window of a
+// 3-channel image, on the signal r + g + b, in double precision: for each
+// top-left corner (x, y), row-major in `scores`, the sum of the products of
+// the window's and the template's deviations from their means, divided by
+// the square root of the product of their sums of squared deviations, or 0 if
+// either is flat.
+void RefNcc(
+    const unsigned char *img, int width, int height, const unsigned char *tpl, int tw, int th,
+    double *scores
+);
+
+#endif
@@ -0,0 +1,211 @@
+/**
+ * Shared-memory frame ring, see ring.h.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "ring.h"
+
+#define RING_MAGIC 0x676e6972u  // "ring"
+#define RING_VERSION 1
+
+// Spins before sleeping; a frame period is far longer, a wake-up much shorter.
+#define RING_SPINS 4096
+
+// Counter of one stage, alone on its cache line so that stages do not
+// invalidate each other's lines.
+typedef struct RingCounter {
+    uint32_t released;      // Frames released by the stage.
+    uint32_t closed;
+    uint32_t events;        // Bumped after each release and on closing; the futex word.
+    uint32_t sleepers;      // Processes asleep on `events`.
+} __attribute__((aligned(64))) RingCounter;
+
+struct RingHeader {
+    uint32_t magic;
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t slots;
+    uint64_t slot_bytes;
+    RingCounter counters[RING_STAGES] __attribute__((aligned(64)));
+};
+
+static long futex(uint32_t *word, int op, uint32_t value) {
+    return syscall(SYS_futex, word, op, value, NULL, NULL, 0);
+}
+
+static inline void cpuRelax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__("pause");
+#endif
+}
+
+static size_t slotBytes(int width, int height) {
+    size_t bytes = sizeof(RingFrame) + (size_t)width * height * 3;
+    return (bytes + 63) & ~(size_t)63;
+}
+
+static RingFrame *slot(const Ring *ring, uint32_t n) {
+    unsigned char *base = (unsigned char *)ring->header + sizeof(RingHeader);
+    return (RingFrame *)(base + (size_t)(n % ring->slots) * ring->header->slot_bytes);
+}
+
+static Ring *map(int fd, size_t bytes) {
+    Ring *ring = malloc(sizeof(Ring));
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    close(fd);
+    if (!ring || p == MAP_FAILED) {
+        free(ring);
+        return NULL;
+    }
+
+    ring->header = p;
+    ring->bytes = bytes;
+    return ring;
+}
+
+Ring *RingCreate(const char *name, int width, int height, int slots) {
+    const size_t bytes = sizeof(RingHeader) + slots * slotBytes(width, height);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    Ring *ring;
+
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, bytes) < 0 || !(ring = map(fd, bytes))) {
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+
+    // The mapping starts zeroed: all counters at 0, nothing closed.
+    ring->header->width = ring->width = width;
+    ring->header->height = ring->height = height;
+    ring->header->slots = ring->slots = slots;
+    ring->header->slot_bytes = slotBytes(width, height);
+    ring->header->version = RING_VERSION;
+    __atomic_store_n(&ring->header->magic, RING_MAGIC, __ATOMIC_RELEASE);
+
+    return ring;
+}
+
+Ring *RingOpen(const char *name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    struct stat st;
+    Ring *ring;
+
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(RingHeader)
+        || !(ring = map(fd, st.st_size))) {
+        close(fd);
+        return NULL;
+    }
+
+    RingHeader *h = ring->header;
+    if (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != RING_MAGIC || h->version != RING_VERSION
+        || sizeof(RingHeader) + h->slots * h->slot_bytes > ring->bytes) {
+        RingDetach(ring);
+        return NULL;
+    }
+    ring->width = h->width;
+    ring->height = h->height;
+    ring->slots = h->slots;
+
+    return ring;
+}
+
+void RingDetach(Ring *ring) {
+    munmap(ring->header, ring->bytes);
+    free(ring);
+}
+
+void RingUnlink(const char *name) {
+    shm_unlink(name);
+}
+
+// Whether `stage` may take its next slot, given the released count of the
+// stage it waits for.
+static int ready(const Ring *ring, RingStage stage, uint32_t waited) {
+    uint32_t own = ring->header->counters[stage].released;
+
+    // Counters wrap; differences stay correct.
+    return stage == RING_PRODUCER
+        ? own - waited < (uint32_t)ring->slots
+        : waited - own > 0;
+}
+
+RingFrame *RingAcquire(Ring *ring, RingStage stage) {
+    const RingStage before = stage == RING_PRODUCER ? RING_CONSUMER : stage - 1;
+    RingCounter *dep = &ring->header->counters[before];
+
+    for (int spin = 0; ; spin++) {
+        // Read before the state it guards: any release or close after this
+        // changes it, so the futex below cannot sleep through one.
+        // `closed` is read before `released` so that frames released before
+        // closing are never missed.
+        uint32_t events = __atomic_load_n(&dep->events, __ATOMIC_SEQ_CST);
+        uint32_t closed = __atomic_load_n(&dep->closed, __ATOMIC_ACQUIRE);
+        uint32_t released = __atomic_load_n(&dep->released, __ATOMIC_ACQUIRE);
+
+        if (ready(ring, stage, released)) {
+            return slot(ring, ring->header->counters[stage].released);
+        }
+        if (stage != RING_PRODUCER && closed) {
+            return NULL;
+        }
+        if (spin < RING_SPINS) {
+            cpuRelax();
+            continue;
+        }
+
+        // Registering before sleeping pairs with the other stage bumping
+        // `events` before checking for sleepers: either it sees us and wakes
+        // us, or the futex sees the new value and returns at once.
+        __atomic_add_fetch(&dep->sleepers, 1, __ATOMIC_SEQ_CST);
+        futex(&dep->events, FUTEX_WAIT, events);
+        __atomic_sub_fetch(&dep->sleepers, 1, __ATOMIC_SEQ_CST);
+        spin = 0;
+    }
+}
+
+// Publish a change of the counter to waiting stages. Only the owning stage
+// writes a counter, so plain increments suffice.
+static void publish(RingCounter *c) {
+    __atomic_store_n(&c->events, c->events + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&c->sleepers, __ATOMIC_SEQ_CST)) {
+        futex(&c->events, FUTEX_WAKE, INT_MAX);
+    }
+}
+
+void RingRelease(Ring *ring, RingStage stage) {
+    RingCounter *c = &ring->header->counters[stage];
+
+    __atomic_store_n(&c->released, c->released + 1, __ATOMIC_RELEASE);
+    publish(c);
+}
+
+void RingClose(Ring *ring, RingStage stage) {
+    RingCounter *c = &ring->header->counters[stage];
+
+    __atomic_store_n(&c->closed, 1, __ATOMIC_RELEASE);
+    publish(c);
+}
+
+Image RingImage(const Ring *ring, RingFrame *frame) {
+    return ImageView(frame->pixels, ring->width, ring->height, ring->width * 3);
+}
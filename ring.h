@@ -0,0 +1,71 @@
+/**
+ * Shared-memory frame ring between processes.
+ *
+ * A ring is a POSIX shared-memory object holding a fixed number of frame
+ * slots, all of the same size, that move through three stages in order: the
+ * producer fills a slot, the blur worker blurs it in place and the consumer
+ * reads the result. Each stage has a counter of the frames it has released,
+ * written by that stage only. Stage s may take the next slot once the stage
+ * before it has released it, and the producer may reuse a slot once the
+ * consumer has. Every counter thus has a single writer and the ring needs no
+ * locks. Pixels are never copied.
+ *
+ * Taking and releasing a slot are plain atomic loads and stores while the
+ * ring is neither full nor empty. A stage that has to wait spins briefly and
+ * then sleeps on a futex on the counter it waits for. The stage advancing that
+ * counter makes the wake-up system call only when someone is asleep.
+ *
+ * Each stage closes its output when it is done. The next stage drains the
+ * frames already released and then gets NULL.
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+
+#include "ppmFile.h"
+
+typedef enum { RING_PRODUCER, RING_WORKER, RING_CONSUMER, RING_STAGES } RingStage;
+
+typedef struct RingHeader RingHeader;
+
+typedef struct RingFrame {
+    uint64_t tag;           // Free for the producer, e.g. a frame number or timestamp.
+    uint64_t reserved[7];   // Pads the pixels to a cache line.
+    unsigned char pixels[];
+} RingFrame;
+
+typedef struct Ring {
+    RingHeader *header;
+    size_t bytes;           // Size of the mapping.
+    int width;
+    int height;
+    int slots;
+} Ring;
+
+// Create and map a ring of `slots` frames of width x height packed RGB pixels.
+// `name` is a shared-memory name such as "/blur". Returns NULL on error.
+Ring *RingCreate(const char *name, int width, int height, int slots);
+
+// Map an existing ring. Returns NULL on error.
+Ring *RingOpen(const char *name);
+
+// Unmap the ring; RingUnlink() removes its name once every process is done.
+void RingDetach(Ring *ring);
+void RingUnlink(const char *name);
+
+// Wait for the next slot of `stage` and return it, or NULL once the previous
+// stage has closed and every frame it released has been taken.
+RingFrame *RingAcquire(Ring *ring, RingStage stage);
+
+// Hand the slot taken last by `stage` to the next stage.
+void RingRelease(Ring *ring, RingStage stage);
+
+// Tell the next stage that `stage` will release no more frames.
+void RingClose(Ring *ring, RingStage stage);
+
+// The pixels of a frame as an image, without copying.
+Image RingImage(const Ring *ring, RingFrame *frame);
+
+#endif
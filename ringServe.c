@@ -0,0 +1,111 @@
+/**
+ * The blur stage of a frame ring, see ringServe.h.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <omp.h>
+
+#include "ringServe.h"
+#include "ring.h"
+#include "sat.h"
+#include "boxBlur.h"
+#include "diskBlur.h"
+
+static void ringUsage(void) {
+    fprintf(stderr,
+        "usage: fast_blur --ring NAME --size WxH [options] R\n"
+        "\n"
+        "Creates the shared-memory ring NAME (e.g. /blur) and blurs each frame a\n"
+        "producer releases into it, in place, for a consumer to read. Stops and\n"
+        "removes the ring when the producer closes it.\n"
+        "\n"
+        "options:\n"
+        "  --slots N      frames in the ring (default 4)\n"
+        "  --disk         blur with a disk of radius R instead of a square\n"
+        "  --layout L     summed-area table layout: rows (default), tiled or\n"
+        "                 interleaved\n");
+    exit(1);
+}
+
+int RingMain(int argc, char *argv[]) {
+    const char *name = NULL;
+    int W = 0, H = 0, slots = 4, disk = 0, R = -1;
+    SatLayout layout = SAT_ROW_MAJOR;
+
+    if (argc < 3) {
+        ringUsage();
+    }
+    name = argv[1];
+    R = atoi(argv[argc - 1]);
+
+    for (int i = 2; i < argc - 1; i++) {
+        const char *opt = argv[i];
+        const char *val = i + 1 < argc - 1 ? argv[i + 1] : NULL;
+
+        if (strcmp(opt, "--disk") == 0) {
+            disk = 1;
+            continue;
+        }
+        if (!val) {
+            ringUsage();
+        } else if (strcmp(opt, "--size") == 0) {
+            if (sscanf(val, "%dx%d", &W, &H) != 2 || W < 1 || H < 1) {
+                ringUsage();
+            }
+        } else if (strcmp(opt, "--slots") == 0) {
+            slots = atoi(val);
+        } else if (strcmp(opt, "--layout") == 0) {
+            layout = SatLayoutFromName(val);
+            if (layout == SAT_LAYOUT_INVALID) {
+                ringUsage();
+            }
+        } else {
+            ringUsage();
+        }
+        i++;
+    }
+    if (!name || W < 1 || R < 0 || slots < 1) {
+        ringUsage();
+    }
+
+    Ring *ring = RingCreate(name, W, H, slots);
+    if (!ring) {
+        fprintf(stderr, "ring: cannot create %s\n", name);
+        exit(1);
+    }
+
+    // One table for the whole stream: nothing is allocated per frame.
+    Sat *sat = SatCreate(W, H, disk ? SAT_ROW_MAJOR : layout);
+    RingFrame *frame;
+    long frames = 0;
+    double busy = 0.0;
+
+    while ((frame = RingAcquire(ring, RING_WORKER))) {
+        Image img = RingImage(ring, frame);
+        double t0 = omp_get_wtime();
+
+        SatRowPass(sat, &img);
+        if (disk) {
+            DiskBlur(&img, sat, R);
+        } else {
+            SatColumnPass(sat);
+            BoxBlur(&img, sat, R);
+        }
+        busy += omp_get_wtime() - t0;
+        frames++;
+
+        RingRelease(ring, RING_WORKER);
+    }
+    RingClose(ring, RING_WORKER);
+
+    fprintf(stderr, "ring: %ld frames, %.3f ms blurring per frame\n",
+            frames, frames ? 1e3 * busy / frames : 0.0);
+
+    SatFree(sat);
+    RingDetach(ring);
+    RingUnlink(name);
+
+    return 0;
+}
@@ -0,0 +1,16 @@
+/**
+ * The blur stage of a frame ring (see ring.h), served by `fast_blur --ring`.
+ *
+ * It creates the ring, takes each frame the producer releases, blurs it in
+ * place with one summed-area table kept for the whole stream and releases it
+ * to the consumer. Producers and consumers link ring.c only.
+ */
+
+#ifndef RING_SERVE_H
+#define RING_SERVE_H
+
+// Entry point of `fast_blur --ring ...`: create a ring and blur its frames in
+// place until the producer closes it. `argv[0]` is the mode.
+int RingMain(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,223 @@
+/**
+ * Memory-bandwidth probe and per-pass roofline report, see roofline.h.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <omp.h>
+
+#include "roofline.h"
+#include "bench.h"
+#include "topology.h"
+#include "tuning.h"
+
+StreamResult StreamProbe(size_t bytes, int reps) {
+    const size_t n = bytes / sizeof(double);
+    double *a = malloc(sizeof(double) * n);
+    double *b = malloc(sizeof(double) * n);
+    double *c = malloc(sizeof(double) * n);
+    const double s = 3.0;
+    StreamResult best = { 0.0, 0.0 };
+
+    if (!a || !b || !c) {
+        fprintf(stderr, "profile: cannot allocate memory for bandwidth probe\n");
+        exit(1);
+    }
+
+    // First touch from the threads that use the data, as in STREAM.
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; i++) {
+        a[i] = 1.0;
+        b[i] = 2.0;
+        c[i] = 0.0;
+    }
+
+    for (int r = 0; r < reps; r++) {
+        double t0 = omp_get_wtime();
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < n; i++) {
+            c[i] = a[i];
+        }
+        double t1 = omp_get_wtime();
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < n; i++) {
+            a[i] = b[i] + s * c[i];
+        }
+        double t2 = omp_get_wtime();
+
+        double copy = 16.0 * n / (t1 - t0) / 1e9;
+        double triad = 24.0 * n / (t2 - t1) / 1e9;
+        best.copy = copy > best.copy ? copy : best.copy;
+        best.triad = triad > best.triad ? triad : best.triad;
+    }
+
+    free(a);
+    free(b);
+    free(c);
+
+    return best;
+}
+
+/**
+ * Time the box passes with one thread per core and with every logical CPU,
+ * keep the faster policy of each pass and save the result. Without SMT both
+ * teams are the same and every pass stays on all CPUs.
+ */
+static void tunePasses(const char *path, const Topology *topo, Image *in, Image *out,
+                       int R, SatLayout layout, int reps) {
+    Tuning tuning;
+    PassTimes t[2];
+
+    TuningDefault(&tuning);
+    TuningStart(&tuning, topo);
+    for (int q = THREADS_ALL; q <= THREADS_CORES; q++) {
+        // Every pass on the team of policy q.
+        tuning.policy[TUNE_ROW] = q;
+        TuningPass(&tuning, TUNE_ROW);
+        t[q] = BenchBoxPasses(in, out, R, layout, reps);
+    }
+    tuning.policy[TUNE_ROW] = THREADS_ALL;
+    TuningStop(&tuning, topo);
+
+    const double all[TUNE_PASSES] = { t[0].row, t[0].column, t[0].evaluate };
+    const double cores[TUNE_PASSES] = { t[1].row, t[1].column, t[1].evaluate };
+
+    fprintf(stderr, "profile: tuning with %d cores, %d CPUs%s\n",
+            tuning.ncores, tuning.ncpus, topo->hybrid ? " (hybrid)" : "");
+    for (int p = 0; p < TUNE_PASSES; p++) {
+        if (tuning.ncores < tuning.ncpus && cores[p] < all[p]) {
+            tuning.policy[p] = THREADS_CORES;
+        }
+        fprintf(stderr, "profile: %-8s cores %.6f s, all %.6f s -> %s\n",
+                TunePassName(p), cores[p], all[p], ThreadPolicyName(tuning.policy[p]));
+    }
+
+    if (TuningSave(path, &tuning) < 0) {
+        fprintf(stderr, "profile: cannot write %s\n", path);
+        exit(1);
+    }
+}
+
+static void profileUsage(void) {
+    fprintf(stderr,
+        "usage: fast_blur --profile [options]\n"
+        "\n"
+        "Measures the sustainable memory bandwidth, then times each pass of the\n"
+        "box blur and prints, as CSV, the bytes it has to move, the bandwidth it\n"
+        "achieves and the fraction of the probed peak that is.\n"
+        "\n"
+        "options:\n"
+        "  --size WxH       image size (default 4096x4096)\n"
+        "  --radius R       blur radius (default 16)\n"
+        "  --reps N         repetitions, the median is kept (default 5)\n"
+        "  --threads N      threads (default all CPUs)\n"
+        "  --smt S          on or off (default on)\n"
+        "  --placement P    compact or scatter (default scatter)\n"
+        "  --layout L       rows, tiled or interleaved (default rows)\n"
+        "  --probe-mb N     size of each probe array in MB (default 128)\n"
+        "  --tuning FILE    also time each pass with one thread per core and with\n"
+        "                   all CPUs and save the faster choice to FILE\n");
+    exit(1);
+}
+
+int ProfileMain(int argc, char *argv[]) {
+    int W = 4096, H = 4096, R = 16, reps = 5, threads = 0, smt = 1, probe_mb = 128;
+    const char *tuning_path = NULL;
+    Placement placement = PLACE_SCATTER;
+    SatLayout layout = SAT_ROW_MAJOR;
+
+    for (int i = 1; i < argc; i++) {
+        const char *opt = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (!val) {
+            profileUsage();
+        } else if (strcmp(opt, "--size") == 0) {
+            if (sscanf(val, "%dx%d", &W, &H) != 2 || W < 1 || H < 1) {
+                profileUsage();
+            }
+        } else if (strcmp(opt, "--radius") == 0) {
+            R = atoi(val);
+        } else if (strcmp(opt, "--reps") == 0) {
+            reps = atoi(val) > 0 ? atoi(val) : 1;
+        } else if (strcmp(opt, "--threads") == 0) {
+            threads = atoi(val);
+        } else if (strcmp(opt, "--smt") == 0) {
+            smt = strcmp(val, "off") != 0;
+        } else if (strcmp(opt, "--placement") == 0) {
+            placement = strcmp(val, "compact") == 0 ? PLACE_COMPACT : PLACE_SCATTER;
+        } else if (strcmp(opt, "--layout") == 0) {
+            layout = SatLayoutFromName(val);
+            if (layout == SAT_LAYOUT_INVALID) {
+                profileUsage();
+            }
+        } else if (strcmp(opt, "--probe-mb") == 0) {
+            probe_mb = atoi(val) > 0 ? atoi(val) : 1;
+        } else if (strcmp(opt, "--tuning") == 0) {
+            tuning_path = val;
+        } else {
+            profileUsage();
+        }
+        i++;
+    }
+
+    Topology *topo = TopologyDetect();
+    int *cpus = malloc(sizeof(int) * topo->ncpus);
+    int n = TopologyOrder(topo, smt, placement, cpus);
+    const int team = omp_get_max_threads();
+    if (threads < 1 || threads > n) {
+        threads = n;
+    }
+    TopologyPin(cpus, threads);
+
+    StreamResult peak = StreamProbe((size_t)probe_mb << 20, 10);
+    const double best = peak.copy > peak.triad ? peak.copy : peak.triad;
+
+    fprintf(stderr, "profile: %d threads, copy %.2f GB/s, triad %.2f GB/s\n",
+            threads, peak.copy, peak.triad);
+
+    Image *in = BenchImage(W, H, 1);
+    Image *out = ImageCreate(W, H);
+    PassTimes t = BenchBoxPasses(in, out, R, layout, reps);
+
+    // Compulsory traffic per pixel, assuming neighbouring pixels of a row stay
+    // cached and nothing else does:
+    //  - row pass: read 3 bytes of image, write 3 ints of sums;
+    //  - column pass: read and write 3 ints (the row above is still cached);
+    //  - evaluate: read 3 ints on each of the two corner rows, write 3 bytes.
+    // Interleaved entries carry a fourth, padding int.
+    const double pixels = (double)W * H;
+    const double entry = layout == SAT_INTERLEAVED ? 4.0 * sizeof(int) : 3.0 * sizeof(int);
+    const char *names[3] = { "row", "column", "evaluate" };
+    const double seconds[3] = { t.row, t.column, t.evaluate };
+    const double bytes[3] = {
+        (3.0 + entry) * pixels, 2.0 * entry * pixels, (2.0 * entry + 3.0) * pixels
+    };
+
+    printf("pass,seconds,bytes,gb_per_s,fraction_of_copy,fraction_of_triad,bound\n");
+    for (int p = 0; p < 3; p++) {
+        double gbs = bytes[p] / seconds[p] / 1e9;
+
+        // Below 60% of the probed peak something other than bandwidth limits
+        // the pass.
+        printf("%s,%.6f,%.0f,%.3f,%.3f,%.3f,%s\n",
+               names[p], seconds[p], bytes[p], gbs, gbs / peak.copy, gbs / peak.triad,
+               gbs >= 0.6 * best ? "bandwidth" : "compute/latency");
+    }
+    printf("probe-copy,,,%.3f,1.000,%.3f,\n", peak.copy, peak.copy / peak.triad);
+    printf("probe-triad,,,%.3f,%.3f,1.000,\n", peak.triad, peak.triad / peak.copy);
+
+    // The profile is timed on the teams a blur would use, not on --threads.
+    TopologyUnpin(topo, team);
+    if (tuning_path) {
+        tunePasses(tuning_path, topo, in, out, R, layout, reps);
+    }
+
+    ImageFree(in);
+    ImageFree(out);
+    TopologyFree(topo);
+    free(cpus);
+
+    return 0;
+}
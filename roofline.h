@@ -0,0 +1,27 @@
+/**
+ * Memory-bandwidth probe and per-pass roofline report.
+ *
+ * The probe runs STREAM-style copy and triad kernels with the same threads and
+ * placement as the blur, giving the bandwidth the host actually sustains. Each
+ * pass of the box blur is then timed and its compulsory traffic divided by its
+ * time; a pass that reaches most of the probed bandwidth is bandwidth-bound,
+ * one that stays well below it is limited by compute or latency.
+ */
+
+#ifndef ROOFLINE_H
+#define ROOFLINE_H
+
+#include <stddef.h>
+
+typedef struct StreamResult {
+    double copy;    // GB/s of c[i] = a[i], counting 16 bytes per element.
+    double triad;   // GB/s of a[i] = b[i] + s * c[i], counting 24 bytes.
+} StreamResult;
+
+// Best of `reps` runs over arrays of `bytes` each, with the current threads.
+StreamResult StreamProbe(size_t bytes, int reps);
+
+// Entry point of `fast_blur --profile ...`; `argv[0]` is the mode.
+int ProfileMain(int argc, char *argv[]);
+
+#endif
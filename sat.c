@@ -0,0 +1,226 @@
+/**
+ * Summed-area tables, see sat.h.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <omp.h>
+
+#include "sat.h"
+#include "memTrack.h"
+
+Sat *SatTryCreate(int width, int height, SatLayout layout) {
+    Sat *sat = MemCalloc(1, sizeof(Sat));
+    size_t n = (size_t)width * height;
+
+    if (!sat) {
+        return NULL;
+    }
+
+    sat->width = width;
+    sat->height = height;
+    sat->layout = layout;
+    sat->tiles_x = (width + SAT_TILE - 1) >> SAT_TILE_SHIFT;
+
+    // Tiles on the right and bottom edges are allocated whole.
+    if (layout == SAT_TILED) {
+        int tiles_y = (height + SAT_TILE - 1) >> SAT_TILE_SHIFT;
+        n = ((size_t)sat->tiles_x * tiles_y) << (2 * SAT_TILE_SHIFT);
+    }
+    // Allocations are 16-byte aligned, so interleaved entries are too.
+    if (layout == SAT_INTERLEAVED) {
+        sat->sums_r = MemAlloc(sizeof(int) * SAT_LANES * n);
+        sat->sums_g = sat->sums_r + 1;
+        sat->sums_b = sat->sums_r + 2;
+    } else {
+        sat->sums_r = MemAlloc(sizeof(int) * n);
+        sat->sums_g = MemAlloc(sizeof(int) * n);
+        sat->sums_b = MemAlloc(sizeof(int) * n);
+    }
+
+    if (!sat->sums_r || !sat->sums_g || !sat->sums_b) {
+        SatFree(sat);
+        return NULL;
+    }
+
+    return sat;
+}
+
+Sat *SatCreate(int width, int height, SatLayout layout) {
+    Sat *sat = SatTryCreate(width, height, layout);
+
+    if (!sat) {
+        fprintf(stderr, "sat: cannot allocate memory for summed-area table\n");
+        exit(1);
+    }
+
+    return sat;
+}
+
+void SatFree(Sat *sat) {
+    MemFree(sat->sums_r);
+    if (sat->layout != SAT_INTERLEAVED) {
+        MemFree(sat->sums_g);
+        MemFree(sat->sums_b);
+    }
+    MemFree(sat);
+}
+
+SatLayout SatLayoutFromName(const char *name) {
+    return strcmp(name, "rows") == 0        ? SAT_ROW_MAJOR
+         : strcmp(name, "tiled") == 0       ? SAT_TILED
+         : strcmp(name, "interleaved") == 0 ? SAT_INTERLEAVED
+         :                                    SAT_LAYOUT_INVALID;
+}
+
+// Interleaved rows accumulate all channels of a pixel in one vector; the
+// padding lane stays zero.
+static void rowPassInterleaved(Sat *sat, Image *img, int row0, int row1) {
+    const int W = sat->width;
+
+    for (int row = row0; row < row1; row++) {
+        const unsigned char *p = img->data + (size_t)row * img->stride;
+        SatVec *sums = (SatVec *)(sat->sums_r + SatIndex(sat, row, 0));
+        SatVec sum = { 0, 0, 0, 0 };
+
+        for (int col = 0; col < W; col++, p += 3) {
+            SatVec pixel = { p[0], p[1], p[2], 0 };
+            sums[col] = sum += pixel;
+        }
+    }
+}
+
+// The image pixel is accessed here to avoid performing an additional pixel
+// traversal in a separate double-for-loop structure to initialize the sums_*
+// matrices with image pixels.
+// A row is written in segments that are contiguous in the table's layout: the
+// whole row when row-major, SAT_TILE entries when tiled.
+void SatRowPassBand(Sat *sat, Image *img, int row0, int row1) {
+    const int W = sat->width;
+    const int segment = sat->layout == SAT_TILED ? SAT_TILE : W;
+
+    if (sat->layout == SAT_INTERLEAVED) {
+        rowPassInterleaved(sat, img, row0, row1);
+        return;
+    }
+
+    for (int row = row0; row < row1; row++) {
+        int sum_r = 0;
+        int sum_g = 0;
+        int sum_b = 0;
+
+        for (int c0 = 0; c0 < W; c0 += segment) {
+            const size_t offset = SatIndex(sat, row, c0);
+            int *sums_r = sat->sums_r + offset - c0;
+            int *sums_g = sat->sums_g + offset - c0;
+            int *sums_b = sat->sums_b + offset - c0;
+
+            for (int col = c0; col < c0 + segment && col < W; col++) {
+                sums_r[col] = sum_r += ImageGetPixel(img, col, row, 0);
+                sums_g[col] = sum_g += ImageGetPixel(img, col, row, 1);
+                sums_b[col] = sum_b += ImageGetPixel(img, col, row, 2);
+            }
+        }
+    }
+}
+
+void SatRowPass(Sat *sat, Image *img) {
+    const int H = sat->height;
+
+    #pragma omp parallel for schedule(static, 4)
+    for (int row = 0; row < H; row++) {
+        SatRowPassBand(sat, img, row, row + 1);
+    }
+}
+
+// In the tiled layout each thread takes a column of tiles and walks it
+// row by row; the row above is then SAT_TILE entries back, or in the tile above
+// at the top of a tile, and the inner loop vectorizes across the tile's width.
+static void columnPassTiled(Sat *sat) {
+    const int H = sat->height;
+    const int W = sat->width;
+
+    #pragma omp parallel for schedule(static, 1)
+    for (int tx = 0; tx < sat->tiles_x; tx++) {
+        const int c0 = tx << SAT_TILE_SHIFT;
+        const int n = W - c0 < SAT_TILE ? W - c0 : SAT_TILE;
+
+        for (int row = 1; row < H; row++) {
+            const size_t cur = SatIndex(sat, row, c0);
+            const size_t above = SatIndex(sat, row - 1, c0);
+
+            for (int color = 0; color < 3; color++) {
+                int *restrict dst = SatPlane(sat, color) + cur;
+                const int *restrict src = SatPlane(sat, color) + above;
+
+                for (int i = 0; i < n; i++) {
+                    dst[i] += src[i];
+                }
+            }
+        }
+    }
+}
+
+// Adds to each entry the sum of the entry above it (which already contains the
+// sum of all pixels above and to its left), resulting in the sum of all pixels
+// from (0, 0) to the current pixel.
+// We can transpose the sums to avoid accessing in column-major direction, but
+// experimentally, it was slower than performing this computation in
+// column-major. If transposing is done, the data must be transposed again to
+// get it back to the original layout after the computation on the columns is
+// done.
+void SatColumnPass(Sat *sat) {
+    const int W = sat->width;
+
+    if (sat->layout == SAT_TILED) {
+        columnPassTiled(sat);
+        return;
+    }
+
+    // Interleaved rows are split into one strip of columns per thread, each
+    // walked row by row: the row above is then still in cache and the inner
+    // loop streams through contiguous entries.
+    if (sat->layout == SAT_INTERLEAVED) {
+        #pragma omp parallel
+        {
+            const int T = omp_get_num_threads();
+            const int t = omp_get_thread_num();
+            SatColumnPassBand(sat, (int)((long)W * t / T), (int)((long)W * (t + 1) / T));
+        }
+        return;
+    }
+
+    #pragma omp parallel for schedule(static, 4)
+    for (int col = 0; col < W; col++) {
+        SatColumnPassBand(sat, col, col + 1);
+    }
+}
+
+void SatColumnPassBand(Sat *sat, int col0, int col1) {
+    const int H = sat->height;
+    const int W = sat->width;
+    int *sums_r = sat->sums_r;
+    int *sums_g = sat->sums_g;
+    int *sums_b = sat->sums_b;
+
+    if (sat->layout == SAT_INTERLEAVED) {
+        for (int row = 1; row < H; row++) {
+            SatVec *restrict dst = (SatVec *)(sums_r + SatIndex(sat, row, 0));
+            const SatVec *restrict src = dst - W;
+
+            for (int col = col0; col < col1; col++) {
+                dst[col] += src[col];
+            }
+        }
+        return;
+    }
+
+    for (int col = col0; col < col1; col++) {
+        for (int row = 1; row < H; row++) {
+            sums_r[idx(row, col, W, 1)] += sums_r[idx(row - 1, col, W, 1)];
+            sums_g[idx(row, col, W, 1)] += sums_g[idx(row - 1, col, W, 1)];
+            sums_b[idx(row, col, W, 1)] += sums_b[idx(row - 1, col, W, 1)];
+        }
+    }
+}
@@ -0,0 +1,142 @@
+/**
+ * Summed-area tables (integral images) for RGB images.
+ *
+ * A table is built in two passes so that both can be parallelized: the row
+ * pass leaves, in every entry, the sum of the pixels left of and including it
+ * in its row; the column pass then accumulates those row sums downwards so that
+ * every entry holds the sum of the rectangle from (0, 0) to the pixel.
+ *
+ * Engines that only need horizontal spans (e.g. the disk blur) can stop after
+ * the row pass.
+ *
+ * Planes are either row-major or tiled. In the tiled layout the plane is a
+ * row-major grid of SAT_TILE x SAT_TILE blocks, each stored row-major, so
+ * vertical neighbours and the four corners of a lookup 2R rows apart stay
+ * within a few pages instead of one page per row. Conversion between layouts
+ * is fused into the passes: the row pass reads the row-major image and writes
+ * the table's layout, and engines write row-major output.
+ *
+ * The interleaved layout is row-major but stores the three channels of an
+ * entry next to each other, padded to four ints: a corner lookup is then one
+ * 16-byte load serving all channels, and the arithmetic on the corners runs on
+ * all channels at once. The planes point into the one array at offsets 0, 1
+ * and 2 and SatIndex() scales by SAT_LANES, so code indexing planes works on
+ * every layout.
+ */
+
+#ifndef SAT_H
+#define SAT_H
+
+#include <stddef.h>
+
+#include "ppmFile.h"
+
+// Side of a tile in the tiled layout; a tile of ints is 16KB, four pages.
+#define SAT_TILE_SHIFT 6
+#define SAT_TILE (1 << SAT_TILE_SHIFT)
+
+// Ints per entry in the interleaved layout: red, green, blue and padding.
+#define SAT_LANES 4
+
+typedef enum { SAT_LAYOUT_INVALID = -1, SAT_ROW_MAJOR, SAT_TILED, SAT_INTERLEAVED } SatLayout;
+
+// An entry of the interleaved layout.
+typedef int SatVec __attribute__((vector_size(SAT_LANES * sizeof(int))));
+
+typedef struct Sat {
+    int width;
+    int height;
+    SatLayout layout;
+    int tiles_x;    // Tiles per row of tiles, in the tiled layout.
+
+    // One plane per color channel; in the interleaved layout, the channels of
+    // a single array.
+    int *sums_r;
+    int *sums_g;
+    int *sums_b;
+} Sat;
+
+/**
+ * Get linear index from a (row, col) for a linearly allocated 2D array.
+ */
+static inline int idx(int row, int col, int width, int g) {
+    return (row * width + col) * g;
+}
+
+// Allocate a table for an image of the given size. Contents are undefined
+// until SatRowPass() has been run.
+Sat *SatCreate(int width, int height, SatLayout layout);
+void SatFree(Sat *sat);
+
+// Same as SatCreate(), but returns NULL if memory runs out.
+Sat *SatTryCreate(int width, int height, SatLayout layout);
+
+// Layout named rows, tiled or interleaved, or SAT_LAYOUT_INVALID for any
+// other name.
+SatLayout SatLayoutFromName(const char *name);
+
+// Return the plane of the given color channel (0 = red, 1 = green, 2 = blue).
+static inline int *SatPlane(const Sat *sat, int color) {
+    return color == 0 ? sat->sums_r
+         : color == 1 ? sat->sums_g
+         :              sat->sums_b;
+}
+
+// Position of (row, col) in a plane.
+static inline size_t SatIndex(const Sat *sat, int row, int col) {
+    if (sat->layout == SAT_TILED) {
+        size_t tile = (size_t)(row >> SAT_TILE_SHIFT) * sat->tiles_x
+                    + (col >> SAT_TILE_SHIFT);
+        return (tile << (2 * SAT_TILE_SHIFT))
+             + ((row & (SAT_TILE - 1)) << SAT_TILE_SHIFT)
+             + (col & (SAT_TILE - 1));
+    }
+    if (sat->layout == SAT_INTERLEAVED) {
+        return ((size_t)row * sat->width + col) * SAT_LANES;
+    }
+    return (size_t)row * sat->width + col;
+}
+
+// First pass: per-row prefix sums of the image pixels.
+void SatRowPass(Sat *sat, Image *img);
+
+// Second pass: turns the row prefix sums into full rectangle sums.
+void SatColumnPass(Sat *sat);
+
+// The passes restricted to rows [row0, row1) or columns [col0, col1), on the
+// calling thread only, for callers that schedule the work themselves. A table
+// is complete once the bands cover the image. The column band is for the
+// row-major and interleaved layouts only.
+void SatRowPassBand(Sat *sat, Image *img, int row0, int row1);
+void SatColumnPassBand(Sat *sat, int col0, int col1);
+
+// Sum of the pixels of one channel in the inclusive rectangle
+// [x_min, x_max] x [y_min, y_max]. Only valid after SatColumnPass().
+static inline int SatRectSum(
+    const Sat *sat, const int *sums, int x_min, int y_min, int x_max, int y_max
+) {
+    int a = y_min < 1 || x_min < 1 ? 0 : sums[SatIndex(sat, y_min - 1, x_min - 1)];
+    int b = y_min < 1 ? 0 : sums[SatIndex(sat, y_min - 1, x_max)];
+    int c = x_min < 1 ? 0 : sums[SatIndex(sat, y_max, x_min - 1)];
+    int d = sums[SatIndex(sat, y_max, x_max)];
+
+    return d - (b + c - a);
+}
+
+// All channels of entry (row, col) of an interleaved table.
+static inline SatVec SatEntry(const Sat *sat, int row, int col) {
+    return *(const SatVec *)(sat->sums_r + SatIndex(sat, row, col));
+}
+
+// Mean of `pixels` values summing to `sum`, truncated. Under -Ofast a division
+// by a loop-invariant count becomes a multiply by its reciprocal, which can
+// land one off an exact quotient; the integer fixup makes the result exact.
+static inline unsigned char SatMean(int sum, int pixels) {
+    int s = (float)sum / pixels;
+
+    s += (s + 1) * pixels <= sum;
+    s -= s * pixels > sum;
+    return s;
+}
+
+#endif
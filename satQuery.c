@@ -0,0 +1,91 @@
+/**
+ * Batched rectangle sums, see satQuery.h.
+ */
+
+#include "satQuery.h"
+
+#define min(X, Y) (((X) < (Y)) ? (X) : (Y))
+#define max(X, Y) (((X) < (Y)) ? (Y) : (X))
+
+// Queries handed to a thread at a time; large enough to amortize scheduling,
+// small enough to balance batches of mixed rectangle sizes.
+#define QUERY_CHUNK 1024
+
+// Entry (row, col) of all channels; zero above or left of the image.
+static inline SatVec corner(const Sat *sat, int row, int col) {
+    const SatVec zero = { 0, 0, 0, 0 };
+
+    if (row < 0 || col < 0) {
+        return zero;
+    }
+    if (sat->layout == SAT_INTERLEAVED) {
+        return SatEntry(sat, row, col);
+    }
+
+    const size_t i = SatIndex(sat, row, col);
+    SatVec v = { sat->sums_r[i], sat->sums_g[i], sat->sums_b[i], 0 };
+    return v;
+}
+
+// Channel sums of the rectangle, clamped to the image.
+static inline SatVec rectSum(const Sat *sat, SatRect r) {
+    const SatVec zero = { 0, 0, 0, 0 };
+    const int x0 = max(r.x0, 0);
+    const int y0 = max(r.y0, 0);
+    const int x1 = min(r.x1, sat->width - 1);
+    const int y1 = min(r.y1, sat->height - 1);
+
+    if (x0 > x1 || y0 > y1) {
+        return zero;
+    }
+
+    SatVec a = corner(sat, y0 - 1, x0 - 1);
+    SatVec b = corner(sat, y0 - 1, x1);
+    SatVec c = corner(sat, y1, x0 - 1);
+    SatVec d = corner(sat, y1, x1);
+
+    return d - (b + c - a);
+}
+
+static inline void store(int *sums, SatVec v) {
+    sums[0] = v[0];
+    sums[1] = v[1];
+    sums[2] = v[2];
+}
+
+// Each rectangle is looked up on its own. Gathering the corners of a batch
+// of rectangles per plane was tried: GCC emulates the gathers for the default
+// tuning, which made queries 2.3-2.8x slower, and hardware gathers gained 7%
+// on a cached table but lost 20% on one in DRAM, where the loads are misses
+// either way.
+void SatQuery(const Sat *sat, const SatRect *rects, size_t n, int *sums) {
+    #pragma omp parallel for schedule(static, QUERY_CHUNK)
+    for (size_t i = 0; i < n; i++) {
+        store(sums + 3 * i, rectSum(sat, rects[i]));
+    }
+}
+
+void SatSweep(
+    const Sat *sat, const SatTemplate *tpl,
+    int x0, int y0, int step_x, int step_y, int nx, int ny, int *sums
+) {
+    #pragma omp parallel for schedule(static, 4)
+    for (int j = 0; j < ny; j++) {
+        const int y = y0 + j * step_y;
+
+        for (int i = 0; i < nx; i++) {
+            const int x = x0 + i * step_x;
+            SatVec acc = { 0, 0, 0, 0 };
+
+            for (int k = 0; k < tpl->count; k++) {
+                SatRect r = tpl->rects[k];
+                r.x0 += x;
+                r.x1 += x;
+                r.y0 += y;
+                r.y1 += y;
+                acc += tpl->weights[k] * rectSum(sat, r);
+            }
+            store(sums + 3 * ((size_t)j * nx + i), acc);
+        }
+    }
+}
@@ -0,0 +1,49 @@
+/**
+ * Batched rectangle sums over a built summed-area table.
+ *
+ * Once SatRowPass() and SatColumnPass() have run, the sum of any rectangle
+ * costs four lookups per channel. These functions answer many rectangles at
+ * once, split over the OpenMP threads: an arbitrary batch, or a template of
+ * weighted rectangles (e.g. a Haar-like feature) swept over a grid of window
+ * positions.
+ *
+ * Every result holds the three channel sums, red, green and blue, next to each
+ * other. Rectangles are clamped to the image; one entirely outside sums to 0.
+ * With the interleaved layout each corner is a single vector load for all
+ * channels, otherwise the corners are read from each plane in turn.
+ */
+
+#ifndef SAT_QUERY_H
+#define SAT_QUERY_H
+
+#include <stddef.h>
+
+#include "sat.h"
+
+// Inclusive rectangle [x0, x1] x [y0, y1].
+typedef struct SatRect {
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+} SatRect;
+
+// Weighted rectangles relative to a window's top-left corner.
+typedef struct SatTemplate {
+    const SatRect *rects;
+    const int *weights;
+    int count;
+} SatTemplate;
+
+// Sums of `n` rectangles into `sums`, 3 ints per rectangle.
+void SatQuery(const Sat *sat, const SatRect *rects, size_t n, int *sums);
+
+// The template's weighted sum at windows (x0 + i * step_x, y0 + j * step_y)
+// for 0 <= i < nx, 0 <= j < ny, into `sums`, 3 ints per window in row-major
+// order of the windows.
+void SatSweep(
+    const Sat *sat, const SatTemplate *tpl,
+    int x0, int y0, int step_x, int step_y, int nx, int ny, int *sums
+);
+
+#endif
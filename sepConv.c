@@ -0,0 +1,193 @@
+/**
+ * Separable convolution, see sepConv.h.
+ *
+ * Both passes are written with the tap loop outside and the pixel loop inside
+ * so that each tap is a multiply-add over consecutive floats, which the
+ * compiler vectorizes. Columns are processed in strips so that the output
+ * strip stays in L1 while all taps are applied to it. The vertical pass reads
+ * whole rows, so one vector covers many columns at once and no column-major
+ * traversal is needed.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sepConv.h"
+#include "planes.h"
+#include "memTrack.h"
+
+#define min(X, Y) (((X) < (Y)) ? (X) : (Y))
+#define max(X, Y) (((X) < (Y)) ? (Y) : (X))
+
+// Columns per strip; 512 floats of output is 2KB.
+#define STRIP 512
+
+int KernelParse(const char *spec, Kernel1D *kernel) {
+    int n = 1;
+    for (const char *p = spec; *p; p++) {
+        n += *p == ',';
+    }
+    if (n % 2 == 0) {
+        return -1;
+    }
+
+    float *taps = MemAlloc(sizeof(float) * n);
+    float sum = 0.0f;
+    const char *p = spec;
+
+    for (int i = 0; i < n; i++) {
+        char *end;
+        taps[i] = strtof(p, &end);
+        if (end == p || (*end != ',' && *end != '\0')) {
+            MemFree(taps);
+            return -1;
+        }
+        sum += taps[i];
+        p = end + 1;
+    }
+
+    if (sum != 0.0f) {
+        for (int i = 0; i < n; i++) {
+            taps[i] /= sum;
+        }
+    }
+
+    kernel->radius = n / 2;
+    kernel->taps = taps;
+    return 0;
+}
+
+void KernelFree(Kernel1D *kernel) {
+    MemFree(kernel->taps);
+    kernel->taps = NULL;
+}
+
+/**
+ * Horizontal pass of one row. `pad` holds the row with `r` clamped pixels on
+ * each side.
+ */
+static void convolveRow(
+    float *restrict out, const float *restrict pad, int W, const Kernel1D *k
+) {
+    const int n = 2 * k->radius + 1;
+
+    for (int c0 = 0; c0 < W; c0 += STRIP) {
+        const int c1 = min(c0 + STRIP, W);
+
+        for (int col = c0; col < c1; col++) {
+            out[col] = 0.0f;
+        }
+        for (int t = 0; t < n; t++) {
+            const float tap = k->taps[t];
+            const float *p = pad + t;
+
+            for (int col = c0; col < c1; col++) {
+                out[col] += tap * p[col];
+            }
+        }
+    }
+}
+
+int SepConvTryPlane(
+    float *dst, const float *src, float *tmp, int W, int H,
+    const Kernel1D *kx, const Kernel1D *ky
+) {
+    const int rx = kx->radius;
+    const int ry = ky->radius;
+    int failed = 0;
+
+    #pragma omp parallel
+    {
+        // A thread without a row buffer takes part in the loop but skips
+        // its rows.
+        float *pad = MemAlloc(sizeof(float) * (W + 2 * rx));
+
+        if (!pad) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for schedule(static, 4)
+        for (int row = 0; row < H; row++) {
+            const float *in = src + (size_t)row * W;
+
+            if (!pad) {
+                continue;
+            }
+
+            for (int i = 0; i < rx; i++) {
+                pad[i] = in[0];
+                pad[rx + W + i] = in[W - 1];
+            }
+            memcpy(pad + rx, in, sizeof(float) * W);
+
+            convolveRow(tmp + (size_t)row * W, pad, W, kx);
+        }
+
+        MemFree(pad);
+    }
+
+    if (failed) {
+        return -1;
+    }
+
+    // The barrier at the end of the parallel region above guarantees all of
+    // `tmp` is written before any row reads its neighbours.
+    #pragma omp parallel for schedule(static, 4)
+    for (int row = 0; row < H; row++) {
+        float *restrict out = dst + (size_t)row * W;
+
+        for (int c0 = 0; c0 < W; c0 += STRIP) {
+            const int c1 = min(c0 + STRIP, W);
+
+            for (int col = c0; col < c1; col++) {
+                out[col] = 0.0f;
+            }
+            for (int t = 0; t <= 2 * ry; t++) {
+                const float tap = ky->taps[t];
+                const int r = min(max(row + t - ry, 0), H - 1);
+                const float *restrict in = tmp + (size_t)r * W;
+
+                for (int col = c0; col < c1; col++) {
+                    out[col] += tap * in[col];
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+void SepConvPlane(
+    float *dst, const float *src, float *tmp, int W, int H,
+    const Kernel1D *kx, const Kernel1D *ky
+) {
+    if (SepConvTryPlane(dst, src, tmp, W, H, kx, ky) < 0) {
+        fprintf(stderr, "sepconv: cannot allocate memory for row buffer\n");
+        exit(1);
+    }
+}
+
+void SepConv(Image *img_in, Image *img_out, const Kernel1D *kx, const Kernel1D *ky) {
+    const int H = img_in->height;
+    const int W = img_in->width;
+
+    float *planes = PlanesCreate(W, H);
+    float *tmp = MemAlloc(sizeof(float) * (size_t)W * H);
+
+    if (!tmp) {
+        fprintf(stderr, "sepconv: cannot allocate memory for intermediate plane\n");
+        exit(1);
+    }
+
+    PlanesFromImage(planes, img_in);
+    for (int color = 0; color < 3; color++) {
+        float *plane = PlanesChannel(planes, W, H, color);
+        SepConvPlane(plane, plane, tmp, W, H, kx, ky);
+    }
+    PlanesToImage(img_out, planes);
+
+    MemFree(tmp);
+    MemFree(planes);
+}
@@ -0,0 +1,41 @@
+/**
+ * Separable convolution with arbitrary 1D kernels.
+ *
+ * The image is convolved with one kernel along the rows and another along the
+ * columns, clamping at the borders. Kernels are centered and have an odd
+ * number of taps.
+ */
+
+#ifndef SEP_CONV_H
+#define SEP_CONV_H
+
+#include "ppmFile.h"
+
+typedef struct Kernel1D {
+    int radius;     // The kernel has 2 * radius + 1 taps.
+    float *taps;
+} Kernel1D;
+
+// Parse a comma separated list of taps, e.g. "1,4,6,4,1". Taps are normalized
+// to sum to 1 unless they sum to 0. Returns 0 on success and -1 if the list is
+// malformed or has an even number of taps.
+int KernelParse(const char *spec, Kernel1D *kernel);
+void KernelFree(Kernel1D *kernel);
+
+// Convolve one plane. `tmp` must hold `width * height` floats; `src` and `dst`
+// may not overlap with it but may be the same plane.
+void SepConvPlane(
+    float *dst, const float *src, float *tmp, int width, int height,
+    const Kernel1D *kx, const Kernel1D *ky
+);
+
+// Same as SepConvPlane(), but returns -1 instead of exiting if its row
+// buffers cannot be allocated (`dst` is then left unwritten), 0 on success.
+int SepConvTryPlane(
+    float *dst, const float *src, float *tmp, int width, int height,
+    const Kernel1D *kx, const Kernel1D *ky
+);
+
+void SepConv(Image *img_in, Image *img_out, const Kernel1D *kx, const Kernel1D *ky);
+
+#endif
@@ -0,0 +1,893 @@
+/**
+ * Tiled image container, see tiledFile.h.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tiledFile.h"
+#include "sat.h"
+#include "boxBlur.h"
+#include "journal.h"
+#include "memTrack.h"
+
+#define min(X, Y) (((X) < (Y)) ? (X) : (Y))
+#define max(X, Y) (((X) < (Y)) ? (Y) : (X))
+
+// QOI chunk tags; see https://qoiformat.org/qoi-specification.pdf.
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xc0
+#define QOI_OP_RGB 0xfe
+#define QOI_OP_RGBA 0xff
+#define QOI_MASK 0xc0
+#define QOI_HEADER 14
+#define QOI_PADDING 8
+
+static const unsigned char qoiEnd[QOI_PADDING] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+static void fail(const char *path, const char *message) {
+    fprintf(stderr, "tiled: %s: %s\n", path, message);
+    exit(1);
+}
+
+// Offset of the first tile: the header and index, rounded to a cache line.
+static size_t dataStart(int tiles) {
+    return (sizeof(TiledHeader) + sizeof(TiledEntry) * tiles + 63) & ~(size_t)63;
+}
+
+static inline int qoiHash(const unsigned char *px) {
+    return (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+}
+
+static inline void putBig32(unsigned char *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static inline uint32_t getBig32(const unsigned char *p) {
+    return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+// Bytes of the largest QOI image of w x h RGB pixels.
+static size_t qoiBound(int w, int h) {
+    return QOI_HEADER + (size_t)w * h * 4 + QOI_PADDING;
+}
+
+/**
+ * Encode w x h RGB pixels as a QOI image into `out`, which holds qoiBound()
+ * bytes, and return its size. Pixels are opaque RGBA to the codec.
+ */
+static size_t qoiEncode(const unsigned char *pixels, int w, int h, int stride, unsigned char *out) {
+    unsigned char index[64][4] = { { 0 } };
+    unsigned char prev[4] = { 0, 0, 0, 255 };
+    size_t n = QOI_HEADER;
+    int run = 0;
+
+    memcpy(out, "qoif", 4);
+    putBig32(out + 4, w);
+    putBig32(out + 8, h);
+    out[12] = 3;
+    out[13] = 0;
+
+    for (int y = 0; y < h; y++) {
+        const unsigned char *row = pixels + (size_t)y * stride;
+
+        for (int x = 0; x < w; x++) {
+            const unsigned char px[4] = { row[3 * x], row[3 * x + 1], row[3 * x + 2], 255 };
+
+            if (memcmp(px, prev, 4) == 0) {
+                run++;
+                if (run == 62 || (y == h - 1 && x == w - 1)) {
+                    out[n++] = QOI_OP_RUN | (run - 1);
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0) {
+                out[n++] = QOI_OP_RUN | (run - 1);
+                run = 0;
+            }
+
+            const int slot = qoiHash(px);
+
+            if (memcmp(index[slot], px, 4) == 0) {
+                out[n++] = QOI_OP_INDEX | slot;
+            } else {
+                const signed char vr = px[0] - prev[0];
+                const signed char vg = px[1] - prev[1];
+                const signed char vb = px[2] - prev[2];
+                const signed char vg_r = vr - vg;
+                const signed char vg_b = vb - vg;
+
+                memcpy(index[slot], px, 4);
+                if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                    out[n++] = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+                } else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8) {
+                    out[n++] = QOI_OP_LUMA | (vg + 32);
+                    out[n++] = (vg_r + 8) << 4 | (vg_b + 8);
+                } else {
+                    out[n++] = QOI_OP_RGB;
+                    out[n++] = px[0];
+                    out[n++] = px[1];
+                    out[n++] = px[2];
+                }
+            }
+            memcpy(prev, px, 4);
+        }
+    }
+
+    memcpy(out + n, qoiEnd, QOI_PADDING);
+    return n + QOI_PADDING;
+}
+
+/**
+ * Decode a QOI image of `bytes` bytes, which must be w x h, into RGB
+ * `pixels`. Returns 0, or -1 if the image is malformed or truncated.
+ */
+static int qoiDecode(const unsigned char *data, size_t bytes, int w, int h,
+                     unsigned char *pixels, int stride) {
+    unsigned char index[64][4] = { { 0 } };
+    unsigned char px[4] = { 0, 0, 0, 255 };
+    size_t p = QOI_HEADER;
+    int run = 0;
+
+    if (bytes < QOI_HEADER + QOI_PADDING || memcmp(data, "qoif", 4) != 0
+        || getBig32(data + 4) != (uint32_t)w || getBig32(data + 8) != (uint32_t)h
+        || (data[12] != 3 && data[12] != 4)) {
+        return -1;
+    }
+    bytes -= QOI_PADDING;
+
+    for (int y = 0; y < h; y++) {
+        unsigned char *row = pixels + (size_t)y * stride;
+
+        for (int x = 0; x < w; x++) {
+            if (run > 0) {
+                run--;
+            } else {
+                if (p >= bytes) {
+                    return -1;
+                }
+
+                const int b1 = data[p++];
+
+                if (b1 == QOI_OP_RGB || b1 == QOI_OP_RGBA) {
+                    const int n = b1 == QOI_OP_RGB ? 3 : 4;
+
+                    if (p + n > bytes) {
+                        return -1;
+                    }
+                    memcpy(px, data + p, n);
+                    p += n;
+                } else if ((b1 & QOI_MASK) == QOI_OP_INDEX) {
+                    memcpy(px, index[b1], 4);
+                } else if ((b1 & QOI_MASK) == QOI_OP_DIFF) {
+                    px[0] += ((b1 >> 4) & 3) - 2;
+                    px[1] += ((b1 >> 2) & 3) - 2;
+                    px[2] += (b1 & 3) - 2;
+                } else if ((b1 & QOI_MASK) == QOI_OP_LUMA) {
+                    if (p >= bytes) {
+                        return -1;
+                    }
+
+                    const int b2 = data[p++];
+                    const int vg = (b1 & 0x3f) - 32;
+
+                    px[0] += vg - 8 + ((b2 >> 4) & 0x0f);
+                    px[1] += vg;
+                    px[2] += vg - 8 + (b2 & 0x0f);
+                } else {
+                    run = b1 & 0x3f;
+                }
+                memcpy(index[qoiHash(px)], px, 4);
+            }
+
+            row[3 * x] = px[0];
+            row[3 * x + 1] = px[1];
+            row[3 * x + 2] = px[2];
+        }
+    }
+
+    return 0;
+}
+
+static void tileCount(int width, int height, int tile, int *tiles_x, int *tiles_y) {
+    *tiles_x = (width + tile - 1) / tile;
+    *tiles_y = (height + tile - 1) / tile;
+}
+
+void TiledTileBounds(const TiledFile *tf, int t, int *x0, int *y0, int *w, int *h) {
+    *x0 = t % tf->tiles_x * tf->tile;
+    *y0 = t / tf->tiles_x * tf->tile;
+    *w = min(tf->tile, tf->width - *x0);
+    *h = min(tf->tile, tf->height - *y0);
+}
+
+// A job id unlikely to repeat: from the kernel's entropy pool, or failing
+// that from the time and process.
+static uint64_t newJob(void) {
+    uint64_t job;
+
+    if (getentropy(&job, sizeof(job)) != 0) {
+        struct timespec now;
+
+        clock_gettime(CLOCK_REALTIME, &now);
+        job = ((uint64_t)now.tv_sec << 32 ^ now.tv_nsec) * 0x9e3779b97f4a7c15ull ^ getpid();
+    }
+    return job ? job : 1;
+}
+
+// Journal of a job writing `path`, see journal.h.
+static char *journalPath(const char *path) {
+    char *journal = MemAlloc(strlen(path) + sizeof(".journal"));
+
+    if (!journal) {
+        fail(path, "cannot allocate memory");
+    }
+    sprintf(journal, "%s.journal", path);
+    return journal;
+}
+
+// Job id of the tiled file at `path`, or 0 if there is none.
+static uint64_t fileJob(const char *path) {
+    TiledHeader header;
+    int fd = open(path, O_RDONLY);
+    ssize_t n = fd < 0 ? -1 : pread(fd, &header, sizeof(header), 0);
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (n != sizeof(header) || header.magic != TILED_MAGIC || header.version != TILED_VERSION) {
+        return 0;
+    }
+    return header.job;
+}
+
+TiledFile *TiledCreate(const char *path, int width, int height, int tile, TiledCodec codec) {
+    TiledFile *tf = MemCalloc(1, sizeof(TiledFile));
+    char *journal = journalPath(path);
+
+    if (!tf) {
+        fail(path, "cannot allocate memory");
+    }
+    if (width < 1 || height < 1 || tile < 1) {
+        fail(path, "image and tiles must be at least 1x1");
+    }
+
+    tf->width = width;
+    tf->height = height;
+    tf->tile = tile;
+    tf->codec = codec;
+    tf->writable = 1;
+    tileCount(width, height, tile, &tf->tiles_x, &tf->tiles_y);
+
+    const int tiles = tf->tiles_x * tf->tiles_y;
+    size_t end = dataStart(tiles);
+
+    // Raw tiles are laid out in index order and the whole file is mapped;
+    // QOI tiles go past the end, so only the header and index are.
+    if (codec == TILED_RAW) {
+        end += (size_t)width * height * 3;
+    }
+    tf->mapped = codec == TILED_RAW ? end : dataStart(tiles);
+
+    // A journal must never outlive the file it describes.
+    JournalRemove(journal);
+    MemFree(journal);
+
+    tf->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (tf->fd < 0) {
+        fail(path, "cannot create file");
+    }
+    if (ftruncate(tf->fd, end) != 0) {
+        fail(path, "cannot size file");
+    }
+    tf->map = mmap(NULL, tf->mapped, PROT_READ | PROT_WRITE, MAP_SHARED, tf->fd, 0);
+    if (tf->map == MAP_FAILED) {
+        fail(path, "cannot map file");
+    }
+
+    tf->header = (TiledHeader *)tf->map;
+    tf->index = (TiledEntry *)(tf->map + sizeof(TiledHeader));
+    tf->header->magic = TILED_MAGIC;
+    tf->header->version = TILED_VERSION;
+    tf->header->width = width;
+    tf->header->height = height;
+    tf->header->tile = tile;
+    tf->header->codec = codec;
+    tf->header->end = end;
+    tf->header->job = newJob();
+
+    if (codec == TILED_RAW) {
+        size_t offset = dataStart(tiles);
+
+        for (int t = 0; t < tiles; t++) {
+            int x0, y0, w, h;
+
+            TiledTileBounds(tf, t, &x0, &y0, &w, &h);
+            tf->index[t].offset = offset;
+            offset += (size_t)w * h * 3;
+        }
+    }
+
+    return tf;
+}
+
+/**
+ * Map an existing file. Writers map it read-write and have entries past the
+ * end of the file, left by a crash, cleared rather than rejected.
+ */
+static TiledFile *openFile(const char *path, int writable) {
+    TiledFile *tf = MemCalloc(1, sizeof(TiledFile));
+    struct stat st;
+
+    if (!tf) {
+        fail(path, "cannot allocate memory");
+    }
+
+    tf->writable = writable;
+    tf->fd = open(path, writable ? O_RDWR : O_RDONLY);
+    if (tf->fd < 0) {
+        fail(path, "cannot open file");
+    }
+    if (fstat(tf->fd, &st) != 0 || (size_t)st.st_size < sizeof(TiledHeader)) {
+        fail(path, "not a tiled image file");
+    }
+
+    tf->mapped = st.st_size;
+    tf->map = mmap(NULL, tf->mapped, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                   MAP_SHARED, tf->fd, 0);
+    if (tf->map == MAP_FAILED) {
+        fail(path, "cannot map file");
+    }
+
+    const TiledHeader *hdr = (const TiledHeader *)tf->map;
+
+    if (hdr->magic != TILED_MAGIC || hdr->version != TILED_VERSION) {
+        fail(path, "not a tiled image file");
+    }
+    if (hdr->width < 1 || hdr->width > IMAGE_STREAM_MAX || hdr->height < 1
+        || hdr->height > IMAGE_STREAM_MAX || hdr->tile < 1
+        || (hdr->codec != TILED_RAW && hdr->codec != TILED_QOI)) {
+        fail(path, "corrupt header");
+    }
+
+    tf->header = (TiledHeader *)tf->map;
+    tf->index = (TiledEntry *)(tf->map + sizeof(TiledHeader));
+    tf->width = hdr->width;
+    tf->height = hdr->height;
+    tf->tile = hdr->tile;
+    tf->codec = hdr->codec;
+    tileCount(tf->width, tf->height, tf->tile, &tf->tiles_x, &tf->tiles_y);
+
+    const int tiles = tf->tiles_x * tf->tiles_y;
+
+    if (tf->mapped < dataStart(tiles)) {
+        fail(path, "truncated index");
+    }
+    if (tf->codec == TILED_RAW && tf->mapped < dataStart(tiles) + (size_t)tf->width * tf->height * 3) {
+        fail(path, "truncated tiles");
+    }
+    for (int t = 0; t < tiles; t++) {
+        TiledEntry *e = tf->index + t;
+
+        if (e->bytes && (e->offset > tf->mapped || e->bytes > tf->mapped - e->offset)) {
+            if (!writable) {
+                fail(path, "tile past the end of the file");
+            }
+            e->bytes = 0;
+        }
+    }
+
+    // Appends go after everything in the file, whether or not the header's
+    // count of it reached the disk.
+    if (writable && tf->header->end < tf->mapped) {
+        tf->header->end = tf->mapped;
+    }
+
+    return tf;
+}
+
+TiledFile *TiledOpen(const char *path) {
+    return openFile(path, 0);
+}
+
+TiledFile *TiledOpenUpdate(const char *path) {
+    return openFile(path, 1);
+}
+
+void TiledSync(TiledFile *tf) {
+    if (msync(tf->map, tf->mapped, MS_SYNC) != 0 || fdatasync(tf->fd) != 0) {
+        fprintf(stderr, "tiled: cannot sync file\n");
+        exit(1);
+    }
+}
+
+void TiledClose(TiledFile *tf) {
+    munmap(tf->map, tf->mapped);
+    close(tf->fd);
+    MemFree(tf);
+}
+
+void TiledReadTile(const TiledFile *tf, int t, unsigned char *pixels, int stride) {
+    const TiledEntry *e = tf->index + t;
+    int x0, y0, w, h;
+
+    TiledTileBounds(tf, t, &x0, &y0, &w, &h);
+    if (e->bytes == 0) {
+        fprintf(stderr, "tiled: tile %d has not been written\n", t);
+        exit(1);
+    }
+
+    if (tf->codec == TILED_RAW) {
+        if (e->bytes != (size_t)w * h * 3) {
+            fprintf(stderr, "tiled: tile %d is corrupt\n", t);
+            exit(1);
+        }
+        for (int y = 0; y < h; y++) {
+            memcpy(pixels + (size_t)y * stride, tf->map + e->offset + (size_t)y * w * 3, (size_t)w * 3);
+        }
+    } else if (qoiDecode(tf->map + e->offset, e->bytes, w, h, pixels, stride) != 0) {
+        fprintf(stderr, "tiled: tile %d is corrupt\n", t);
+        exit(1);
+    }
+}
+
+void TiledWriteTile(TiledFile *tf, int t, const unsigned char *pixels, int stride) {
+    TiledEntry *e = tf->index + t;
+    int x0, y0, w, h;
+
+    TiledTileBounds(tf, t, &x0, &y0, &w, &h);
+
+    if (tf->codec == TILED_RAW) {
+        for (int y = 0; y < h; y++) {
+            memcpy(tf->map + e->offset + (size_t)y * w * 3, pixels + (size_t)y * stride, (size_t)w * 3);
+        }
+        __atomic_store_n(&e->bytes, (uint64_t)w * h * 3, __ATOMIC_RELEASE);
+        return;
+    }
+
+    unsigned char *buffer = MemAlloc(qoiBound(w, h));
+
+    if (!buffer) {
+        fprintf(stderr, "tiled: cannot allocate memory for tile %d\n", t);
+        exit(1);
+    }
+
+    const size_t bytes = qoiEncode(pixels, w, h, stride, buffer);
+    const uint64_t offset = __atomic_fetch_add(&tf->header->end, bytes, __ATOMIC_RELAXED);
+
+    for (size_t done = 0; done < bytes;) {
+        ssize_t n = pwrite(tf->fd, buffer + done, bytes - done, offset + done);
+
+        if (n <= 0) {
+            fprintf(stderr, "tiled: cannot write tile %d\n", t);
+            exit(1);
+        }
+        done += n;
+    }
+    MemFree(buffer);
+
+    e->offset = offset;
+    __atomic_store_n(&e->bytes, bytes, __ATOMIC_RELEASE);
+}
+
+void TiledReadRegion(const TiledFile *tf, int x0, int y0, int w, int h,
+                     unsigned char *pixels, int stride) {
+    const int T = tf->tile;
+    unsigned char *scratch = NULL;
+
+    for (int ty = y0 / T; ty <= (y0 + h - 1) / T; ty++) {
+        for (int tx = x0 / T; tx <= (x0 + w - 1) / T; tx++) {
+            const int t = ty * tf->tiles_x + tx;
+            int bx, by, bw, bh;
+
+            TiledTileBounds(tf, t, &bx, &by, &bw, &bh);
+
+            // The part of the tile inside the region.
+            const int ox0 = max(bx, x0);
+            const int oy0 = max(by, y0);
+            const int ox1 = min(bx + bw, x0 + w);
+            const int oy1 = min(by + bh, y0 + h);
+            unsigned char *dst = pixels + (size_t)(oy0 - y0) * stride + 3 * (ox0 - x0);
+
+            if (tf->codec == TILED_RAW && tf->index[t].bytes == (size_t)bw * bh * 3) {
+                const unsigned char *src = tf->map + tf->index[t].offset
+                                         + ((size_t)(oy0 - by) * bw + (ox0 - bx)) * 3;
+
+                for (int y = oy0; y < oy1; y++) {
+                    memcpy(dst + (size_t)(y - oy0) * stride, src + (size_t)(y - oy0) * bw * 3,
+                           (size_t)(ox1 - ox0) * 3);
+                }
+            } else if (ox0 == bx && oy0 == by && ox1 == bx + bw && oy1 == by + bh) {
+                TiledReadTile(tf, t, dst, stride);
+            } else {
+                if (!scratch) {
+                    scratch = MemAlloc((size_t)T * T * 3);
+                    if (!scratch) {
+                        fprintf(stderr, "tiled: cannot allocate memory for a tile\n");
+                        exit(1);
+                    }
+                }
+                TiledReadTile(tf, t, scratch, bw * 3);
+                for (int y = oy0; y < oy1; y++) {
+                    memcpy(dst + (size_t)(y - oy0) * stride,
+                           scratch + ((size_t)(y - by) * bw + (ox0 - bx)) * 3,
+                           (size_t)(ox1 - ox0) * 3);
+                }
+            }
+        }
+    }
+
+    MemFree(scratch);
+}
+
+void TiledBlurRegion(const TiledFile *tf, int R, int x0, int y0, int w, int h,
+                     unsigned char *pixels, int stride) {
+    // Everything within R of the region; windows of the region's pixels are
+    // then clamped by this source exactly where they are by the image.
+    const int sx0 = max(x0 - R, 0);
+    const int sy0 = max(y0 - R, 0);
+    const int sx1 = min(x0 + w + R, tf->width);
+    const int sy1 = min(y0 + h + R, tf->height);
+    Image *src = ImageCreate(sx1 - sx0, sy1 - sy0);
+    Image *dst = ImageCreate(sx1 - sx0, sy1 - sy0);
+    Sat *sat = SatCreate(sx1 - sx0, sy1 - sy0, SAT_INTERLEAVED);
+
+    TiledReadRegion(tf, sx0, sy0, sx1 - sx0, sy1 - sy0, src->data, src->stride);
+    SatRowPassBand(sat, src, 0, src->height);
+    SatColumnPassBand(sat, 0, src->width);
+    BoxBlurBand(dst, sat, R, y0 - sy0, y0 - sy0 + h);
+
+    for (int y = 0; y < h; y++) {
+        memcpy(pixels + (size_t)y * stride,
+               dst->data + (size_t)(y0 - sy0 + y) * dst->stride + 3 * (x0 - sx0), (size_t)w * 3);
+    }
+
+    SatFree(sat);
+    ImageFree(src);
+    ImageFree(dst);
+}
+
+void TiledBlur(const TiledFile *in, TiledFile *out, int R) {
+    const int tiles = in->tiles_x * in->tiles_y;
+    int *all = MemAlloc(sizeof(int) * tiles);
+
+    if (!all) {
+        fprintf(stderr, "tiled: cannot allocate memory for %d tiles\n", tiles);
+        exit(1);
+    }
+    for (int t = 0; t < tiles; t++) {
+        all[t] = t;
+    }
+    TiledBlurTiles(in, out, R, all, tiles);
+
+    MemFree(all);
+}
+
+void TiledBlurTiles(const TiledFile *in, TiledFile *out, int R, const int *tiles, int n) {
+    #pragma omp parallel
+    {
+        unsigned char *pixels = MemAlloc((size_t)in->tile * in->tile * 3);
+
+        if (!pixels) {
+            fprintf(stderr, "tiled: cannot allocate memory for a tile\n");
+            exit(1);
+        }
+
+        #pragma omp for schedule(dynamic)
+        for (int i = 0; i < n; i++) {
+            const int t = tiles[i];
+            int x0, y0, w, h;
+
+            TiledTileBounds(in, t, &x0, &y0, &w, &h);
+            TiledBlurRegion(in, R, x0, y0, w, h, pixels, w * 3);
+            TiledWriteTile(out, t, pixels, w * 3);
+        }
+
+        MemFree(pixels);
+    }
+}
+
+/**
+ * Write the region [x0, x0 + w) x [y0, y0 + h) of `tf` to `fp` as raw PPM
+ * rows, blurred with radius R unless R is negative. A band of one row of
+ * tiles is held at a time, its tiles decoded or blurred in parallel.
+ */
+static void streamRegion(const TiledFile *tf, int R, int x0, int y0, int w, int h, FILE *fp) {
+    const int T = tf->tile;
+    unsigned char *band = MemAlloc((size_t)w * T * 3);
+
+    if (!band) {
+        fprintf(stderr, "tiled: cannot allocate memory for a band of %d rows\n", T);
+        exit(1);
+    }
+
+    ImageWriteHeader(fp, w, h);
+    for (int y = y0; y < y0 + h; y = (y / T + 1) * T) {
+        const int rows = min((y / T + 1) * T, y0 + h) - y;
+        const int first = x0 / T;
+        const int last = (x0 + w - 1) / T;
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int tx = first; tx <= last; tx++) {
+            const int px0 = max(tx * T, x0);
+            const int px1 = min((tx + 1) * T, x0 + w);
+            unsigned char *dst = band + 3 * (px0 - x0);
+
+            if (R < 0) {
+                TiledReadRegion(tf, px0, y, px1 - px0, rows, dst, w * 3);
+            } else {
+                TiledBlurRegion(tf, R, px0, y, px1 - px0, rows, dst, w * 3);
+            }
+        }
+
+        if (fwrite(band, 3, (size_t)w * rows, fp) != (size_t)w * rows) {
+            fprintf(stderr, "tiled: cannot write image data\n");
+            exit(1);
+        }
+    }
+
+    MemFree(band);
+}
+
+/**
+ * Convert a raw PPM stream into a tiled file, a band of one row of tiles at a
+ * time.
+ */
+static void pack(const char *in_path, const char *out_path, int tile, TiledCodec codec) {
+    FILE *fp = fopen(in_path, "r");
+    int W, H;
+
+    if (!fp) {
+        fail(in_path, "cannot open file");
+    }
+    ImageReadHeader(fp, &W, &H);
+
+    TiledFile *tf = TiledCreate(out_path, W, H, tile, codec);
+    unsigned char *band = MemAlloc((size_t)W * tile * 3);
+
+    if (!band) {
+        fprintf(stderr, "tiled: cannot allocate memory for a band of %d rows\n", tile);
+        exit(1);
+    }
+
+    for (int ty = 0; ty < tf->tiles_y; ty++) {
+        const int rows = min(tile, H - ty * tile);
+
+        if (fread(band, 3, (size_t)W * rows, fp) != (size_t)W * rows) {
+            fail(in_path, "cannot read image data");
+        }
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int tx = 0; tx < tf->tiles_x; tx++) {
+            TiledWriteTile(tf, ty * tf->tiles_x + tx, band + (size_t)tx * tile * 3, W * 3);
+        }
+    }
+
+    MemFree(band);
+    TiledClose(tf);
+    fclose(fp);
+}
+
+// What a journal must match to resume a blur: the input file, unchanged, the
+// parameters and the very output file it was written for. Fields are 64-bit
+// so that the key has no padding.
+typedef struct BlurJobKey {
+    int64_t input_inode;
+    int64_t input_bytes;
+    int64_t input_mtime_sec;
+    int64_t input_mtime_nsec;
+    int64_t tile;
+    int64_t codec;
+    int64_t radius;
+    uint64_t output_job;    // Job id of the output the journal belongs to.
+} BlurJobKey;
+
+/**
+ * Blur `in` into a tiled file at `out_path`, restartably: finished tiles are
+ * recorded in `out_path`.journal every `batch` tiles, after the output has
+ * been synced, and a rerun of the same job resumes from the journal. The
+ * journal is removed when the output is complete.
+ */
+static void blurJob(const char *in_path, const TiledFile *in, const char *out_path,
+                    int R, TiledCodec codec, int batch) {
+    const int tiles = in->tiles_x * in->tiles_y;
+    char *journal_path = journalPath(out_path);
+    unsigned char *done = MemAlloc(tiles);
+    int *todo = MemAlloc(sizeof(int) * tiles);
+    BlurJobKey key;
+    struct stat st;
+    int recorded, n = 0;
+
+    if (!done || !todo) {
+        fprintf(stderr, "tiled: cannot allocate memory for %d tiles\n", tiles);
+        exit(1);
+    }
+    if (stat(in_path, &st) != 0) {
+        fail(in_path, "cannot stat file");
+    }
+
+    memset(&key, 0, sizeof(key));
+    key.input_inode = st.st_ino;
+    key.input_bytes = st.st_size;
+    key.input_mtime_sec = st.st_mtim.tv_sec;
+    key.input_mtime_nsec = st.st_mtim.tv_nsec;
+    key.tile = in->tile;
+    key.codec = codec;
+    key.radius = R;
+    key.output_job = fileJob(out_path);
+
+    Journal *journal = JournalOpen(journal_path, &key, sizeof(key), tiles, done, &recorded);
+    TiledFile *out;
+
+    if (journal) {
+        out = TiledOpenUpdate(out_path);
+        if (out->width != in->width || out->height != in->height || out->tile != in->tile
+            || out->codec != codec) {
+            fail(out_path, "does not match its journal; remove the journal to start over");
+        }
+        fprintf(stderr, "tiled: resuming %s with %d of %d tiles done\n", out_path, recorded, tiles);
+    } else {
+        // The empty output must be durable before a journal refers to it.
+        out = TiledCreate(out_path, in->width, in->height, in->tile, codec);
+        TiledSync(out);
+        key.output_job = out->header->job;
+        journal = JournalCreate(journal_path, &key, sizeof(key), tiles);
+    }
+
+    // Tiles written but not recorded before a crash are redone from scratch.
+    for (int t = 0; t < tiles; t++) {
+        if (!done[t]) {
+            out->index[t].bytes = 0;
+            todo[n++] = t;
+        }
+    }
+
+    for (int i = 0; i < n; i += batch) {
+        const int m = min(batch, n - i);
+
+        TiledBlurTiles(in, out, R, todo + i, m);
+        TiledSync(out);
+        JournalCommit(journal, todo + i, m);
+    }
+
+    TiledClose(out);
+    JournalFinish(journal);
+
+    MemFree(journal_path);
+    MemFree(done);
+    MemFree(todo);
+}
+
+static void tiledUsage(void) {
+    fprintf(stderr,
+        "usage: fast_blur --tiled pack [--tile N] [--codec C] input.ppm output.fbt\n"
+        "       fast_blur --tiled unpack [--region X,Y,WxH] input.fbt output.ppm\n"
+        "       fast_blur --tiled blur [--region X,Y,WxH] [--codec C] R input.fbt output\n"
+        "\n"
+        "Convert between raw PPM and the tiled container, and box blur tiled\n"
+        "images reading only the tiles needed. blur writes a tiled file, or with\n"
+        "--region a raw PPM of the region.\n"
+        "\n"
+        "options:\n"
+        "  --tile N          side of a tile in pixels (default 256)\n"
+        "  --codec C         tile codec, raw or qoi (default raw; for blur, the\n"
+        "                    input's)\n"
+        "  --region X,Y,WxH  only the region with top-left corner (X, Y)\n"
+        "  --sync-every N    for blur to a tiled file: record finished tiles in\n"
+        "                    output.journal every N tiles, so that an interrupted\n"
+        "                    run resumes when rerun; 0 for no journal (default 256)\n");
+    exit(1);
+}
+
+int TiledMain(int argc, char *argv[]) {
+    if (argc < 2) {
+        tiledUsage();
+    }
+
+    const char *command = argv[1];
+    const int positional = strcmp(command, "blur") == 0 ? 3 : 2;
+    int tile = 256, codec = -1, region = 0, sync_every = 256;
+    int rx = 0, ry = 0, rw = 0, rh = 0;
+
+    if (strcmp(command, "pack") != 0 && strcmp(command, "unpack") != 0
+        && strcmp(command, "blur") != 0) {
+        tiledUsage();
+    }
+    if (argc < 2 + positional) {
+        tiledUsage();
+    }
+    for (int i = 2; i < argc - positional; i++) {
+        const char *opt = argv[i];
+        const char *val = i + 1 < argc - positional ? argv[i + 1] : NULL;
+
+        if (!val) {
+            tiledUsage();
+        } else if (strcmp(opt, "--tile") == 0) {
+            tile = atoi(val);
+        } else if (strcmp(opt, "--codec") == 0) {
+            codec = strcmp(val, "qoi") == 0 ? TILED_QOI
+                  : strcmp(val, "raw") == 0 ? TILED_RAW
+                  : (tiledUsage(), 0);
+        } else if (strcmp(opt, "--sync-every") == 0) {
+            sync_every = atoi(val);
+        } else if (strcmp(opt, "--region") == 0) {
+            if (sscanf(val, "%d,%d,%dx%d", &rx, &ry, &rw, &rh) != 4) {
+                tiledUsage();
+            }
+            region = 1;
+        } else {
+            tiledUsage();
+        }
+        i++;
+    }
+    if (tile < 1 || sync_every < 0) {
+        tiledUsage();
+    }
+
+    const char *in_path = argv[argc - 2];
+    const char *out_path = argv[argc - 1];
+
+    if (strcmp(command, "pack") == 0) {
+        pack(in_path, out_path, tile, codec < 0 ? TILED_RAW : codec);
+        return 0;
+    }
+
+    int R = -1;
+    if (strcmp(command, "blur") == 0) {
+        char *end;
+        const long radius = strtol(argv[argc - 3], &end, 10);
+
+        if (*end != '\0' || radius < 0 || radius > 32767) {
+            tiledUsage();
+        }
+        R = radius;
+    }
+
+    TiledFile *in = TiledOpen(in_path);
+
+    if (!region) {
+        rw = in->width;
+        rh = in->height;
+    }
+    if (rx < 0 || ry < 0 || rw < 1 || rh < 1 || rw > in->width - rx || rh > in->height - ry) {
+        fprintf(stderr, "tiled: region %d,%d,%dx%d is not inside the %dx%d image\n",
+                rx, ry, rw, rh, in->width, in->height);
+        return 1;
+    }
+
+    if (R >= 0 && !region && sync_every > 0) {
+        blurJob(in_path, in, out_path, R, codec < 0 ? in->codec : codec, sync_every);
+    } else if (R >= 0 && !region) {
+        TiledFile *out = TiledCreate(out_path, in->width, in->height, in->tile,
+                                     codec < 0 ? in->codec : codec);
+        TiledBlur(in, out, R);
+        TiledClose(out);
+    } else {
+        FILE *fp = fopen(out_path, "w");
+
+        if (!fp) {
+            fail(out_path, "cannot create file");
+        }
+        streamRegion(in, R, rx, ry, rw, rh, fp);
+        if (fclose(fp) != 0) {
+            fail(out_path, "cannot write file");
+        }
+    }
+
+    TiledClose(in);
+    return 0;
+}
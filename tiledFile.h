@@ -0,0 +1,119 @@
+/**
+ * Tiled image container for random access and out-of-core processing.
+ *
+ * A raw PPM is row-major, so a region of a huge image means one seek per
+ * row. A tiled file instead holds the image as `tile` x `tile` RGB tiles, the
+ * last column and row cropped to the image, that can be located directly:
+ *
+ *     header      TiledHeader, 64 bytes
+ *     index       one TiledEntry per tile, row-major over the tile grid
+ *     tiles       the tiles' bytes at the offsets given by the index
+ *
+ * All fields are little-endian. A tile is stored raw (row-major RGB) or as a
+ * complete QOI image. Raw tiles have fixed offsets, so a new raw file is sized
+ * up front and tiles are written straight into its mapping. QOI tiles vary in
+ * size and are appended at the end, each at an offset reserved atomically, so
+ * threads may write different tiles concurrently with either codec. A tile
+ * whose entry is still zero has not been written.
+ *
+ * Readers map the whole file and decode only the tiles a region touches.
+ */
+
+#ifndef TILED_FILE_H
+#define TILED_FILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ppmFile.h"
+
+#define TILED_MAGIC 0x69746266u     // "fbti"
+#define TILED_VERSION 1
+
+typedef enum { TILED_RAW, TILED_QOI } TiledCodec;
+
+typedef struct TiledHeader {
+    uint32_t magic;
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t tile;           // Side of a tile in pixels.
+    int32_t codec;
+    uint64_t end;           // Bytes in use; QOI tiles are appended here.
+    uint64_t job;           // Random id drawn when the file is created.
+    uint64_t reserved[3];
+} TiledHeader;
+
+typedef struct TiledEntry {
+    uint64_t offset;        // From the start of the file.
+    uint64_t bytes;         // 0 until the tile is written.
+} TiledEntry;
+
+typedef struct TiledFile {
+    int width;
+    int height;
+    int tile;
+    int tiles_x;            // Tiles per row and column of the grid.
+    int tiles_y;
+    TiledCodec codec;
+    int fd;
+    int writable;
+    unsigned char *map;     // The header and index, and for readers and raw
+    size_t mapped;          // writers all of the file.
+    TiledHeader *header;
+    TiledEntry *index;
+} TiledFile;
+
+// Create a file for an image of the given size, with all tiles unwritten and
+// a new job id. A completion journal left next to `path` (see journal.h) is
+// removed first, since it describes the file being replaced.
+TiledFile *TiledCreate(const char *path, int width, int height, int tile, TiledCodec codec);
+
+// Open an existing file for reading; exits if it is not a valid tiled file.
+TiledFile *TiledOpen(const char *path);
+
+// Open an existing file for writing more tiles, e.g. to resume a job. Index
+// entries pointing past the end of the file are cleared.
+TiledFile *TiledOpenUpdate(const char *path);
+
+// Make every tile written so far, and the index, durable.
+void TiledSync(TiledFile *tf);
+
+void TiledClose(TiledFile *tf);
+
+// Tile number of the tile holding pixel (x, y), and the bounds of tile `t`.
+static inline int TiledTileAt(const TiledFile *tf, int x, int y) {
+    return (y / tf->tile) * tf->tiles_x + x / tf->tile;
+}
+void TiledTileBounds(const TiledFile *tf, int t, int *x0, int *y0, int *w, int *h);
+
+// Decode tile `t` into `pixels`, rows `stride` bytes apart. Exits if the tile
+// has not been written or is corrupt.
+void TiledReadTile(const TiledFile *tf, int t, unsigned char *pixels, int stride);
+
+// Encode tile `t` from `pixels`, rows `stride` bytes apart. Tiles are written
+// once each; different tiles may be written from different threads.
+void TiledWriteTile(TiledFile *tf, int t, const unsigned char *pixels, int stride);
+
+// Read the region [x0, x0 + w) x [y0, y0 + h), which must lie inside the
+// image, into `pixels`, touching only the tiles that overlap it.
+void TiledReadRegion(const TiledFile *tf, int x0, int y0, int w, int h,
+                     unsigned char *pixels, int stride);
+
+// Box blur of radius R of the region [x0, x0 + w) x [y0, y0 + h), clamped to
+// the whole image as BoxBlur() is, reading only the tiles within R of it.
+// Runs on the calling thread.
+void TiledBlurRegion(const TiledFile *tf, int R, int x0, int y0, int w, int h,
+                     unsigned char *pixels, int stride);
+
+// Blur every tile of `in` into `out`, which has the same size and tiling, in
+// parallel over the tiles.
+void TiledBlur(const TiledFile *in, TiledFile *out, int R);
+
+// Same for the `n` tiles listed in `tiles` only.
+void TiledBlurTiles(const TiledFile *in, TiledFile *out, int R, const int *tiles, int n);
+
+// Entry point of `fast_blur --tiled ...`; `argv[0]` is the mode.
+int TiledMain(int argc, char *argv[]);
+
+#endif
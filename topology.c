@@ -0,0 +1,221 @@
+/**
+ * CPU topology and thread placement, see topology.h.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sched.h>
+#include <omp.h>
+
+#include "topology.h"
+
+/**
+ * Read an integer from a sysfs file, or return `fallback` if it is missing.
+ */
+static int readSysInt(int cpu, const char *name, int fallback) {
+    char path[128];
+    int value;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return fallback;
+    }
+    if (fscanf(fp, "%d", &value) != 1) {
+        value = fallback;
+    }
+    fclose(fp);
+
+    return value;
+}
+
+/**
+ * Whether `cpu` is in the CPU list (e.g. "0-7,16") in the file at `path`;
+ * -1 if the file is missing.
+ */
+static int inCpuList(const char *path, int cpu) {
+    FILE *fp = fopen(path, "r");
+    int lo, hi, found = 0;
+
+    if (!fp) {
+        return -1;
+    }
+    while (fscanf(fp, "%d", &lo) == 1) {
+        int c = fgetc(fp);
+
+        hi = lo;
+        if (c == '-') {
+            if (fscanf(fp, "%d", &hi) != 1) {
+                break;
+            }
+            c = fgetc(fp);
+        }
+        found |= cpu >= lo && cpu <= hi;
+        if (c != ',') {
+            break;
+        }
+    }
+    fclose(fp);
+
+    return found;
+}
+
+static int readCapacity(int cpu) {
+    char path[128];
+    int value;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpu_capacity", cpu);
+    FILE *fp = fopen(path, "r");
+    if (fp) {
+        if (fscanf(fp, "%d", &value) != 1) {
+            value = 1024;
+        }
+        fclose(fp);
+        return value;
+    }
+
+    // Intel hybrid parts list their efficiency cores under cpu_atom; count
+    // them at half the capacity of a performance core.
+    return inCpuList("/sys/devices/cpu_atom/cpus", cpu) == 1 ? 512 : 1024;
+}
+
+Topology *TopologyDetect(void) {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        for (int c = 0; c < omp_get_num_procs(); c++) {
+            CPU_SET(c, &allowed);
+        }
+    }
+
+    int n = CPU_COUNT(&allowed);
+    int *ids = malloc(sizeof(int) * n);
+    int *keys = malloc(sizeof(int) * n);
+    int *caps = malloc(sizeof(int) * n);
+
+    n = 0;
+    for (int c = 0; c < CPU_SETSIZE; c++) {
+        if (CPU_ISSET(c, &allowed)) {
+            int package = readSysInt(c, "physical_package_id", 0);
+            int core = readSysInt(c, "core_id", c);
+            int cap = readCapacity(c);
+
+            // Insertion sort, fastest first, otherwise in CPU order.
+            int i = n++;
+            while (i > 0 && caps[i - 1] < cap) {
+                ids[i] = ids[i - 1];
+                keys[i] = keys[i - 1];
+                caps[i] = caps[i - 1];
+                i--;
+            }
+            ids[i] = c;
+            keys[i] = package * 65536 + core;
+            caps[i] = cap;
+        }
+    }
+
+    Topology *topo = malloc(sizeof(Topology));
+    topo->ncpus = n;
+    topo->ncores = 0;
+    topo->cpu = malloc(sizeof(int) * n);
+    topo->core = malloc(sizeof(int) * n);
+    topo->thread = malloc(sizeof(int) * n);
+    topo->capacity = malloc(sizeof(int) * n);
+    topo->hybrid = n > 0 && caps[0] != caps[n - 1];
+
+    // Number cores, fastest first and then in order of their lowest CPU, and
+    // group their siblings.
+    int *done = calloc(n, sizeof(int));
+    int k = 0;
+    for (int i = 0; i < n; i++) {
+        if (done[i]) {
+            continue;
+        }
+        int t = 0;
+        for (int j = i; j < n; j++) {
+            if (!done[j] && keys[j] == keys[i]) {
+                done[j] = 1;
+                topo->cpu[k] = ids[j];
+                topo->core[k] = topo->ncores;
+                topo->thread[k] = t++;
+                topo->capacity[k] = caps[j];
+                k++;
+            }
+        }
+        topo->ncores++;
+    }
+
+    free(done);
+    free(ids);
+    free(keys);
+    free(caps);
+
+    return topo;
+}
+
+void TopologyFree(Topology *topo) {
+    free(topo->cpu);
+    free(topo->core);
+    free(topo->thread);
+    free(topo->capacity);
+    free(topo);
+}
+
+int TopologyOrder(const Topology *topo, int smt, Placement placement, int *cpus) {
+    int n = 0;
+
+    if (placement == PLACE_COMPACT && smt) {
+        for (int i = 0; i < topo->ncpus; i++) {
+            cpus[n++] = topo->cpu[i];
+        }
+        return n;
+    }
+
+    // Scatter: sibling 0 of every core, then sibling 1 of every core, ...
+    for (int t = 0; ; t++) {
+        int placed = 0;
+        for (int i = 0; i < topo->ncpus; i++) {
+            if (topo->thread[i] == t) {
+                cpus[n++] = topo->cpu[i];
+                placed = 1;
+            }
+        }
+        if (!placed || !smt) {
+            break;
+        }
+    }
+
+    return n;
+}
+
+void TopologyPin(const int *cpus, int n) {
+    omp_set_num_threads(n);
+
+    #pragma omp parallel num_threads(n)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus[omp_get_thread_num()], &set);
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+}
+
+void TopologyUnpin(const Topology *topo, int threads) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int i = 0; i < topo->ncpus; i++) {
+        CPU_SET(topo->cpu[i], &set);
+    }
+
+    // No team was larger than the available CPUs, so this one reaches every
+    // pinned thread.
+    #pragma omp parallel num_threads(topo->ncpus)
+    {
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+
+    omp_set_num_threads(threads);
+}
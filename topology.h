@@ -0,0 +1,49 @@
+/**
+ * CPU topology and thread placement.
+ *
+ * The topology is read from sysfs (/sys/devices/system/cpu/cpuN/topology) and
+ * restricted to the CPUs this process may run on. When sysfs is unavailable
+ * every logical CPU is treated as its own core.
+ *
+ * On hybrid processors the cores are not equal. Their relative capacity comes
+ * from cpu_capacity (big.LITTLE), or from the cpu_core/cpu_atom PMU CPU lists
+ * (Intel). Cores are ordered fastest first, so that a team smaller than the
+ * machine lands on the performance cores.
+ */
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+typedef struct Topology {
+    int ncpus;      // Logical CPUs available to the process.
+    int ncores;     // Physical cores they belong to.
+    int *cpu;       // Logical CPU ids, grouped by core.
+    int *core;      // Core (0 .. ncores - 1) of each entry of `cpu`.
+    int *thread;    // Position of each entry of `cpu` among its core's siblings.
+    int *capacity;  // Relative performance of each entry of `cpu`, 1024 the fastest.
+    int hybrid;     // Whether the capacities differ.
+} Topology;
+
+typedef enum {
+    PLACE_COMPACT,  // Fill all siblings of a core before the next core.
+    PLACE_SCATTER   // One thread per core first, then the remaining siblings.
+} Placement;
+
+Topology *TopologyDetect(void);
+void TopologyFree(Topology *topo);
+
+// Fill `cpus` with the order in which threads are placed and return how many
+// CPUs it holds. Without `smt` only the first sibling of each core is used.
+int TopologyOrder(const Topology *topo, int smt, Placement placement, int *cpus);
+
+// Use `n` OpenMP threads and pin thread i to `cpus[i]`. The pinning is done
+// by the threads of a team of `n`, so it applies to the following parallel
+// regions of that size only as long as the runtime runs them on the same
+// threads, as libgomp and LLVM's libomp do for consecutive regions.
+void TopologyPin(const int *cpus, int n);
+
+// Let the pinned threads run anywhere among the available CPUs again and use
+// `threads` OpenMP threads, the team size from before the pinning.
+void TopologyUnpin(const Topology *topo, int threads);
+
+#endif
@@ -0,0 +1,117 @@
+/**
+ * Per-pass thread placement, see tuning.h.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <omp.h>
+
+#include "tuning.h"
+
+#define TUNING_MAGIC "fast-blur-tuning"
+#define TUNING_VERSION 1
+
+static const char *passNames[TUNE_PASSES] = { "row", "column", "evaluate" };
+static const char *policyNames[2] = { "all", "cores" };
+
+void TuningDefault(Tuning *tuning) {
+    for (int p = 0; p < TUNE_PASSES; p++) {
+        tuning->policy[p] = THREADS_ALL;
+    }
+    tuning->ncores = tuning->ncpus = tuning->threads = omp_get_max_threads();
+    tuning->cpus = NULL;
+}
+
+const char *TunePassName(TunePass pass) {
+    return passNames[pass];
+}
+
+const char *ThreadPolicyName(ThreadPolicy policy) {
+    return policyNames[policy];
+}
+
+int TuningLoad(const char *path, Tuning *tuning) {
+    FILE *fp = fopen(path, "r");
+    char magic[32], pass[32], policy[32];
+    int version;
+
+    TuningDefault(tuning);
+    if (!fp) {
+        return -1;
+    }
+    if (fscanf(fp, "%31s %d", magic, &version) != 2
+        || strcmp(magic, TUNING_MAGIC) != 0 || version != TUNING_VERSION) {
+        fclose(fp);
+        return -1;
+    }
+
+    // Passes not listed keep the default; unknown names are an error.
+    while (fscanf(fp, "%31s %31s", pass, policy) == 2) {
+        int p = 0, q = 0;
+        while (p < TUNE_PASSES && strcmp(pass, passNames[p]) != 0) {
+            p++;
+        }
+        while (q < 2 && strcmp(policy, policyNames[q]) != 0) {
+            q++;
+        }
+        if (p == TUNE_PASSES || q == 2) {
+            fclose(fp);
+            return -1;
+        }
+        tuning->policy[p] = q;
+    }
+    fclose(fp);
+
+    return 0;
+}
+
+int TuningSave(const char *path, const Tuning *tuning) {
+    FILE *fp = fopen(path, "w");
+
+    if (!fp) {
+        return -1;
+    }
+    fprintf(fp, "%s %d\n", TUNING_MAGIC, TUNING_VERSION);
+    for (int p = 0; p < TUNE_PASSES; p++) {
+        fprintf(fp, "%s %s\n", passNames[p], policyNames[tuning->policy[p]]);
+    }
+
+    return fclose(fp) == 0 ? 0 : -1;
+}
+
+void TuningStart(Tuning *tuning, const Topology *topo) {
+    int *cpus = malloc(sizeof(int) * topo->ncpus);
+    const int n = TopologyOrder(topo, 1, PLACE_SCATTER, cpus);
+
+    tuning->threads = omp_get_max_threads();
+    tuning->ncpus = n < tuning->threads ? n : tuning->threads;
+    tuning->ncores = topo->ncores < tuning->ncpus ? topo->ncores : tuning->ncpus;
+
+    if (omp_get_proc_bind() == omp_proc_bind_false) {
+        tuning->cpus = cpus;
+    } else {
+        tuning->cpus = NULL;
+        free(cpus);
+    }
+}
+
+void TuningPass(const Tuning *tuning, TunePass pass) {
+    const int n = tuning->policy[pass] == THREADS_CORES ? tuning->ncores : tuning->ncpus;
+
+    if (tuning->cpus) {
+        TopologyPin(tuning->cpus, n);
+    } else {
+        omp_set_num_threads(n);
+    }
+}
+
+void TuningStop(Tuning *tuning, const Topology *topo) {
+    if (tuning->cpus) {
+        TopologyUnpin(topo, tuning->threads);
+        free(tuning->cpus);
+        tuning->cpus = NULL;
+    } else {
+        omp_set_num_threads(tuning->threads);
+    }
+}
@@ -0,0 +1,68 @@
+/**
+ * Per-pass thread placement ("tuning profile").
+ *
+ * SMT siblings share the caches and load/store ports of their core. A pass
+ * limited by memory bandwidth gains nothing from a second thread per core and
+ * loses cache to it, while a pass limited by latency or arithmetic can use the
+ * sibling to hide its stalls. A tuning profile records, for each pass of the
+ * summed-area table engines, whether it runs one thread per physical core or
+ * one per logical CPU. `fast_blur --profile --tuning FILE` times both and
+ * writes the faster; `fast_blur --tuning FILE` applies it.
+ *
+ * Each pass pins its own team in scatter order, fastest cores first: a team
+ * of `ncores` threads has exactly one thread per core and a full team adds
+ * the siblings. The pinning holds as long as the runtime runs the pass on the
+ * threads that pinned themselves, which libgomp and LLVM's libomp do for
+ * consecutive regions of one size. When OMP_PROC_BIND binds the threads, the
+ * runtime places them (OMP_PLACES=cores gives one thread per core) and only
+ * the team size changes. A team never grows past OMP_NUM_THREADS, and
+ * TuningStop() restores it.
+ *
+ * The file is plain text:
+ *
+ *     fast-blur-tuning 1
+ *     row cores
+ *     column cores
+ *     evaluate all
+ */
+
+#ifndef TUNING_H
+#define TUNING_H
+
+#include "topology.h"
+
+typedef enum { TUNE_ROW, TUNE_COLUMN, TUNE_EVALUATE, TUNE_PASSES } TunePass;
+
+typedef enum {
+    THREADS_ALL,    // One thread per logical CPU.
+    THREADS_CORES   // One thread per physical core.
+} ThreadPolicy;
+
+typedef struct Tuning {
+    ThreadPolicy policy[TUNE_PASSES];
+    int ncores;     // Team sizes, set by TuningStart().
+    int ncpus;
+    int *cpus;      // Scatter order to pin to, NULL if threads are not pinned.
+    int threads;    // Team size before TuningStart().
+} Tuning;
+
+// A profile running every pass on all logical CPUs.
+void TuningDefault(Tuning *tuning);
+
+// Read or write a profile file. Return 0 on success, -1 on error.
+int TuningLoad(const char *path, Tuning *tuning);
+int TuningSave(const char *path, const Tuning *tuning);
+
+const char *TunePassName(TunePass pass);
+const char *ThreadPolicyName(ThreadPolicy policy);
+
+// Size the teams for `topo` as described above.
+void TuningStart(Tuning *tuning, const Topology *topo);
+
+// Size and pin the team of the following parallel regions for `pass`.
+void TuningPass(const Tuning *tuning, TunePass pass);
+
+// Unpin the threads and restore the team size from before TuningStart().
+void TuningStop(Tuning *tuning, const Topology *topo);
+
+#endif